@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""Benchmark runner for Mini Script.
+
+Runs each workload in bench/*.ms several times and reports the median wall
+time, throughput and peak resident set size in CSV (default), JSON lines or
+a side-by-side table.
+
+Each workload declares how many operations it performs with a header
+comment of the form ``// ops: N``; ops/sec is derived from that count.
+
+With --impl the same workloads run on several implementations (c, rust,
+py). The first implementation listed is the reference: every other
+implementation's output is compared against it.
+"""
+import argparse
+import glob
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+REPO_ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BENCH_DIR = os.path.join(REPO_ROOT, "bench")
+DEFAULT_INTERPRETER = os.path.join(REPO_ROOT, "src", "c", "mini_script")
+FIELDS = ["benchmark", "impl", "runs", "median_s", "min_s", "ops", "ops_per_sec",
+          "peak_rss_kb", "status", "output"]
+IMPLEMENTATIONS = ["c", "rust", "py"]
+
+# The Rust and Python interpreters print this banner before running a file
+BANNER = b"Mini Script Language Interpreter\n"
+
+
+def find_engine(impl, c_interpreter):
+    """Command prefix that runs a script on an implementation, or None."""
+    if impl == "c":
+        return [c_interpreter] if os.access(c_interpreter, os.X_OK) else None
+    if impl == "rust":
+        for profile in ("release", "debug"):
+            path = os.path.join(REPO_ROOT, "target", profile, "mini_script")
+            if os.access(path, os.X_OK):
+                return [path]
+        return None
+    if impl == "py":
+        return [sys.executable, os.path.join(REPO_ROOT, "src", "py", "mini_script.py")]
+    raise ValueError(impl)
+
+
+def normalize_output(stdout):
+    """Strip the Rust/Python start-up banner (five lines) so outputs compare."""
+    if stdout.startswith(BANNER):
+        return b"".join(stdout.splitlines(True)[5:])
+    return stdout
+
+
+def discover(names):
+    paths = sorted(glob.glob(os.path.join(BENCH_DIR, "*.ms")))
+    if names:
+        wanted = set(names)
+        paths = [p for p in paths if os.path.splitext(os.path.basename(p))[0] in wanted]
+    return paths
+
+
+def read_ops(path):
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("// ops:"):
+                return int(line.split(":", 1)[1])
+    return 0
+
+
+def read_hwm_kb(pid):
+    """Peak RSS (VmHWM) of a running process from /proc, or None."""
+    try:
+        with open("/proc/%d/status" % pid) as f:
+            for line in f:
+                if line.startswith("VmHWM:"):
+                    return int(line.split()[1])
+    except OSError:
+        pass
+    return None
+
+
+def run_once(command, timeout):
+    """Run one benchmark process; returns (seconds, peak_rss_kb, exit_code, stdout).
+
+    Peak RSS is polled from /proc/<pid>/status while the child runs: on Linux
+    a spawned child's ru_maxrss is floored at the parent's RSS at exec time,
+    which would hide the interpreter's own footprint. Where /proc is not
+    available the child's ru_maxrss from wait4 is used instead.
+    """
+    with tempfile.TemporaryFile() as out:
+        start = time.perf_counter()
+        proc = subprocess.Popen(command, stdout=out, stderr=subprocess.DEVNULL)
+        peak = 0
+        while True:
+            pid, status, usage = os.wait4(proc.pid, os.WNOHANG)
+            if pid != 0:
+                break
+            hwm = read_hwm_kb(proc.pid)
+            if hwm is not None:
+                peak = max(peak, hwm)
+            if time.perf_counter() - start > timeout:
+                proc.kill()
+                os.wait4(proc.pid, 0)
+                proc.returncode = -9
+                return None, 0, 124, b""
+            time.sleep(0.001)
+        elapsed = time.perf_counter() - start
+        proc.returncode = os.waitstatus_to_exitcode(status)
+        out.seek(0)
+        stdout = out.read()
+    return elapsed, peak or usage.ru_maxrss, proc.returncode, stdout
+
+
+def cleanup():
+    for path in glob.glob(os.path.join(REPO_ROOT, "bench_*.tmp")):
+        os.remove(path)
+
+
+def bench(path, impl, command, runs, timeout):
+    """Run one workload on one implementation; returns (row, stdout)."""
+    name = os.path.splitext(os.path.basename(path))[0]
+    ops = read_ops(path)
+    times, rss, status, output = [], 0, "ok", None
+    for _ in range(runs):
+        elapsed, peak, code, stdout = run_once(command + [os.path.relpath(path, REPO_ROOT)], timeout)
+        cleanup()
+        if code != 0:
+            status = "timeout" if code == 124 else "exit %d" % code
+            break
+        output = normalize_output(stdout)
+        times.append(elapsed)
+        rss = max(rss, peak)
+    median = statistics.median(times) if times else 0.0
+    return {
+        "benchmark": name,
+        "impl": impl,
+        "runs": len(times),
+        "median_s": round(median, 6),
+        "min_s": round(min(times), 6) if times else 0.0,
+        "ops": ops,
+        "ops_per_sec": round(ops / median, 1) if median > 0 else 0.0,
+        "peak_rss_kb": rss,
+        "status": status,
+        "output": "",
+    }, output
+
+
+def unavailable(path, impl):
+    return {
+        "benchmark": os.path.splitext(os.path.basename(path))[0], "impl": impl,
+        "runs": 0, "median_s": 0.0, "min_s": 0.0, "ops": read_ops(path),
+        "ops_per_sec": 0.0, "peak_rss_kb": 0, "status": "unavailable", "output": "",
+    }
+
+
+def print_table(rows, impls):
+    """Side-by-side comparison: one line per workload, one column group per
+    implementation with median time, speed relative to the reference, peak
+    RSS and output check."""
+    reference = impls[0]
+    header = "%-10s" % "benchmark"
+    for impl in impls:
+        header += " | %-36s" % ("%s: median_s  x%s  rss_kb  output" % (impl, reference))
+    print(header)
+    print("-" * len(header))
+    for name in sorted({r["benchmark"] for r in rows}):
+        by_impl = {r["impl"]: r for r in rows if r["benchmark"] == name}
+        base = by_impl[reference]["median_s"]
+        line = "%-10s" % name
+        for impl in impls:
+            r = by_impl[impl]
+            if r["status"] != "ok":
+                line += " | %-36s" % r["status"]
+                continue
+            ratio = "%.2f" % (r["median_s"] / base) if base > 0 else "-"
+            line += " | %-10.4f %6s %8d  %-8s" % (r["median_s"], ratio, r["peak_rss_kb"], r["output"])
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("names", nargs="*", help="benchmarks to run (default: all)")
+    parser.add_argument("-n", "--runs", type=int, default=5, help="runs per benchmark (default: 5)")
+    parser.add_argument("-t", "--timeout", type=float, default=120, help="per-run timeout in seconds")
+    parser.add_argument("--format", choices=["csv", "json", "table"], default="csv", help="output format")
+    parser.add_argument("--interpreter", default=DEFAULT_INTERPRETER, help="C interpreter binary")
+    parser.add_argument("--impl", default="c",
+                        help="comma-separated implementations to run: c, rust, py or all "
+                             "(default: c; the first is the output reference)")
+    args = parser.parse_args()
+    args.interpreter = os.path.abspath(args.interpreter)
+    os.chdir(REPO_ROOT)  # workloads use repo-relative paths
+
+    impls = IMPLEMENTATIONS if args.impl == "all" else args.impl.split(",")
+    for impl in impls:
+        if impl not in IMPLEMENTATIONS:
+            sys.exit("Unknown implementation: %s (choose from %s)" % (impl, ", ".join(IMPLEMENTATIONS)))
+    engines = {impl: find_engine(impl, args.interpreter) for impl in impls}
+    if engines[impls[0]] is None:
+        sys.exit("Reference implementation '%s' not found (build it first)" % impls[0])
+    for impl in impls:
+        if engines[impl] is None:
+            print("Skipping %s: interpreter not built" % impl, file=sys.stderr)
+
+    paths = discover(args.names)
+    if not paths:
+        sys.exit("No benchmarks found")
+
+    rows = []
+    if args.format == "csv":
+        print(",".join(FIELDS))
+    for path in paths:
+        reference_output = None
+        for impl in impls:
+            if engines[impl] is None:
+                row = unavailable(path, impl)
+            else:
+                print("Running %s on %s..." % (os.path.basename(path), impl), file=sys.stderr)
+                row, output = bench(path, impl, engines[impl], args.runs, args.timeout)
+                if impl == impls[0]:
+                    reference_output = output
+                    row["output"] = "ref"
+                elif row["status"] == "ok" and reference_output is not None:
+                    row["output"] = "match" if output == reference_output else "differs"
+            rows.append(row)
+            if args.format == "csv":
+                print(",".join(str(row[f]) for f in FIELDS))
+            elif args.format == "json":
+                print(json.dumps(row))
+            sys.stdout.flush()
+
+    if args.format == "table":
+        print_table(rows, impls)
+    failures = [r for r in rows if r["status"] != "ok" or r["output"] == "differs"]
+    for r in failures:
+        if r["status"] != "ok":
+            print("Failed: %s on %s: %s" % (r["benchmark"], r["impl"], r["status"]), file=sys.stderr)
+        else:
+            print("Output mismatch: %s on %s differs from %s" % (r["benchmark"], r["impl"], impls[0]),
+                  file=sys.stderr)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
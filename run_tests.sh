@@ -4,6 +4,7 @@ set -euo pipefail
 
 VERBOSE=false
 USE_PYTHON=false
+USE_AOT=false
 INTERPRETER=""
 TIMEOUT=30
 
@@ -12,6 +13,7 @@ usage() {
 Usage: $0 [options]
     -v, --verbose      Show interpreter output for each test
             --python       Use Python implementation (auto-detect path)
+            --aot          Compile each test with --aot and run the executable
     -t, --timeout N    Per-test timeout seconds (default: $TIMEOUT)
     -h, --help         Show this help
 EOF
@@ -21,6 +23,7 @@ while [[ $# -gt 0 ]]; do
     case "$1" in
         -v|--verbose) VERBOSE=true; shift ;;
     --python) USE_PYTHON=true; shift ;;
+    --aot) USE_AOT=true; shift ;;
         -t|--timeout) TIMEOUT="$2"; shift 2 ;;
         -h|--help) usage; exit 0 ;;
         *) echo "Unknown option: $1"; usage; exit 1 ;;
@@ -61,19 +64,84 @@ if $USE_PYTHON; then
 else
     echo "(C interpreter: $INTERPRETER)"
 fi
+if $USE_AOT; then
+    AOT_DIR=$(mktemp -d)
+    trap 'rm -rf "$AOT_DIR"' EXIT
+    echo "(Compiled ahead of time with --aot)"
+fi
 $VERBOSE && echo "(Verbose mode)"
 echo "=================================="
 
 total_tests=0
 passed_tests=0
 failed_tests=0
+skipped_tests=0
+
+# Header directives of a test: "// options: ARGS" passes ARGS to the
+# interpreter; "// expect-error: TEXT" expects the script to fail cleanly with
+# TEXT in its output; "// expect-output: REGEX" and "// forbid-output: REGEX"
+# (repeatable) require that some / no output line matches.
+directive() {
+    sed -n "s|^// $1: ||p" "$2" | tr -d '\r'
+}
+
+# Runs a test that has directives, checking its exit status and output
+run_checked_test() {
+    local test_file="$1" options="$2" expect_error="$3"
+    local output status=0 problem=""
+    output=$(eval "timeout $TIMEOUT $INTERPRETER $options \"$test_file\"" 2>&1) || status=$?
+    if [[ -n "$expect_error" ]]; then
+        if [[ $status -eq 0 || $status -ge 124 ]]; then
+            problem="expected a runtime error, got exit $status"
+        elif ! grep -qF -- "$expect_error" <<<"$output"; then
+            problem="missing error: $expect_error"
+        fi
+    elif [[ $status -ne 0 ]]; then
+        handle_failure $status "$test_file"
+        $VERBOSE && printf '%s\n' "$output"
+        return
+    fi
+    local pattern
+    while IFS= read -r pattern; do
+        [[ -z "$problem" && -n "$pattern" ]] || continue
+        grep -qE -- "$pattern" <<<"$output" || problem="no output line matches: $pattern"
+    done < <(directive expect-output "$test_file")
+    while IFS= read -r pattern; do
+        [[ -z "$problem" && -n "$pattern" ]] || continue
+        ! grep -qE -- "$pattern" <<<"$output" || problem="output line matches: $pattern"
+    done < <(directive forbid-output "$test_file")
+    if [[ -z "$problem" ]]; then
+        echo "✓ PASSED"
+        passed_tests=$((passed_tests+1))
+    else
+        echo "✗ FAILED ($problem)"
+        $VERBOSE && printf '%s\n' "$output"
+        failed_tests=$((failed_tests+1))
+    fi
+}
 
 run_test() {
     local test_file="$1"
     local name
     name=$(basename "$test_file")
     printf 'Running %s... ' "$name"
+    if grep -qE '^// (options|expect-error|expect-output|forbid-output): ' "$test_file"; then
+        # Interpreter options and messages are specific to the C interpreter
+        if $USE_AOT || $USE_PYTHON; then
+            echo "- SKIPPED (checks C interpreter options or output)"
+            skipped_tests=$((skipped_tests+1))
+        else
+            run_checked_test "$test_file" "$(directive options "$test_file")" \
+                "$(directive expect-error "$test_file" | head -n 1)"
+        fi
+        total_tests=$((total_tests+1))
+        return
+    fi
     local cmd="timeout $TIMEOUT $INTERPRETER \"$test_file\""
+    if $USE_AOT; then
+        local exe="$AOT_DIR/${name%.ms}"
+        cmd="$INTERPRETER --aot=\"$exe\" \"$test_file\" && timeout $TIMEOUT \"$exe\""
+    fi
     if $VERBOSE; then
         if eval $cmd; then
             echo "✓ PASSED"
@@ -116,6 +184,7 @@ done
 
 echo "=================================="
 echo "Test Summary:"; printf '  Total:  %d\n  Passed: %d\n  Failed: %d\n' $total_tests $passed_tests $failed_tests
+(( skipped_tests == 0 )) || printf '  Skipped: %d\n' $skipped_tests
 if [[ $failed_tests -eq 0 ]]; then
     echo "✓ All tests passed!"; exit 0
 else
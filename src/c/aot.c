@@ -0,0 +1,1318 @@
+#include "mini_script.h"
+
+#include <stdarg.h>
+
+/* Ahead-of-time compilation (--emit-c, --aot).
+ *
+ * A script and the modules it imports are translated into one C file that
+ * links against the interpreter's runtime, libminiscript.a (every object but
+ * main.o). Each function declaration becomes a C function installed as the
+ * declaration's native body, and each module's top level becomes one more,
+ * so calls, frames, tail calls, imports, builtins and error messages all go
+ * through the same runtime as interpreted code: only the tree walk is
+ * replaced. Statements become C control flow and expressions straight-line
+ * C over Value pointers. Variables still live in environments, found
+ * through a lookup cache per reference.
+ *
+ * Arithmetic and comparisons have an unboxed path: an operand that is a
+ * literal, a number variable or more arithmetic is a C double, and the
+ * generic operation (interpreter_binary) only runs when an operand turns
+ * out not to be a number. Indexing a list variable reads the element in
+ * place instead of copying the list first.
+ *
+ * Imports are resolved when compiling, relative to the current directory,
+ * and the modules compiled in, so the executable reads no script files.
+ *
+ * In the generated code, tN is an owned Value (for operands, NULL when the
+ * operand is the double nN), bN a condition, pN a variable's slot, cN its
+ * lookup cache, sN the scope a block will restore and lN a for-in loop.
+ */
+
+typedef struct {
+  char *path;   /* as imported, with the .ms extension */
+  char *source;
+  Lexer *lexer; /* the statements point into its tokens */
+  Parser *parser;
+  StmtList statements;
+} AotModule;
+
+typedef struct {
+  AotModule *modules; /* modules[0] is the script itself */
+  size_t module_count;
+  size_t module_capacity;
+  Stmt **functions;   /* every function declaration, in numbering order */
+  size_t function_count;
+  size_t function_capacity;
+  bool failed;        /* an imported module did not parse */
+} AotProgram;
+
+/* What generated code has to release when it leaves early */
+typedef enum {
+  HELD_VALUE,   /* tN */
+  HELD_OPERAND, /* tN, which may be NULL */
+  HELD_CALLEE,  /* tN, owned unless it points at the stack copy fN */
+  HELD_SCOPE,   /* a block's environment, sN being the enclosing one */
+  HELD_LOOP     /* the for-in loop lN */
+} HeldKind;
+
+typedef struct {
+  HeldKind kind;
+  int id;
+} Held;
+
+typedef struct {
+  FILE *out;
+  AotProgram *program;
+  int depth;        /* indentation */
+  int next_id;      /* numbers the C variables of one function */
+  bool in_function; /* false at a module's top level */
+  Held *held;
+  size_t held_count;
+  size_t held_capacity;
+} Emitter;
+
+/* Runtime support for generated code */
+
+Value *aot_number(double number) {
+  Value *value = value_new(VALUE_NUMBER);
+  value->as.number = number;
+  return value;
+}
+
+Value *aot_boolean(bool boolean) {
+  Value *value = value_new(VALUE_BOOLEAN);
+  value->as.boolean = boolean;
+  return value;
+}
+
+Value *aot_string(const char *string) {
+  Value *value = value_new(VALUE_STRING);
+  value->as.string = malloc(strlen(string) + 1);
+  strcpy(value->as.string, string);
+  return value;
+}
+
+Value *aot_list(size_t capacity) {
+  Value *list = value_new(VALUE_LIST);
+  list->as.list = value_list_new(capacity);
+  return list;
+}
+
+/* One value of a print statement, which frees it */
+void aot_print(Value *value, bool last) {
+  char *str = stringify_value(value);
+  printf("%s", str);
+  printf(last ? "\n" : " ");
+  free(str);
+  value_free(value);
+}
+
+/* Leaves a block's scope for PREVIOUS */
+void aot_leave_scope(Interpreter *interpreter, Environment *previous) {
+  environment_release(interpreter->environment);
+  interpreter->environment = previous;
+}
+
+void aot_error(Interpreter *interpreter, const char *message, size_t line,
+               RuntimeError **error) {
+  *error = runtime_error_new(message, line,
+                             interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+}
+
+/* Reports NAME, referenced on LINE, as undefined */
+void aot_undefined(Interpreter *interpreter, const char *name, size_t line,
+                   RuntimeError **error) {
+  Token token = {IDENTIFIER, (char *)name, NULL, line};
+  environment_get(interpreter->environment, &token, error,
+                  interpreter->current_filename);
+}
+
+/* Fails an assert on LINE with MESSAGE (freed), or the default message if
+ * it is NULL or not a string */
+void aot_assert_failed(Interpreter *interpreter, Value *message, size_t line,
+                       RuntimeError **error) {
+  aot_error(interpreter,
+            message && message->type == VALUE_STRING ? message->as.string
+                                                      : "Assertion failed",
+            line, error);
+  if (message)
+    value_free(message);
+}
+
+/* Runs the compiled script FILENAME, whose top level is MAIN, as main.c
+ * runs an interpreted one; returns the exit status */
+int aot_main(const char *filename, NativeCode main, size_t max_depth) {
+  Interpreter *interpreter = interpreter_new();
+  interpreter_set_filename(interpreter, filename);
+  interpreter_set_max_depth(interpreter, max_depth);
+  interpreter->jit = false; /* it compiles syntax trees, which are not kept */
+
+  RuntimeError *error = NULL;
+  interpreter_run_native(interpreter, main, &error);
+
+  int exit_code = 0;
+  if (error) {
+    if (error->line > 0) {
+      fprintf(stderr, "Runtime error at %s:%zu: %s\n", error->filename, error->line, error->message);
+    } else {
+      fprintf(stderr, "Runtime error: %s\n", error->message);
+    }
+    runtime_error_free(error);
+    exit_code = 70;
+  }
+  interpreter_free(interpreter);
+  return exit_code;
+}
+
+/* Program discovery */
+
+static void collect_statements(AotProgram *program, StmtList *statements);
+
+/* The path an import statement loads, as the interpreter computes it, or
+ * NULL if the path is malformed */
+static char *import_path(Stmt *stmt) {
+  const char *path = stmt->as.import.path_token.lexeme;
+  size_t length = strlen(path);
+  if (length < 2 || path[0] != '"' || path[length - 1] != '"')
+    return NULL;
+  char *clean = malloc(length + 2);
+  memcpy(clean, path + 1, length - 2);
+  clean[length - 2] = '\0';
+  if (strlen(clean) < 3 || strcmp(clean + strlen(clean) - 3, ".ms") != 0)
+    strcat(clean, ".ms");
+  return clean;
+}
+
+/* The contents of PATH, or NULL if it cannot be read (read_file lives in
+ * main.c, which compiled programs do not link) */
+static char *read_module(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return NULL;
+  fseek(file, 0L, SEEK_END);
+  long size = ftell(file);
+  rewind(file);
+  char *source = size >= 0 ? malloc(size + 1) : NULL;
+  if (!source || fread(source, 1, size, file) < (size_t)size) {
+    free(source);
+    fclose(file);
+    return NULL;
+  }
+  source[size] = '\0';
+  fclose(file);
+  return source;
+}
+
+/* Index of the module at PATH, loading and parsing it the first time;
+ * -1 if the file cannot be read */
+static int module_index(AotProgram *program, const char *path) {
+  for (size_t i = 0; i < program->module_count; i++) {
+    if (strcmp(program->modules[i].path, path) == 0)
+      return (int)i;
+  }
+
+  char *source = read_module(path);
+  if (!source)
+    return -1;
+  if (program->module_count == program->module_capacity) {
+    program->module_capacity *= 2;
+    program->modules =
+        realloc(program->modules, program->module_capacity * sizeof(AotModule));
+  }
+  size_t index = program->module_count++;
+  AotModule *module = &program->modules[index];
+  module->path = malloc(strlen(path) + 1);
+  strcpy(module->path, path);
+  module->source = source;
+  module->lexer = lexer_new(source);
+  lexer_scan_tokens(module->lexer);
+  module->parser = parser_new(module->lexer->tokens, module->lexer->token_count, path);
+  RuntimeError *error = NULL;
+  module->statements = parser_parse(module->parser, &error);
+  if (error) {
+    fprintf(stderr, "Parse error at %s:%zu: %s\n", error->filename, error->line,
+            error->message);
+    runtime_error_free(error);
+    program->failed = true;
+    return (int)index;
+  }
+
+  StmtList statements = module->statements; /* modules may move */
+  collect_statements(program, &statements);
+  return (int)index;
+}
+
+static void collect_statement(AotProgram *program, Stmt *stmt) {
+  if (!stmt)
+    return;
+  switch (stmt->type) {
+  case STMT_BLOCK:
+    collect_statements(program, &stmt->as.block.statements);
+    break;
+  case STMT_FUNCTION:
+    if (program->function_count == program->function_capacity) {
+      program->function_capacity = program->function_capacity ? program->function_capacity * 2 : 16;
+      program->functions =
+          realloc(program->functions, program->function_capacity * sizeof(Stmt *));
+    }
+    program->functions[program->function_count++] = stmt;
+    collect_statements(program, &stmt->as.function.body);
+    break;
+  case STMT_FOR:
+    collect_statement(program, stmt->as.for_stmt.initializer);
+    collect_statement(program, stmt->as.for_stmt.body);
+    break;
+  case STMT_IF:
+    collect_statement(program, stmt->as.if_stmt.then_branch);
+    collect_statement(program, stmt->as.if_stmt.else_branch);
+    break;
+  case STMT_WHILE:
+    collect_statement(program, stmt->as.while_stmt.body);
+    break;
+  case STMT_FOR_IN:
+    collect_statement(program, stmt->as.for_in.body);
+    break;
+  case STMT_IMPORT: {
+    char *path = import_path(stmt);
+    if (path)
+      module_index(program, path);
+    free(path);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+static void collect_statements(AotProgram *program, StmtList *statements) {
+  for (size_t i = 0; i < statements->count; i++)
+    collect_statement(program, statements->statements[i]);
+}
+
+static size_t function_index(AotProgram *program, Stmt *declaration) {
+  size_t i = 0;
+  while (program->functions[i] != declaration)
+    i++;
+  return i;
+}
+
+static void program_free(AotProgram *program) {
+  for (size_t i = 1; i < program->module_count; i++) {
+    AotModule *module = &program->modules[i];
+    for (size_t j = 0; j < module->statements.count; j++)
+      stmt_free(module->statements.statements[j]);
+    free(module->statements.statements);
+    parser_free(module->parser);
+    lexer_free(module->lexer);
+    free(module->source);
+    free(module->path);
+  }
+  free(program->modules);
+  free(program->functions);
+}
+
+/* Code generation */
+
+static void emit(Emitter *e, const char *format, ...) {
+  va_list args;
+  fprintf(e->out, "%*s", 2 * e->depth, "");
+  va_start(args, format);
+  vfprintf(e->out, format, args);
+  va_end(args);
+  fputc('\n', e->out);
+}
+
+/* Writes STRING as a C string literal */
+static void emit_quoted(FILE *out, const char *string) {
+  fputc('"', out);
+  for (const unsigned char *c = (const unsigned char *)string; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      fprintf(out, "\\%c", *c);
+    else if (*c == '\n')
+      fputs("\\n", out);
+    else if (*c == '\t')
+      fputs("\\t", out);
+    else if (*c < 32 || *c >= 127 || *c == '?') /* '?' would risk trigraphs */
+      fprintf(out, "\\%03o", *c);
+    else
+      fputc(*c, out);
+  }
+  fputc('"', out);
+}
+
+static void hold(Emitter *e, HeldKind kind, int id) {
+  if (e->held_count == e->held_capacity) {
+    e->held_capacity = e->held_capacity ? e->held_capacity * 2 : 16;
+    e->held = realloc(e->held, e->held_capacity * sizeof(Held));
+  }
+  e->held[e->held_count].kind = kind;
+  e->held[e->held_count].id = id;
+  e->held_count++;
+}
+
+static void release(Emitter *e, size_t count) { e->held_count -= count; }
+
+/* Emits the release of everything held, innermost first */
+static void emit_unwind(Emitter *e) {
+  for (size_t i = e->held_count; i-- > 0;) {
+    int id = e->held[i].id;
+    switch (e->held[i].kind) {
+    case HELD_VALUE:
+      emit(e, "value_free(t%d);", id);
+      break;
+    case HELD_OPERAND:
+      emit(e, "if (t%d)", id);
+      emit(e, "  value_free(t%d);", id);
+      break;
+    case HELD_CALLEE:
+      emit(e, "if (t%d != &f%d)", id, id);
+      emit(e, "  value_free(t%d);", id);
+      break;
+    case HELD_SCOPE:
+      emit(e, "aot_leave_scope(I, s%d);", id);
+      break;
+    case HELD_LOOP:
+      emit(e, "interpreter_for_in_end(&l%d);", id);
+      break;
+    }
+  }
+}
+
+/* Emits `if (CONDITION) { unwind; return NULL; }`, CONDITION being a
+ * format taking ID */
+static void emit_fail_if(Emitter *e, const char *condition, int id) {
+  char test[64];
+  snprintf(test, sizeof(test), condition, id);
+  emit(e, "if (%s) {", test);
+  e->depth++;
+  emit_unwind(e);
+  emit(e, "return NULL;");
+  e->depth--;
+  emit(e, "}");
+}
+
+static const char *operator_name(MSTokenType op) {
+  switch (op) {
+  case PLUS: return "PLUS";
+  case MINUS: return "MINUS";
+  case MULTIPLY: return "MULTIPLY";
+  case DIVIDE: return "DIVIDE";
+  case GREATER: return "GREATER";
+  case GREATER_EQUAL: return "GREATER_EQUAL";
+  case LESS: return "LESS";
+  case LESS_EQUAL: return "LESS_EQUAL";
+  case EQUAL: return "EQUAL";
+  case NOT_EQUAL: return "NOT_EQUAL";
+  default: return NULL;
+  }
+}
+
+/* The C operator computing OP on two doubles, NULL if there is none */
+static const char *c_operator(MSTokenType op) {
+  switch (op) {
+  case PLUS: return "+";
+  case MINUS: return "-";
+  case MULTIPLY: return "*";
+  case DIVIDE: return "/";
+  case GREATER: return ">";
+  case GREATER_EQUAL: return ">=";
+  case LESS: return "<";
+  case LESS_EQUAL: return "<=";
+  case EQUAL: return "==";
+  case NOT_EQUAL: return "!=";
+  default: return NULL;
+  }
+}
+
+static bool is_arithmetic(MSTokenType op) {
+  return op == PLUS || op == MINUS || op == MULTIPLY || op == DIVIDE;
+}
+
+/* Whether evaluating EXPR can neither call nor assign anything */
+static bool is_pure(Expr *expr) {
+  switch (expr->type) {
+  case EXPR_LITERAL:
+  case EXPR_VARIABLE:
+    return true;
+  case EXPR_GROUPING:
+    return is_pure(expr->as.grouping.expression);
+  case EXPR_UNARY:
+    return is_pure(expr->as.unary.right);
+  case EXPR_BINARY:
+    return is_pure(expr->as.binary.left) && is_pure(expr->as.binary.right);
+  case EXPR_LOGICAL:
+    return is_pure(expr->as.logical.left) && is_pure(expr->as.logical.right);
+  case EXPR_GET:
+    return is_pure(expr->as.get.object) && is_pure(expr->as.get.index);
+  default:
+    return false;
+  }
+}
+
+static int emit_value(Emitter *e, Expr *expr, bool tail);
+static int emit_operand(Emitter *e, Expr *expr);
+static int emit_condition(Emitter *e, Expr *expr);
+static void emit_statement(Emitter *e, Stmt *stmt);
+
+/* Emits `Value **pN`, the slot of the variable NAME, failing if it is
+ * undefined */
+static int emit_lookup(Emitter *e, Token *name) {
+  int id = e->next_id++;
+  emit(e, "static LookupCache c%d;", id);
+  emit(e, "Value **p%d = environment_lookup(I->environment, \"%s\", &c%d);", id,
+       name->lexeme, id);
+  emit(e, "if (!p%d) {", id);
+  e->depth++;
+  emit(e, "aot_undefined(I, \"%s\", %zu, error);", name->lexeme, name->line);
+  emit_unwind(e);
+  emit(e, "return NULL;");
+  e->depth--;
+  emit(e, "}");
+  return id;
+}
+
+/* Emits `interpreter_binary` on operands L and R into tID, which is
+ * declared already */
+static void emit_generic_binary(Emitter *e, Expr *expr, int l, int r, int id) {
+  const char *name = operator_name(expr->as.binary.op.type);
+  char op[32];
+  if (name)
+    snprintf(op, sizeof(op), "%s", name);
+  else
+    snprintf(op, sizeof(op), "(MSTokenType)%d", (int)expr->as.binary.op.type);
+  emit(e, "t%d = interpreter_binary(I, %s, %zu, t%d ? t%d : aot_number(n%d),", id,
+       op, expr->as.binary.op.line, l, l, l);
+  emit(e, "                        t%d ? t%d : aot_number(n%d), error);", r, r, r);
+  emit_fail_if(e, "!t%d", id);
+}
+
+static void emit_binary_operands(Emitter *e, Expr *expr, int *l, int *r) {
+  *l = emit_operand(e, expr->as.binary.left);
+  hold(e, HELD_OPERAND, *l);
+  *r = emit_operand(e, expr->as.binary.right);
+  release(e, 1);
+}
+
+static int emit_literal(Emitter *e, Expr *expr) {
+  int id = e->next_id++;
+  LiteralValue *literal = &expr->as.literal.value;
+  switch (literal->type) {
+  case LITERAL_NIL:
+    emit(e, "Value *t%d = value_new(VALUE_NIL);", id);
+    break;
+  case LITERAL_BOOLEAN:
+    emit(e, "Value *t%d = aot_boolean(%s);", id, literal->value.boolean ? "true" : "false");
+    break;
+  case LITERAL_NUMBER:
+    emit(e, "Value *t%d = aot_number(%.17g);", id, literal->value.number);
+    break;
+  case LITERAL_INTEGER:
+    emit(e, "Value *t%d = aot_number(%ld.0);", id, literal->value.integer);
+    break;
+  case LITERAL_STRING:
+    fprintf(e->out, "%*sValue *t%d = aot_string(", 2 * e->depth, "", id);
+    emit_quoted(e->out, literal->value.string);
+    fprintf(e->out, ");\n");
+    break;
+  case LITERAL_MS_CHAR: {
+    char string[2] = {literal->value.character, '\0'};
+    fprintf(e->out, "%*sValue *t%d = aot_string(", 2 * e->depth, "", id);
+    emit_quoted(e->out, string);
+    fprintf(e->out, ");\n");
+    break;
+  }
+  }
+  return id;
+}
+
+/* Emits an assignment; the result is only produced (and its id returned)
+ * if WANT_RESULT */
+static int emit_assign(Emitter *e, Expr *expr, bool want_result) {
+  int r = emit_operand(e, expr->as.assign.value);
+  int id = e->next_id++;
+  emit(e, "static LookupCache c%d;", id);
+  emit(e, "Value **p%d = environment_lookup(I->environment, \"%s\", &c%d);", id,
+       expr->as.assign.name.lexeme, id);
+  if (want_result)
+    emit(e, "Value *t%d = t%d ? value_copy(t%d) : aot_number(n%d);", id, r, r, r);
+  /* A number replacing a number is written in place */
+  emit(e, "if (p%d && !t%d && (*p%d)->type == VALUE_NUMBER) {", id, r, id);
+  emit(e, "  (*p%d)->as.number = n%d;", id, r);
+  emit(e, "} else {");
+  e->depth++;
+  emit(e, "if (!t%d)", r);
+  emit(e, "  t%d = aot_number(n%d);", r, r);
+  emit(e, "if (p%d) {", id);
+  emit(e, "  value_free(*p%d);", id);
+  emit(e, "  *p%d = t%d;", id, r);
+  emit(e, "  environment_adopt(p%d, t%d);", id, r);
+  emit(e, "} else {");
+  emit(e, "  environment_define(I->environment, \"%s\", t%d);", expr->as.assign.name.lexeme, r);
+  emit(e, "}");
+  e->depth--;
+  emit(e, "}");
+  return want_result ? id : -1;
+}
+
+static int emit_call(Emitter *e, Expr *expr, bool tail) {
+  Expr *callee = expr->as.call.callee;
+  int c = e->next_id++;
+  emit(e, "Value f%d;", c);
+  emit(e, "MiniScriptFunction g%d;", c);
+  emit(e, "Value *t%d;", c);
+  if (callee->type == EXPR_VARIABLE) {
+    /* A named MiniScript function is called through a copy on the C stack,
+     * as the interpreter does */
+    int p = emit_lookup(e, &callee->as.variable.name);
+    emit(e, "if ((*p%d)->type == VALUE_FUNCTION) {", p);
+    emit(e, "  g%d = *(*p%d)->as.function;", c, p);
+    emit(e, "  f%d.type = VALUE_FUNCTION;", c);
+    emit(e, "  f%d.as.function = &g%d;", c, c);
+    emit(e, "  t%d = &f%d;", c, c);
+    emit(e, "} else {");
+    emit(e, "  t%d = value_copy(*p%d);", c, p);
+    emit(e, "}");
+  } else {
+    int v = emit_value(e, callee, false);
+    emit(e, "t%d = t%d;", c, v);
+  }
+  hold(e, HELD_CALLEE, c);
+
+  size_t count = expr->as.call.arguments.count;
+  int *arguments = malloc((count ? count : 1) * sizeof(int));
+  for (size_t i = 0; i < count; i++) {
+    arguments[i] = emit_value(e, expr->as.call.arguments.expressions[i], false);
+    hold(e, HELD_VALUE, arguments[i]);
+  }
+  release(e, count + 1);
+  if (count) {
+    emit(e, "Value **a%d = malloc(%zu * sizeof(Value *));", c, count);
+    for (size_t i = 0; i < count; i++)
+      emit(e, "a%d[%zu] = t%d;", c, i, arguments[i]);
+  } else {
+    emit(e, "Value **a%d = NULL;", c);
+  }
+  free(arguments);
+
+  int id = e->next_id++;
+  emit(e, "Value *t%d = interpreter_call_value(I, t%d, a%d, %zu, %zu, %s, error);",
+       id, c, c, count, expr->as.call.paren.line, tail ? "true" : "false");
+  emit(e, "if (t%d != &f%d)", c, c);
+  emit(e, "  value_free(t%d);", c);
+  emit_fail_if(e, "!t%d", id);
+  return id;
+}
+
+static int emit_get(Emitter *e, Expr *expr) {
+  Expr *object = expr->as.get.object;
+  int id;
+  if (object->type == EXPR_VARIABLE && is_pure(expr->as.get.index)) {
+    /* Read the element where it is rather than copying the whole list;
+     * the index cannot change the variable meanwhile */
+    int p = emit_lookup(e, &object->as.variable.name);
+    int i = emit_operand(e, expr->as.get.index);
+    id = e->next_id++;
+    emit(e, "Value *t%d;", id);
+    emit(e, "long k%d = t%d ? 0 : (long)n%d;", id, i, i);
+    emit(e, "if (!t%d && (*p%d)->type == VALUE_LIST && k%d >= 0 &&", i, p, id);
+    emit(e, "    (size_t)k%d < (*p%d)->as.list->count) {", id, p);
+    emit(e, "  t%d = value_copy(&(*p%d)->as.list->elements[k%d]);", id, p, id);
+    emit(e, "} else {");
+    e->depth++;
+    emit(e, "t%d = interpreter_get_index(I, value_copy(*p%d),", id, p);
+    emit(e, "                           t%d ? t%d : aot_number(n%d), error);", i, i, i);
+    emit_fail_if(e, "!t%d", id);
+    e->depth--;
+    emit(e, "}");
+    return id;
+  }
+
+  int o = emit_value(e, object, false);
+  hold(e, HELD_VALUE, o);
+  int i = emit_value(e, expr->as.get.index, false);
+  release(e, 1);
+  id = e->next_id++;
+  emit(e, "Value *t%d = interpreter_get_index(I, t%d, t%d, error);", id, o, i);
+  emit_fail_if(e, "!t%d", id);
+  return id;
+}
+
+static int emit_set(Emitter *e, Expr *expr) {
+  int o = emit_value(e, expr->as.set.object, false);
+  hold(e, HELD_VALUE, o);
+  int i = emit_value(e, expr->as.set.index, false);
+  hold(e, HELD_VALUE, i);
+  int v = emit_value(e, expr->as.set.value, false);
+  release(e, 2);
+  int id = e->next_id++;
+  emit(e, "Value *t%d = interpreter_set_index(I, t%d, t%d, t%d, error);", id, o, i, v);
+  emit_fail_if(e, "!t%d", id);
+  return id;
+}
+
+/* Emits EXPR evaluated to an owned `Value *tN`; a call in TAIL position is
+ * handed to the returning function's frame */
+static int emit_value(Emitter *e, Expr *expr, bool tail) {
+  int id;
+  switch (expr->type) {
+  case EXPR_LITERAL:
+    return emit_literal(e, expr);
+
+  case EXPR_GROUPING:
+    return emit_value(e, expr->as.grouping.expression, false);
+
+  case EXPR_VARIABLE: {
+    int p = emit_lookup(e, &expr->as.variable.name);
+    id = e->next_id++;
+    emit(e, "Value *t%d = value_copy(*p%d);", id, p);
+    return id;
+  }
+
+  case EXPR_ASSIGN:
+    return emit_assign(e, expr, true);
+
+  case EXPR_BINARY: {
+    MSTokenType op = expr->as.binary.op.type;
+    if (is_arithmetic(op)) {
+      int o = emit_operand(e, expr);
+      id = e->next_id++;
+      emit(e, "Value *t%d = t%d ? t%d : aot_number(n%d);", id, o, o, o);
+      return id;
+    }
+    int l, r;
+    emit_binary_operands(e, expr, &l, &r);
+    id = e->next_id++;
+    emit(e, "Value *t%d;", id);
+    if (c_operator(op)) {
+      emit(e, "if (!t%d && !t%d) {", l, r);
+      emit(e, "  t%d = aot_boolean(n%d %s n%d);", id, l, c_operator(op), r);
+      emit(e, "} else {");
+      e->depth++;
+      emit_generic_binary(e, expr, l, r, id);
+      e->depth--;
+      emit(e, "}");
+    } else {
+      emit_generic_binary(e, expr, l, r, id);
+    }
+    return id;
+  }
+
+  case EXPR_LOGICAL: {
+    int l = emit_value(e, expr->as.logical.left, false);
+    id = e->next_id++;
+    emit(e, "Value *t%d;", id);
+    /* Short-circuit: the deciding left value is the result */
+    if (expr->as.logical.op.type == AND || expr->as.logical.op.type == OR) {
+      emit(e, "if (%sis_truthy(t%d)) {", expr->as.logical.op.type == AND ? "!" : "", l);
+      emit(e, "  t%d = t%d;", id, l);
+      emit(e, "} else {");
+    } else {
+      emit(e, "{");
+    }
+    e->depth++;
+    emit(e, "value_free(t%d);", l);
+    int r = emit_value(e, expr->as.logical.right, false);
+    emit(e, "t%d = t%d;", id, r);
+    e->depth--;
+    emit(e, "}");
+    return id;
+  }
+
+  case EXPR_UNARY: {
+    if (expr->as.unary.op.type == MINUS) {
+      int o = emit_operand(e, expr);
+      id = e->next_id++;
+      emit(e, "Value *t%d = t%d ? t%d : aot_number(n%d);", id, o, o, o);
+      return id;
+    }
+    if (expr->as.unary.op.type == NOT) {
+      int b = emit_condition(e, expr->as.unary.right);
+      id = e->next_id++;
+      emit(e, "Value *t%d = aot_boolean(!b%d);", id, b);
+      return id;
+    }
+    int r = emit_value(e, expr->as.unary.right, false);
+    emit(e, "value_free(t%d);", r);
+    emit(e, "aot_error(I, \"Unknown unary operator.\", %zu, error);", expr->as.unary.op.line);
+    emit_fail_if(e, "%d", 1);
+    id = e->next_id++;
+    emit(e, "Value *t%d = NULL;", id);
+    return id;
+  }
+
+  case EXPR_CALL:
+    return emit_call(e, expr, tail);
+
+  case EXPR_LIST_LITERAL: {
+    id = e->next_id++;
+    emit(e, "Value *t%d = aot_list(%zu);", id, expr->as.list_literal.elements.count);
+    hold(e, HELD_VALUE, id);
+    for (size_t i = 0; i < expr->as.list_literal.elements.count; i++) {
+      int element = emit_value(e, expr->as.list_literal.elements.expressions[i], false);
+      emit(e, "value_list_push(t%d->as.list, t%d);", id, element);
+    }
+    release(e, 1);
+    return id;
+  }
+
+  case EXPR_GET:
+    return emit_get(e, expr);
+
+  case EXPR_SET:
+    return emit_set(e, expr);
+  }
+
+  id = e->next_id++;
+  emit(e, "aot_error(I, \"Unknown expression type.\", 0, error);");
+  emit_fail_if(e, "%d", 1);
+  emit(e, "Value *t%d = NULL;", id);
+  return id;
+}
+
+/* Emits EXPR evaluated to `double nN` if it is a number, else to an owned
+ * `Value *tN` (NULL when it is a number) */
+static int emit_operand(Emitter *e, Expr *expr) {
+  int id;
+  switch (expr->type) {
+  case EXPR_GROUPING:
+    return emit_operand(e, expr->as.grouping.expression);
+
+  case EXPR_LITERAL:
+    if (expr->as.literal.value.type == LITERAL_NUMBER ||
+        expr->as.literal.value.type == LITERAL_INTEGER) {
+      id = e->next_id++;
+      if (expr->as.literal.value.type == LITERAL_NUMBER)
+        emit(e, "double n%d = %.17g;", id, expr->as.literal.value.value.number);
+      else
+        emit(e, "double n%d = %ld.0;", id, expr->as.literal.value.value.integer);
+      emit(e, "Value *t%d = NULL;", id);
+      return id;
+    }
+    break;
+
+  case EXPR_VARIABLE: {
+    int p = emit_lookup(e, &expr->as.variable.name);
+    id = e->next_id++;
+    emit(e, "double n%d = 0;", id);
+    emit(e, "Value *t%d = NULL;", id);
+    emit(e, "if ((*p%d)->type == VALUE_NUMBER)", p);
+    emit(e, "  n%d = (*p%d)->as.number;", id, p);
+    emit(e, "else");
+    emit(e, "  t%d = value_copy(*p%d);", id, p);
+    return id;
+  }
+
+  case EXPR_BINARY: {
+    if (!is_arithmetic(expr->as.binary.op.type))
+      break;
+    int l, r;
+    emit_binary_operands(e, expr, &l, &r);
+    id = e->next_id++;
+    emit(e, "double n%d = 0;", id);
+    emit(e, "Value *t%d = NULL;", id);
+    emit(e, "if (!t%d && !t%d) {", l, r);
+    emit(e, "  n%d = n%d %s n%d;", id, l, c_operator(expr->as.binary.op.type), r);
+    emit(e, "} else {");
+    e->depth++;
+    emit_generic_binary(e, expr, l, r, id);
+    emit(e, "if (t%d->type == VALUE_NUMBER) {", id);
+    emit(e, "  n%d = t%d->as.number;", id, id);
+    emit(e, "  value_free(t%d);", id);
+    emit(e, "  t%d = NULL;", id);
+    emit(e, "}");
+    e->depth--;
+    emit(e, "}");
+    return id;
+  }
+
+  case EXPR_UNARY: {
+    if (expr->as.unary.op.type != MINUS)
+      break;
+    int r = emit_operand(e, expr->as.unary.right);
+    id = e->next_id++;
+    emit(e, "double n%d = -n%d;", id, r);
+    emit(e, "Value *t%d = NULL;", id);
+    emit(e, "if (t%d) {", r);
+    e->depth++;
+    emit(e, "value_free(t%d);", r);
+    emit(e, "aot_error(I, \"Operand must be a number.\", %zu, error);", expr->as.unary.op.line);
+    emit_unwind(e);
+    emit(e, "return NULL;");
+    e->depth--;
+    emit(e, "}");
+    return id;
+  }
+
+  default:
+    break;
+  }
+
+  int v = emit_value(e, expr, false);
+  id = e->next_id++;
+  emit(e, "double n%d = 0;", id);
+  emit(e, "Value *t%d = t%d;", id, v);
+  emit(e, "if (t%d->type == VALUE_NUMBER) {", id);
+  emit(e, "  n%d = t%d->as.number;", id, id);
+  emit(e, "  value_free(t%d);", id);
+  emit(e, "  t%d = NULL;", id);
+  emit(e, "}");
+  return id;
+}
+
+/* Emits the truthiness of EXPR as `bool bN` */
+static int emit_condition(Emitter *e, Expr *expr) {
+  int id;
+  switch (expr->type) {
+  case EXPR_GROUPING:
+    return emit_condition(e, expr->as.grouping.expression);
+
+  case EXPR_LITERAL:
+    if (expr->as.literal.value.type == LITERAL_BOOLEAN ||
+        expr->as.literal.value.type == LITERAL_NIL) {
+      id = e->next_id++;
+      emit(e, "bool b%d = %s;", id,
+           expr->as.literal.value.type == LITERAL_BOOLEAN && expr->as.literal.value.value.boolean
+               ? "true" : "false");
+      return id;
+    }
+    break;
+
+  case EXPR_BINARY: {
+    MSTokenType op = expr->as.binary.op.type;
+    if (is_arithmetic(op) || !c_operator(op))
+      break;
+    int l, r;
+    emit_binary_operands(e, expr, &l, &r);
+    id = e->next_id++;
+    emit(e, "bool b%d;", id);
+    emit(e, "if (!t%d && !t%d) {", l, r);
+    emit(e, "  b%d = n%d %s n%d;", id, l, c_operator(op), r);
+    emit(e, "} else {");
+    e->depth++;
+    emit(e, "Value *t%d;", id);
+    emit_generic_binary(e, expr, l, r, id);
+    emit(e, "b%d = is_truthy(t%d);", id, id);
+    emit(e, "value_free(t%d);", id);
+    e->depth--;
+    emit(e, "}");
+    return id;
+  }
+
+  case EXPR_LOGICAL: {
+    bool and = expr->as.logical.op.type == AND;
+    if (!and && expr->as.logical.op.type != OR)
+      break;
+    int l = emit_condition(e, expr->as.logical.left);
+    id = e->next_id++;
+    emit(e, "bool b%d = b%d;", id, l);
+    emit(e, "if (%sb%d) {", and ? "" : "!", id);
+    e->depth++;
+    int r = emit_condition(e, expr->as.logical.right);
+    emit(e, "b%d = b%d;", id, r);
+    e->depth--;
+    emit(e, "}");
+    return id;
+  }
+
+  case EXPR_UNARY:
+    if (expr->as.unary.op.type == NOT) {
+      int r = emit_condition(e, expr->as.unary.right);
+      id = e->next_id++;
+      emit(e, "bool b%d = !b%d;", id, r);
+      return id;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  int v = emit_value(e, expr, false);
+  id = e->next_id++;
+  emit(e, "bool b%d = is_truthy(t%d);", id, v);
+  emit(e, "value_free(t%d);", v);
+  return id;
+}
+
+static void emit_statements(Emitter *e, StmtList *statements) {
+  for (size_t i = 0; i < statements->count; i++)
+    emit_statement(e, statements->statements[i]);
+}
+
+static void emit_import(Emitter *e, Stmt *stmt) {
+  size_t line = stmt->as.import.path_token.line;
+  char *path = import_path(stmt);
+  int module = path ? module_index(e->program, path) : -1;
+  if (!path || module < 0) {
+    emit(e, "aot_error(I, \"%s\", %zu, error);",
+         path ? "Could not open import file." : "Invalid import path format.", line);
+    emit_unwind(e);
+    emit(e, "return NULL;");
+    free(path);
+    return;
+  }
+
+  int id = e->next_id++;
+  emit(e, "ModuleScope scope%d;", id);
+  fprintf(e->out, "%*sif (interpreter_enter_module(I, ", 2 * e->depth, "");
+  emit_quoted(e->out, path);
+  fprintf(e->out, ", %zu, &scope%d, error)) {\n", line, id);
+  emit(e, "  m%d(I, error);", module);
+  emit(e, "  interpreter_leave_module(I, &scope%d);", id);
+  emit(e, "}");
+  emit_fail_if(e, "*error", 0);
+  free(path);
+}
+
+static void emit_statement(Emitter *e, Stmt *stmt) {
+  if (!stmt)
+    return;
+
+  switch (stmt->type) {
+  case STMT_EXPRESSION: {
+    Expr *expr = stmt->as.expression.expression;
+    if (expr->type == EXPR_ASSIGN) {
+      emit(e, "{");
+      e->depth++;
+      emit_assign(e, expr, false);
+      e->depth--;
+      emit(e, "}");
+      break;
+    }
+    emit(e, "{");
+    e->depth++;
+    int v = emit_value(e, expr, false);
+    emit(e, "value_free(t%d);", v);
+    e->depth--;
+    emit(e, "}");
+    break;
+  }
+
+  case STMT_PRINT:
+    emit(e, "{");
+    e->depth++;
+    for (size_t i = 0; i < stmt->as.print.count; i++) {
+      int v = emit_value(e, stmt->as.print.expressions[i], false);
+      emit(e, "aot_print(t%d, %s);", v, i + 1 == stmt->as.print.count ? "true" : "false");
+    }
+    if (stmt->as.print.count == 0)
+      emit(e, "printf(\"\\n\");");
+    e->depth--;
+    emit(e, "}");
+    break;
+
+  case STMT_VAR:
+    emit(e, "{");
+    e->depth++;
+    if (stmt->as.var.initializer) {
+      int v = emit_value(e, stmt->as.var.initializer, false);
+      emit(e, "environment_define(I->environment, \"%s\", t%d);", stmt->as.var.name.lexeme, v);
+    } else {
+      emit(e, "environment_define(I->environment, \"%s\", value_new(VALUE_NIL));",
+           stmt->as.var.name.lexeme);
+    }
+    e->depth--;
+    emit(e, "}");
+    break;
+
+  case STMT_BLOCK: {
+    int id = e->next_id++;
+    emit(e, "{");
+    e->depth++;
+    emit(e, "Environment *s%d = I->environment;", id);
+    emit(e, "I->environment = environment_new(s%d);", id);
+    hold(e, HELD_SCOPE, id);
+    emit_statements(e, &stmt->as.block.statements);
+    release(e, 1);
+    emit(e, "aot_leave_scope(I, s%d);", id);
+    e->depth--;
+    emit(e, "}");
+    break;
+  }
+
+  case STMT_IF: {
+    emit(e, "{");
+    e->depth++;
+    int b = emit_condition(e, stmt->as.if_stmt.condition);
+    emit(e, "if (b%d) {", b);
+    e->depth++;
+    emit_statement(e, stmt->as.if_stmt.then_branch);
+    e->depth--;
+    if (stmt->as.if_stmt.else_branch) {
+      emit(e, "} else {");
+      e->depth++;
+      emit_statement(e, stmt->as.if_stmt.else_branch);
+      e->depth--;
+    }
+    emit(e, "}");
+    e->depth--;
+    emit(e, "}");
+    break;
+  }
+
+  case STMT_WHILE: {
+    emit(e, "for (;;) {");
+    e->depth++;
+    int b = emit_condition(e, stmt->as.while_stmt.condition);
+    emit(e, "if (!b%d)", b);
+    emit(e, "  break;");
+    emit_statement(e, stmt->as.while_stmt.body);
+    e->depth--;
+    emit(e, "}");
+    break;
+  }
+
+  case STMT_FOR: {
+    emit(e, "{");
+    e->depth++;
+    emit_statement(e, stmt->as.for_stmt.initializer);
+    emit(e, "for (;;) {");
+    e->depth++;
+    if (stmt->as.for_stmt.condition) {
+      int b = emit_condition(e, stmt->as.for_stmt.condition);
+      emit(e, "if (!b%d)", b);
+      emit(e, "  break;");
+    }
+    emit_statement(e, stmt->as.for_stmt.body);
+    Expr *increment = stmt->as.for_stmt.increment;
+    if (increment) {
+      emit(e, "{");
+      e->depth++;
+      if (increment->type == EXPR_ASSIGN) {
+        emit_assign(e, increment, false);
+      } else {
+        int v = emit_value(e, increment, false);
+        emit(e, "value_free(t%d);", v);
+      }
+      e->depth--;
+      emit(e, "}");
+    }
+    e->depth--;
+    emit(e, "}");
+    e->depth--;
+    emit(e, "}");
+    break;
+  }
+
+  case STMT_FOR_IN: {
+    const char *name = stmt->as.for_in.name.lexeme;
+    emit(e, "{");
+    e->depth++;
+    int v = emit_value(e, stmt->as.for_in.iterable, false);
+    int id = e->next_id++;
+    emit(e, "ForIn l%d;", id);
+    emit(e, "if (!interpreter_for_in_begin(I, &l%d, t%d, %zu, error)) {", id, v, stmt->line);
+    e->depth++;
+    emit_unwind(e);
+    emit(e, "return NULL;");
+    e->depth--;
+    emit(e, "}");
+    if (stmt->as.for_in.declare)
+      emit(e, "environment_define(I->environment, \"%s\", value_new(VALUE_NIL));", name);
+    emit(e, "static LookupCache c%d;", id);
+    emit(e, "while (interpreter_for_in_next(I, &l%d, \"%s\", &c%d)) {", id, name, id);
+    e->depth++;
+    hold(e, HELD_LOOP, id);
+    emit_statement(e, stmt->as.for_in.body);
+    release(e, 1);
+    e->depth--;
+    emit(e, "}");
+    emit(e, "interpreter_for_in_end(&l%d);", id);
+    e->depth--;
+    emit(e, "}");
+    break;
+  }
+
+  case STMT_ASSERT: {
+    emit(e, "{");
+    e->depth++;
+    int b = emit_condition(e, stmt->as.assert_stmt.condition);
+    emit(e, "if (!b%d) {", b);
+    e->depth++;
+    if (stmt->as.assert_stmt.message) {
+      int m = emit_value(e, stmt->as.assert_stmt.message, false);
+      emit(e, "aot_assert_failed(I, t%d, %zu, error);", m, stmt->as.assert_stmt.keyword.line);
+    } else {
+      emit(e, "aot_assert_failed(I, NULL, %zu, error);", stmt->as.assert_stmt.keyword.line);
+    }
+    emit_unwind(e);
+    emit(e, "return NULL;");
+    e->depth--;
+    emit(e, "}");
+    e->depth--;
+    emit(e, "}");
+    break;
+  }
+
+  case STMT_FUNCTION:
+    emit(e, "interpreter_define_function(I, &d%zu);", function_index(e->program, stmt));
+    break;
+
+  case STMT_RETURN: {
+    emit(e, "{");
+    e->depth++;
+    Expr *value = stmt->as.return_stmt.value;
+    int v;
+    if (value) {
+      v = emit_value(e, value, e->in_function && value->type == EXPR_CALL);
+    } else {
+      v = e->next_id++;
+      emit(e, "Value *t%d = value_new(VALUE_NIL);", v);
+    }
+    if (!e->in_function) /* unwinds the importing code, as the interpreter does */
+      emit(e, "*error = runtime_error_with_return(\"return\", %zu, \"<return>\", t%d);",
+           stmt->as.return_stmt.keyword.line, v);
+    emit_unwind(e);
+    emit(e, e->in_function ? "return t%d;" : "return NULL;", v);
+    e->depth--;
+    emit(e, "}");
+    break;
+  }
+
+  case STMT_IMPORT:
+    emit(e, "{");
+    e->depth++;
+    emit_import(e, stmt);
+    e->depth--;
+    emit(e, "}");
+    break;
+  }
+}
+
+static void emit_body(Emitter *e, const char *name, StmtList *body, bool in_function) {
+  fprintf(e->out, "\nstatic Value *%s(Interpreter *I, RuntimeError **error) {\n", name);
+  e->depth = 1;
+  e->next_id = 0;
+  e->in_function = in_function;
+  emit(e, "(void)I;");
+  emit(e, "(void)error;");
+  emit_statements(e, body);
+  emit(e, "return NULL;");
+  fprintf(e->out, "}\n");
+}
+
+bool aot_emit_c(FILE *out, const char *script, StmtList statements, size_t max_depth) {
+  AotProgram program = {0};
+  program.module_capacity = 4;
+  program.modules = calloc(program.module_capacity, sizeof(AotModule));
+  program.modules[0].path = (char *)script;
+  program.modules[0].statements = statements;
+  program.module_count = 1;
+  collect_statements(&program, &statements);
+  if (program.failed) {
+    program_free(&program);
+    return false;
+  }
+
+  Emitter e = {out, &program, 0, 0, false, NULL, 0, 0};
+  fprintf(out, "/* Compiled from %s by mini_script --emit-c. */\n", script);
+  fprintf(out, "#include \"mini_script.h\"\n\n");
+  for (size_t i = 0; i < program.module_count; i++)
+    fprintf(out, "static Value *m%zu(Interpreter *I, RuntimeError **error);\n", i);
+  for (size_t i = 0; i < program.function_count; i++)
+    fprintf(out, "static Value *f%zu(Interpreter *I, RuntimeError **error);\n", i);
+
+  /* The declarations that function values point to */
+  for (size_t i = 0; i < program.function_count; i++) {
+    Stmt *declaration = program.functions[i];
+    size_t param_count = declaration->as.function.param_count;
+    fputc('\n', out);
+    if (param_count > 0) {
+      fprintf(out, "static Token f%zu_params[] = {", i);
+      for (size_t j = 0; j < param_count; j++) {
+        Token *param = &declaration->as.function.params[j];
+        fprintf(out, "%s{IDENTIFIER, \"%s\", NULL, %zu}", j ? ", " : "",
+                param->lexeme, param->line);
+      }
+      fprintf(out, "};\n");
+    }
+    fprintf(out, "static Stmt d%zu = {\n", i);
+    fprintf(out, "    .type = STMT_FUNCTION,\n");
+    fprintf(out, "    .line = %zu,\n", declaration->line);
+    fprintf(out, "    .as.function = {.name = {IDENTIFIER, \"%s\", NULL, %zu},\n",
+            declaration->as.function.name.lexeme, declaration->as.function.name.line);
+    if (param_count > 0)
+      fprintf(out, "                    .params = f%zu_params,\n", i);
+    fprintf(out, "                    .param_count = %zu,\n", param_count);
+    fprintf(out, "                    .filename = ");
+    emit_quoted(out, declaration->as.function.filename ? declaration->as.function.filename
+                                                       : "<unknown>");
+    fprintf(out, ",\n                    .native = f%zu}};\n", i);
+  }
+
+  char name[32];
+  for (size_t i = 0; i < program.module_count; i++) {
+    snprintf(name, sizeof(name), "m%zu", i);
+    emit_body(&e, name, &program.modules[i].statements, false);
+  }
+  for (size_t i = 0; i < program.function_count; i++) {
+    snprintf(name, sizeof(name), "f%zu", i);
+    emit_body(&e, name, &program.functions[i]->as.function.body, true);
+  }
+
+  fprintf(out, "\nint main(void) {\n  return aot_main(");
+  emit_quoted(out, script);
+  fprintf(out, ", m0, %zu);\n}\n", max_depth);
+
+  free(e.held);
+  bool ok = !program.failed;
+  program_free(&program);
+  return ok;
+}
+
+/* Compiles SCRIPT, already parsed into STATEMENTS, to the executable
+ * OUTPUT with the system C compiler ($CC, else cc) */
+bool aot_build(const char *output, const char *script, StmtList statements,
+               size_t max_depth) {
+  const char *runtime = getenv("MS_RUNTIME_DIR");
+#ifdef MS_RUNTIME_DIR
+  if (!runtime)
+    runtime = MS_RUNTIME_DIR;
+#endif
+  if (!runtime)
+    runtime = ".";
+  const char *cc = getenv("CC");
+  if (!cc || !*cc)
+    cc = "cc";
+  if (strchr(output, '\'') || strchr(runtime, '\'')) {
+    fprintf(stderr, "AOT: paths may not contain quotes.\n");
+    return false;
+  }
+
+  char library[4096];
+  snprintf(library, sizeof(library), "%s/libminiscript.a", runtime);
+  FILE *probe = fopen(library, "rb");
+  if (!probe) {
+    fprintf(stderr, "AOT: %s not found; build it with make, or set MS_RUNTIME_DIR.\n",
+            library);
+    return false;
+  }
+  fclose(probe);
+
+  size_t length = strlen(output) + 3;
+  char *source = malloc(length);
+  snprintf(source, length, "%s.c", output);
+  FILE *out = fopen(source, "w");
+  if (!out) {
+    fprintf(stderr, "Could not write \"%s\".\n", source);
+    free(source);
+    return false;
+  }
+  bool ok = aot_emit_c(out, script, statements, max_depth);
+  fclose(out);
+
+  if (ok) {
+    size_t size = strlen(cc) + 2 * strlen(runtime) + strlen(output) + strlen(source) + 128;
+    char *command = malloc(size);
+    snprintf(command, size, "%s -O2 -I'%s' -o '%s' '%s' '%s/libminiscript.a' -lm -lpthread",
+             cc, runtime, output, source, runtime);
+    ok = system(command) == 0;
+    if (!ok)
+      fprintf(stderr, "AOT: compiling %s failed: %s\n", source, command);
+    free(command);
+  }
+  if (ok)
+    remove(source);
+  free(source);
+  return ok;
+}
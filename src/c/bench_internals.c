@@ -0,0 +1,574 @@
+#define _GNU_SOURCE
+/* Microbenchmarks for interpreter internals.
+ *
+ * Links against the interpreter objects (everything except main.o) and times
+ * the hot paths in isolation: lexing, parsing, variable lookup (uncached and
+ * through a LookupCache), value copying, sorting and builtin dispatch. `make
+ * bench_internals` builds it with optimizations from its own objects, which
+ * leaves the normal build alone; `make bench` builds and runs it.
+ *
+ * Usage: bench_internals [scale]
+ *   scale multiplies the amount of work in every benchmark (default 1); it
+ *   may be fractional, e.g. 0.05 for a quick smoke run.
+ */
+#include "mini_script.h"
+#include <time.h>
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Keeps results alive so the compiler cannot drop the measured work */
+static volatile size_t sink;
+
+/* N times SCALE, but at least 1 */
+static size_t scaled(size_t n, double scale) {
+  size_t result = (size_t)(n * scale);
+  return result > 0 ? result : 1;
+}
+
+/* Generated source */
+
+static void buffer_append(char **buffer, size_t *length, size_t *capacity,
+                          const char *text) {
+  size_t n = strlen(text);
+  if (*length + n + 1 > *capacity) {
+    while (*length + n + 1 > *capacity)
+      *capacity = *capacity == 0 ? 4096 : *capacity * 2;
+    *buffer = realloc(*buffer, *capacity);
+  }
+  memcpy(*buffer + *length, text, n + 1);
+  *length += n;
+}
+
+/* Builds a script of FUNCTIONS function declarations that exercise every
+ * token class: keywords, identifiers, numbers, strings, operators. */
+static char *generate_source(size_t functions) {
+  char *buffer = NULL;
+  size_t length = 0, capacity = 0;
+  char chunk[512];
+
+  for (size_t i = 0; i < functions; i++) {
+    snprintf(chunk, sizeof(chunk),
+             "// generated function %zu\n"
+             "function work_%zu(a, b) {\n"
+             "  var total = 0;\n"
+             "  var items = [1, 2.5, \"three\", a, b];\n"
+             "  for (var i = 0; i < len(items); i = i + 1) {\n"
+             "    if (i >= 2 and a != b or !(a == nil)) {\n"
+             "      total = total + i * (a - b) / 2;\n"
+             "    } else {\n"
+             "      total = total - 1;\n"
+             "    }\n"
+             "  }\n"
+             "  while (total > 100) { total = total / 2; }\n"
+             "  print(\"work_%zu\", total);\n"
+             "  return total;\n"
+             "}\n",
+             i, i, i);
+    buffer_append(&buffer, &length, &capacity, chunk);
+  }
+  return buffer;
+}
+
+/* AST node counting */
+
+static size_t count_stmt(Stmt *stmt);
+
+static size_t count_expr(Expr *expr) {
+  if (!expr)
+    return 0;
+
+  size_t count = 1;
+  switch (expr->type) {
+  case EXPR_ASSIGN:
+    count += count_expr(expr->as.assign.value);
+    break;
+  case EXPR_BINARY:
+    count += count_expr(expr->as.binary.left) + count_expr(expr->as.binary.right);
+    break;
+  case EXPR_CALL:
+    count += count_expr(expr->as.call.callee);
+    for (size_t i = 0; i < expr->as.call.arguments.count; i++)
+      count += count_expr(expr->as.call.arguments.expressions[i]);
+    break;
+  case EXPR_GROUPING:
+    count += count_expr(expr->as.grouping.expression);
+    break;
+  case EXPR_LIST_LITERAL:
+    for (size_t i = 0; i < expr->as.list_literal.elements.count; i++)
+      count += count_expr(expr->as.list_literal.elements.expressions[i]);
+    break;
+  case EXPR_GET:
+    count += count_expr(expr->as.get.object) + count_expr(expr->as.get.index);
+    break;
+  case EXPR_SET:
+    count += count_expr(expr->as.set.object) + count_expr(expr->as.set.index) +
+             count_expr(expr->as.set.value);
+    break;
+  case EXPR_LOGICAL:
+    count += count_expr(expr->as.logical.left) + count_expr(expr->as.logical.right);
+    break;
+  case EXPR_UNARY:
+    count += count_expr(expr->as.unary.right);
+    break;
+  case EXPR_LITERAL:
+  case EXPR_VARIABLE:
+    break;
+  }
+  return count;
+}
+
+static size_t count_stmt_list(StmtList *list) {
+  size_t count = 0;
+  for (size_t i = 0; i < list->count; i++)
+    count += count_stmt(list->statements[i]);
+  return count;
+}
+
+static size_t count_stmt(Stmt *stmt) {
+  if (!stmt)
+    return 0;
+
+  size_t count = 1;
+  switch (stmt->type) {
+  case STMT_BLOCK:
+    count += count_stmt_list(&stmt->as.block.statements);
+    break;
+  case STMT_EXPRESSION:
+    count += count_expr(stmt->as.expression.expression);
+    break;
+  case STMT_PRINT:
+    for (size_t i = 0; i < stmt->as.print.count; i++)
+      count += count_expr(stmt->as.print.expressions[i]);
+    break;
+  case STMT_FUNCTION:
+    count += count_stmt_list(&stmt->as.function.body);
+    break;
+  case STMT_FOR:
+    count += count_stmt(stmt->as.for_stmt.initializer) +
+             count_expr(stmt->as.for_stmt.condition) +
+             count_expr(stmt->as.for_stmt.increment) +
+             count_stmt(stmt->as.for_stmt.body);
+    break;
+  case STMT_FOR_IN:
+    count += count_expr(stmt->as.for_in.iterable) + count_stmt(stmt->as.for_in.body);
+    break;
+  case STMT_IF:
+    count += count_expr(stmt->as.if_stmt.condition) +
+             count_stmt(stmt->as.if_stmt.then_branch) +
+             count_stmt(stmt->as.if_stmt.else_branch);
+    break;
+  case STMT_RETURN:
+    count += count_expr(stmt->as.return_stmt.value);
+    break;
+  case STMT_WHILE:
+    count += count_expr(stmt->as.while_stmt.condition) +
+             count_stmt(stmt->as.while_stmt.body);
+    break;
+  case STMT_ASSERT:
+    count += count_expr(stmt->as.assert_stmt.condition) +
+             count_expr(stmt->as.assert_stmt.message);
+    break;
+  case STMT_VAR:
+    count += count_expr(stmt->as.var.initializer);
+    break;
+  case STMT_IMPORT:
+    break;
+  }
+  return count;
+}
+
+static void free_statements(StmtList *statements) {
+  for (size_t i = 0; i < statements->count; i++)
+    stmt_free(statements->statements[i]);
+  free(statements->statements);
+}
+
+/* Benchmarks */
+
+static void bench_lexer(double scale) {
+  char *source = generate_source(scaled(10000, scale));
+  size_t bytes = strlen(source);
+  int rounds = 5;
+  double best = 0;
+  size_t tokens = 0;
+
+  for (int r = 0; r < rounds; r++) {
+    double start = now_seconds();
+    Lexer *lexer = lexer_new(source);
+    lexer_scan_tokens(lexer);
+    double elapsed = now_seconds() - start;
+    tokens = lexer->token_count;
+    lexer_free(lexer);
+    if (r == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  printf("lexer           %10.2f MB/s   %10.0f tokens/s  (%zu bytes, %zu tokens)\n",
+         bytes / best / 1e6, tokens / best, bytes, tokens);
+  free(source);
+}
+
+static void bench_parser(double scale) {
+  char *source = generate_source(scaled(10000, scale));
+  Lexer *lexer = lexer_new(source);
+  lexer_scan_tokens(lexer);
+  int rounds = 5;
+  double best = 0;
+  size_t nodes = 0;
+
+  for (int r = 0; r < rounds; r++) {
+    RuntimeError *error = NULL;
+    Parser *parser = parser_new(lexer->tokens, lexer->token_count, "<bench>");
+    double start = now_seconds();
+    StmtList statements = parser_parse(parser, &error);
+    double elapsed = now_seconds() - start;
+    if (error) {
+      fprintf(stderr, "Parse error in generated source: %s\n", error->message);
+      exit(1);
+    }
+    nodes = count_stmt_list(&statements);
+    free_statements(&statements);
+    parser_free(parser);
+    if (r == 0 || elapsed < best)
+      best = elapsed;
+  }
+
+  printf("parser          %10.0f nodes/s  (%zu nodes)\n", nodes / best, nodes);
+  lexer_free(lexer);
+  free(source);
+}
+
+/* DEPTH nested scopes, each holding SIZE variables */
+static Environment *new_scopes(size_t depth, size_t size) {
+  Environment *env = NULL;
+  char name[64];
+
+  for (size_t d = 0; d < depth; d++) {
+    env = environment_new(env);
+    for (size_t i = 0; i < size; i++) {
+      snprintf(name, sizeof(name), "v%zu_%zu", d, i);
+      Value *value = value_new(VALUE_NUMBER);
+      value->as.number = (double)i;
+      environment_define(env, name, value);
+    }
+  }
+  return env;
+}
+
+static void free_scopes(Environment *env) {
+  while (env) {
+    Environment *enclosing = env->enclosing;
+    environment_free(env);
+    env = enclosing;
+  }
+}
+
+/* Lookup of a variable defined in the outermost of DEPTH scopes, each holding
+ * SIZE variables, with the target defined last (the slowest position). */
+static void bench_environment_get(size_t depth, size_t size, double scale) {
+  Environment *env = new_scopes(depth, size);
+  char name[64];
+
+  Token token;
+  snprintf(name, sizeof(name), "v0_%zu", size - 1);
+  token.type = IDENTIFIER;
+  token.lexeme = name;
+  token.literal = NULL;
+  token.line = 1;
+
+  size_t iterations = scaled(2000000, scale) / (depth * size) + 1000;
+  RuntimeError *error = NULL;
+  double start = now_seconds();
+  for (size_t i = 0; i < iterations; i++) {
+    Value *value = environment_get(env, &token, &error, "<bench>");
+    sink += (size_t)value;
+  }
+  double elapsed = now_seconds() - start;
+
+  printf("environment_get depth=%-3zu size=%-4zu %10.1f ns/lookup\n", depth, size,
+         elapsed / iterations * 1e9);
+  free_scopes(env);
+}
+
+/* The same lookup through environment_lookup with a warm LookupCache, as a
+ * variable reference in a loop body performs it: the scope walk compares
+ * stamps and name bits, and only compares keys in scopes whose name bits
+ * match. */
+static void bench_environment_lookup(size_t depth, size_t size, double scale) {
+  Environment *env = new_scopes(depth, size);
+  char name[64];
+  snprintf(name, sizeof(name), "v0_%zu", size - 1);
+
+  LookupCache cache = {0, 0, 0, 0};
+  if (!environment_lookup(env, name, &cache)) {
+    fprintf(stderr, "environment_lookup missed %s\n", name);
+    exit(1);
+  }
+
+  size_t iterations = scaled(2000000, scale) / (depth * size) + 1000;
+  double start = now_seconds();
+  for (size_t i = 0; i < iterations; i++) {
+    Value **slot = environment_lookup(env, name, &cache);
+    sink += (size_t)*slot;
+  }
+  double elapsed = now_seconds() - start;
+
+  printf("environment_lookup depth=%-3zu size=%-4zu %7.1f ns/lookup (cached)\n",
+         depth, size, elapsed / iterations * 1e9);
+  free_scopes(env);
+}
+
+static void bench_value_copy(size_t elements, double scale) {
+  Value *list = value_new(VALUE_LIST);
+  list->as.list = value_list_new(elements);
+  list->as.list->count = elements;
+  for (size_t i = 0; i < elements; i++) {
+    list->as.list->elements[i].type = VALUE_NUMBER;
+    list->as.list->elements[i].as.number = (double)i;
+  }
+
+  size_t iterations = scaled(2000000, scale) / (elements + 1) + 100;
+  double start = now_seconds();
+  for (size_t i = 0; i < iterations; i++) {
+    Value *copy = value_copy(list);
+    sink += copy->as.list->count;
+    value_free(copy);
+  }
+  double elapsed = now_seconds() - start;
+
+  printf("value_copy      list[%-6zu] %12.1f ns/copy\n", elements,
+         elapsed / iterations * 1e9);
+  value_free(list);
+}
+
+static int compare_numbers(const void *a, const void *b) {
+  double x = ((const Value *)a)->as.number, y = ((const Value *)b)->as.number;
+  return x < y ? -1 : x > y;
+}
+
+static int compare_strings(const void *a, const void *b) {
+  return strcmp(((const Value *)a)->as.string, ((const Value *)b)->as.string);
+}
+
+/* sort_values on COUNT random numbers or strings (sharing a common prefix
+ * half of the time), against qsort on the same input */
+static void bench_sort(size_t count, bool strings, double scale) {
+  count = scaled(count, scale);
+  Value *input = malloc(count * sizeof(Value));
+  Value *work = malloc(count * sizeof(Value));
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  for (size_t i = 0; i < count; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    if (strings) {
+      char *string = malloc(24);
+      snprintf(string, 24, "%s%llu", state & 1 ? "user-" : "",
+               (unsigned long long)(state >> 20));
+      input[i].type = VALUE_STRING;
+      input[i].as.string = string;
+    } else {
+      input[i].type = VALUE_NUMBER;
+      input[i].as.number = (double)(int64_t)state / 1e3;
+    }
+  }
+
+  memcpy(work, input, count * sizeof(Value));
+  double start = now_seconds();
+  sort_values(work, count);
+  double sorted = now_seconds() - start;
+  sink += work[0].type;
+
+  memcpy(work, input, count * sizeof(Value));
+  start = now_seconds();
+  qsort(work, count, sizeof(Value), strings ? compare_strings : compare_numbers);
+  double baseline = now_seconds() - start;
+
+  printf("sort_values     %-7s n=%-8zu %8.1f ns/element (qsort %.1f)\n",
+         strings ? "strings" : "numbers", count, sorted / count * 1e9,
+         baseline / count * 1e9);
+  if (strings) {
+    for (size_t i = 0; i < count; i++)
+      free(input[i].as.string);
+  }
+  free(input);
+  free(work);
+}
+
+/* Unique-visitor counting: COUNT events drawn from COUNT / 4 distinct ids
+ * added to a set, then as many membership tests. */
+static void bench_set(size_t count, bool strings, double scale) {
+  count = scaled(count, scale);
+  Value *events = malloc(count * sizeof(Value));
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  for (size_t i = 0; i < count; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    unsigned long long id = state % (count / 4 + 1);
+    if (strings) {
+      char *string = malloc(32);
+      snprintf(string, 32, "visitor-%llu", id);
+      events[i].type = VALUE_STRING;
+      events[i].as.string = string;
+    } else {
+      events[i].type = VALUE_NUMBER;
+      events[i].as.number = (double)id;
+    }
+  }
+
+  ValueSet *set = value_set_new(0);
+  double start = now_seconds();
+  for (size_t i = 0; i < count; i++)
+    sink += value_set_add(set, &events[i]);
+  double added = now_seconds() - start;
+
+  start = now_seconds();
+  for (size_t i = 0; i < count; i++)
+    sink += value_set_has(set, &events[count - 1 - i]);
+  double tested = now_seconds() - start;
+
+  printf("value_set       %-7s n=%-8zu %8.1f ns/add %8.1f ns/has (%zu unique)\n",
+         strings ? "strings" : "numbers", count, added / count * 1e9,
+         tested / count * 1e9, set->count);
+  value_set_release(set);
+  if (strings) {
+    for (size_t i = 0; i < count; i++)
+      free(events[i].as.string);
+  }
+  free(events);
+}
+
+/* top_k(list, 100) against sorting a copy of the whole list, through the
+ * builtins as a script calls them */
+static void bench_top_k(Interpreter *interpreter, size_t count, double scale) {
+  count = scaled(count, scale);
+  Value *list = value_new(VALUE_LIST);
+  list->as.list = value_list_new(count);
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+  for (size_t i = 0; i < count; i++) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    Value *element = value_new(VALUE_NUMBER);
+    element->as.number = (double)(state >> 11);
+    value_list_push(list->as.list, element);
+  }
+  Value *k = value_new(VALUE_NUMBER);
+  k->as.number = 100;
+
+  Value *args[2] = {list, k};
+  double start = now_seconds();
+  Value *top = interpreter_call_builtin(interpreter, "top_k", args, 2);
+  double selected = now_seconds() - start;
+  sink += top->as.list->count;
+  value_free(top);
+
+  Value *copy = value_new(VALUE_LIST);
+  copy->as.list = value_list_new(count);
+  for (size_t i = 0; i < count; i++)
+    value_list_push(copy->as.list, value_copy(&list->as.list->elements[i]));
+  start = now_seconds();
+  Value *sorted = interpreter_call_builtin(interpreter, "sort", &copy, 1);
+  double baseline = now_seconds() - start;
+  value_free(sorted);
+
+  printf("top_k           k=100   n=%-8zu %8.1f ns/element (sort %.1f)\n", count,
+         selected / count * 1e9, baseline / count * 1e9);
+  value_free(copy);
+  value_free(k);
+  value_free(list);
+}
+
+/* The builtin registered last in the globals, which is also the last one
+ * interpreter_call_builtin compares against: both lists are appended to
+ * when a builtin is added. */
+static const char *last_builtin(Interpreter *interpreter) {
+  Environment *globals = interpreter->globals;
+  for (size_t i = globals->values.count; i > 0; i--) {
+    Value *value = globals->values.values[i - 1];
+    if (value && value->type == VALUE_BUILTIN)
+      return value->as.builtin_name;
+  }
+  return "len";
+}
+
+/* Dispatch cost of a builtin near the front and at the end of the
+ * name-comparison chain, measured with a call that does minimal work (an
+ * arity check that fails). */
+static void bench_builtin_dispatch(Interpreter *interpreter, const char *name,
+                                   double scale) {
+  Value *arg = value_new(VALUE_STRING);
+  arg->as.string = malloc(2);
+  strcpy(arg->as.string, "x");
+  Value *args[1] = {arg};
+  int arg_count = strcmp(name, "len") == 0 ? 1 : 0;
+
+  size_t iterations = scaled(2000000, scale);
+  double start = now_seconds();
+  for (size_t i = 0; i < iterations; i++) {
+    Value *result = interpreter_call_builtin(interpreter, name, args, arg_count);
+    if (result) {
+      sink += result->type;
+      value_free(result);
+    }
+  }
+  double elapsed = now_seconds() - start;
+
+  printf("call_builtin    %-14s %8.1f ns/call\n", name, elapsed / iterations * 1e9);
+  value_free(arg);
+}
+
+int main(int argc, char *argv[]) {
+  double scale = 1;
+  char *end = "";
+  if (argc == 2)
+    scale = strtod(argv[1], &end);
+  if (argc > 2 || *end || !(scale > 0 && scale <= 1e4)) {
+    fprintf(stderr, "Usage: bench_internals [scale]\n");
+    return 64;
+  }
+
+  bench_lexer(scale);
+  bench_parser(scale);
+
+  static const size_t depths[] = {1, 4, 16, 64};
+  static const size_t sizes[] = {1, 16, 256};
+  for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      bench_environment_get(depths[d], sizes[s], scale);
+      bench_environment_lookup(depths[d], sizes[s], scale);
+    }
+  }
+
+  static const size_t lengths[] = {0, 10, 100, 1000, 10000};
+  for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    bench_value_copy(lengths[i], scale);
+  }
+
+  static const size_t counts[] = {1000, 100000, 1000000};
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    bench_sort(counts[i], false, scale);
+    bench_sort(counts[i], true, scale);
+  }
+
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    bench_set(counts[i], false, scale);
+    bench_set(counts[i], true, scale);
+  }
+
+  Interpreter *interpreter = interpreter_new();
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    bench_top_k(interpreter, counts[i], scale);
+  }
+  bench_builtin_dispatch(interpreter, "len", scale);
+  bench_builtin_dispatch(interpreter, last_builtin(interpreter), scale);
+  bench_builtin_dispatch(interpreter, "not_a_builtin", scale);
+  interpreter_free(interpreter);
+
+  return 0;
+}
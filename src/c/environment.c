@@ -1,15 +1,126 @@
 #include "mini_script.h"
 
+static uint64_t next_stamp = 1;
+
+/* Scopes with more keys than this get a hash index; smaller ones are
+ * scanned, which is faster than hashing for a handful of keys */
+#define ENV_INDEX_MIN 16
+
+/* FNV-1a */
+static uint32_t name_hash(const char *name) {
+  uint32_t hash = 2166136261u;
+  for (const unsigned char *c = (const unsigned char *)name; *c; c++)
+    hash = (hash ^ *c) * 16777619u;
+  return hash;
+}
+
+/* One of 64 bits chosen by the hash of a name; the top bits, so that it is
+ * independent of the index slot taken from the low ones */
+static uint64_t name_bit(uint32_t hash) {
+  return (uint64_t)1 << (hash >> 26);
+}
+
+static void index_insert(Environment *env, size_t position, uint32_t hash) {
+  size_t mask = env->values.index_size - 1;
+  size_t slot = hash & mask;
+  while (env->values.index[slot] != 0)
+    slot = (slot + 1) & mask;
+  env->values.index[slot] = position + 1;
+}
+
+/* Rebuilds the index at twice the size; the first build covers every key */
+static void index_grow(Environment *env) {
+  free(env->values.index);
+  env->values.index_size = env->values.index_size == 0 ? 64 : env->values.index_size * 2;
+  env->values.index = calloc(env->values.index_size, sizeof(size_t));
+  ALLOC_TRACK(ALLOC_ENVIRONMENT, 1, env->values.index_size * sizeof(size_t));
+  for (size_t i = 0; i < env->values.count; i++)
+    index_insert(env, i, name_hash(env->values.keys[i]));
+}
+
+/* Position of NAME (whose hash is HASH) among ENV's keys, or its count */
+static size_t find_key(Environment *env, const char *name, uint32_t hash) {
+  if (env->values.index) {
+    size_t mask = env->values.index_size - 1;
+    for (size_t slot = hash & mask; env->values.index[slot] != 0; slot = (slot + 1) & mask) {
+      size_t i = env->values.index[slot] - 1;
+      if (strcmp(env->values.keys[i], name) == 0)
+        return i;
+    }
+    return env->values.count;
+  }
+  for (size_t i = 0; i < env->values.count; i++) {
+    if (strcmp(env->values.keys[i], name) == 0)
+      return i;
+  }
+  return env->values.count;
+}
+
 Environment *environment_new(Environment *enclosing) {
   Environment *env = malloc(sizeof(Environment));
+  ALLOC_TRACK(ALLOC_ENVIRONMENT, 1, sizeof(Environment));
+  mem_counters.environments++;
   env->values.keys = NULL;
   env->values.values = NULL;
   env->values.count = 0;
   env->values.capacity = 0;
+  env->values.index = NULL;
+  env->values.index_size = 0;
   env->enclosing = enclosing;
+  env->stamp = next_stamp++;
+  env->names = 0;
+  env->refcount = 1;
+  environment_retain(enclosing);
   return env;
 }
 
+/* Scopes are reference counted so that a closure keeps its defining scope
+ * (and that scope's enclosing ones) alive after the scope has ended. The
+ * global scope lives as long as the interpreter and is not counted. */
+void environment_retain(Environment *env) {
+  if (env && env->enclosing)
+    env->refcount++;
+}
+
+void environment_release(Environment *env) {
+  if (env && env->enclosing && --env->refcount == 0)
+    environment_free(env);
+}
+
+/* A function value stored in a variable of its own closure scope gives up
+ * its reference on that scope: the scope already holds it, and the
+ * reference would be a cycle that is never freed. SLOT is where VALUE has
+ * just been stored. */
+void environment_adopt(Value **slot, Value *value) {
+  if (value->type != VALUE_FUNCTION || !value->as.function->owns_closure)
+    return;
+  Environment *closure = value->as.function->closure;
+  uintptr_t first = (uintptr_t)closure->values.values;
+  uintptr_t at = (uintptr_t)slot;
+  if (at >= first && at < first + closure->values.count * sizeof(Value *)) {
+    value->as.function->owns_closure = false;
+    environment_release(closure); /* still held by its running scope */
+  }
+}
+
+/* Empties ENV for reuse as a new scope inside ENCLOSING; it gets a new
+ * stamp, so lookup caches do not mistake it for the old scope */
+void environment_reset(Environment *env, Environment *enclosing) {
+  for (size_t i = 0; i < env->values.count; i++) {
+    free(env->values.keys[i]);
+    if (env->values.values[i])
+      value_free(env->values.values[i]);
+  }
+  env->values.count = 0;
+  if (env->values.index)
+    memset(env->values.index, 0, env->values.index_size * sizeof(size_t));
+  environment_retain(enclosing); /* before the release: it may be the same */
+  environment_release(env->enclosing);
+  env->enclosing = enclosing;
+  env->stamp = next_stamp++;
+  env->names = 0;
+}
+
 void environment_free(Environment *env) {
   if (!env)
     return;
@@ -22,20 +133,24 @@ void environment_free(Environment *env) {
   }
   free(env->values.keys);
   free(env->values.values);
+  free(env->values.index);
+  environment_release(env->enclosing);
   free(env);
+  mem_counters.environments--;
 }
 
 void environment_define(Environment *env, const char *name, Value *value) {
   // Check if variable already exists
-  for (size_t i = 0; i < env->values.count; i++) {
-    if (strcmp(env->values.keys[i], name) == 0) {
-      // Replace existing value
-      if (env->values.values[i]) {
-        value_free(env->values.values[i]);
-      }
-      env->values.values[i] = value; /* take ownership */
-      return;
+  uint32_t hash = name_hash(name);
+  size_t i = find_key(env, name, hash);
+  if (i < env->values.count) {
+    // Replace existing value
+    if (env->values.values[i]) {
+      value_free(env->values.values[i]);
     }
+    env->values.values[i] = value; /* take ownership */
+    environment_adopt(&env->values.values[i], value);
+    return;
   }
 
   // Add new variable
@@ -49,23 +164,33 @@ void environment_define(Environment *env, const char *name, Value *value) {
   }
 
   env->values.keys[env->values.count] = malloc(strlen(name) + 1);
+  ALLOC_TRACK(ALLOC_ENV_KEY, 1, strlen(name) + 1);
   strcpy(env->values.keys[env->values.count], name);
   env->values.values[env->values.count] = value; /* take ownership */
   env->values.count++;
+  env->names |= name_bit(hash);
+  if (env->values.count * 2 > env->values.index_size) {
+    if (env->values.count > ENV_INDEX_MIN)
+      index_grow(env);
+  } else {
+    index_insert(env, env->values.count - 1, hash);
+  }
+  environment_adopt(&env->values.values[env->values.count - 1], value);
 }
 
 Value *environment_get(Environment *env, Token *name, RuntimeError **error, const char *filename) {
-  // Search current environment
-  for (size_t i = 0; i < env->values.count; i++) {
-    if (strcmp(env->values.keys[i], name->lexeme) == 0) {
-      return env->values.values[i];
+  // Search the current environment, then each enclosing one
+  uint32_t hash = name_hash(name->lexeme);
+  size_t depth = 0;
+  for (Environment *scope = env; scope != NULL; scope = scope->enclosing) {
+    size_t i = find_key(scope, name->lexeme, hash);
+    if (i < scope->values.count) {
+      STATS_LOOKUP(depth, true);
+      return scope->values.values[i];
     }
+    depth++;
   }
-
-  // Search enclosing environment
-  if (env->enclosing != NULL) {
-    return environment_get(env->enclosing, name, error, filename);
-  }
+  STATS_LOOKUP(depth, false);
 
   // Variable not found
   char message[256];
@@ -74,17 +199,50 @@ Value *environment_get(Environment *env, Token *name, RuntimeError **error, cons
   return NULL;
 }
 
+/* Resolves NAME from ENV outward, as environment_get does, through the
+ * reference's inline cache: scopes whose name bits rule NAME out are
+ * skipped, and reaching the scope it was last found in costs a stamp
+ * compare. The bits of a scope with a couple of hundred keys are all set,
+ * so such a scope is never skipped, but its keys are probed through its
+ * index rather than compared one by one. Returns the binding's slot, or
+ * NULL if NAME is undefined. */
+Value **environment_lookup(Environment *env, const char *name, LookupCache *cache) {
+  if (!cache->bit) {
+    cache->hash = name_hash(name);
+    cache->bit = name_bit(cache->hash);
+  }
+  size_t depth = 0;
+  for (Environment *scope = env; scope != NULL; scope = scope->enclosing) {
+    if (scope->stamp == cache->stamp) {
+      STATS_LOOKUP(depth, true);
+      return &scope->values.values[cache->index];
+    }
+    if (scope->names & cache->bit) {
+      size_t i = find_key(scope, name, cache->hash);
+      if (i < scope->values.count) {
+        cache->stamp = scope->stamp;
+        cache->index = i;
+        STATS_LOOKUP(depth, true);
+        return &scope->values.values[i];
+      }
+    }
+    depth++;
+  }
+  STATS_LOOKUP(depth, false);
+  return NULL;
+}
+
 void environment_assign(Environment *env, Token *name, Value *value,
                         RuntimeError **error, const char *filename) {
   // Search current environment
-  for (size_t i = 0; i < env->values.count; i++) {
-    if (strcmp(env->values.keys[i], name->lexeme) == 0) {
-      if (env->values.values[i]) {
-        value_free(env->values.values[i]);
-      }
-      env->values.values[i] = value; /* take ownership */
-      return;
+  size_t i = find_key(env, name->lexeme, name_hash(name->lexeme));
+  if (i < env->values.count) {
+    if (env->values.values[i]) {
+      value_free(env->values.values[i]);
     }
+    env->values.values[i] = value; /* take ownership */
+    environment_adopt(&env->values.values[i], value);
+    return;
   }
 
   // Search enclosing environment
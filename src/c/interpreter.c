@@ -4,6 +4,8 @@
 #ifdef _WIN32
   #include <windows.h>
 #else
+  #include <pthread.h>
+  #include <sys/mman.h>
   #include <unistd.h>
 #endif
 
@@ -15,6 +17,7 @@ static char *ms_strdup(const char *s) {
   char *copy = malloc(len + 1);
   if (!copy)
     return NULL;
+  ALLOC_TRACK(ALLOC_STRDUP, 1, len + 1);
   memcpy(copy, s, len + 1);
   return copy;
 }
@@ -50,6 +53,21 @@ static Value *builtin_len(Interpreter *interpreter, Value **args,
   case VALUE_LIST:
     result->as.number = args[0]->as.list->count;
     break;
+  case VALUE_BYTES:
+    result->as.number = args[0]->as.bytes->length;
+    break;
+  case VALUE_RANGE:
+    result->as.number = range_length(args[0]->as.range);
+    break;
+  case VALUE_SET:
+    result->as.number = args[0]->as.set->count;
+    break;
+  case VALUE_DEQUE:
+    result->as.number = args[0]->as.deque->count;
+    break;
+  case VALUE_HEAP:
+    result->as.number = args[0]->as.heap->count;
+    break;
   default:
     value_free(result);
     return NULL; // Error
@@ -68,6 +86,93 @@ static Value *builtin_time_now(Interpreter *interpreter, Value **args,
   return result;
 }
 
+// High-resolution clocks: clock_ns() counts nanoseconds and perf_counter()
+// seconds, both from CLOCK_MONOTONIC (an arbitrary origin, for intervals)
+static Value *builtin_clock_ns(Interpreter *interpreter, Value **args,
+                               int arg_count) {
+  if (arg_count != 0)
+    return NULL;
+
+  Value *result = value_new(VALUE_NUMBER);
+  result->as.number = (double)monotonic_ns();
+  return result;
+}
+
+static Value *builtin_perf_counter(Interpreter *interpreter, Value **args,
+                                   int arg_count) {
+  if (arg_count != 0)
+    return NULL;
+
+  Value *result = value_new(VALUE_NUMBER);
+  result->as.number = (double)monotonic_ns() / 1e9;
+  return result;
+}
+
+/* Keeps ERROR, raised by a function a builtin called, to be reported in
+ * place of the generic builtin error once the builtin returns NULL */
+static void builtin_raise(Interpreter *interpreter, RuntimeError *error) {
+  runtime_error_free(interpreter->builtin_error);
+  interpreter->builtin_error = error;
+}
+
+static int compare_samples(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+// bench(fn, iterations): calls fn() untimed for a tenth of the iterations
+// (at least one) to warm up, then times each of ITERATIONS calls and returns
+// [min, median, p99] in nanoseconds
+static Value *builtin_bench(Interpreter *interpreter, Value **args,
+                            int arg_count) {
+  if (arg_count != 2)
+    return NULL;
+
+  if (args[0]->type != VALUE_FUNCTION || args[1]->type != VALUE_NUMBER ||
+      args[1]->as.number < 1)
+    return NULL;
+
+  size_t iterations = (size_t)args[1]->as.number;
+  size_t warmup = iterations / 10 > 0 ? iterations / 10 : 1;
+  double *samples = malloc(iterations * sizeof(double));
+  if (!samples)
+    return NULL;
+
+  for (size_t i = 0; i < warmup + iterations; i++) {
+    RuntimeError *error = NULL;
+    uint64_t start = monotonic_ns();
+    Value *value = interpreter_call_function(interpreter, args[0], NULL, 0, 0, &error);
+    uint64_t elapsed = monotonic_ns() - start;
+    if (value)
+      value_free(value);
+    if (error) {
+      builtin_raise(interpreter, error);
+      free(samples);
+      return NULL; // Error: the benchmarked function failed
+    }
+    if (i >= warmup)
+      samples[i - warmup] = (double)elapsed;
+  }
+
+  qsort(samples, iterations, sizeof(double), compare_samples);
+  double median = iterations % 2 == 1
+                      ? samples[iterations / 2]
+                      : (samples[iterations / 2 - 1] + samples[iterations / 2]) / 2;
+  size_t p99_rank = (iterations * 99 + 99) / 100; /* nearest rank, 1-based */
+
+  Value *result = value_new(VALUE_LIST);
+  result->as.list = value_list_new(3);
+  result->as.list->count = 3;
+  result->as.list->elements[0].type = VALUE_NUMBER;
+  result->as.list->elements[0].as.number = samples[0];
+  result->as.list->elements[1].type = VALUE_NUMBER;
+  result->as.list->elements[1].as.number = median;
+  result->as.list->elements[2].type = VALUE_NUMBER;
+  result->as.list->elements[2].as.number = samples[p99_rank - 1];
+  free(samples);
+  return result;
+}
+
 static Value *builtin_time_add(Interpreter *interpreter, Value **args,
                                int arg_count) {
   if (arg_count != 2)
@@ -397,6 +502,7 @@ static Value *builtin_fopen(Interpreter *interpreter, Value **args, int arg_coun
     return result;
   }
   
+  mem_counters.open_files++;
   Value *result = value_new(VALUE_FILE_HANDLE);
   result->as.file_handle = file;
   return result;
@@ -421,6 +527,7 @@ static Value *builtin_fclose(Interpreter *interpreter, Value **args, int arg_cou
   
   int result_code = fclose(file);
   args[0]->as.file_handle = NULL; // Mark as closed to prevent double-close
+  mem_counters.open_files--;
   
   Value *result = value_new(VALUE_NUMBER);
   result->as.number = (double)result_code;
@@ -579,195 +686,2007 @@ static Value *builtin_fexists(Interpreter *interpreter, Value **args, int arg_co
   return result;
 }
 
-static Value *call_builtin_function(Interpreter *interpreter, const char *name,
-                                    Value **args, int arg_count) {
-  if (strcmp(name, "print") == 0) {
-    return builtin_print(interpreter, args, arg_count);
-  } else if (strcmp(name, "len") == 0) {
-    return builtin_len(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_now") == 0) {
-    return builtin_time_now(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_add") == 0) {
-    return builtin_time_add(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_diff") == 0) {
-    return builtin_time_diff(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_parse") == 0) {
-    return builtin_time_parse(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_format") == 0) {
-    return builtin_time_format(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_year") == 0) {
-    return builtin_time_year(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_month") == 0) {
-    return builtin_time_month(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_day") == 0) {
-    return builtin_time_day(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_hour") == 0) {
-    return builtin_time_hour(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_minute") == 0) {
-    return builtin_time_minute(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_second") == 0) {
-    return builtin_time_second(interpreter, args, arg_count);
-  } else if (strcmp(name, "time_weekday") == 0) {
-    return builtin_time_weekday(interpreter, args, arg_count);
-  } else if (strcmp(name, "sleep") == 0) {
-    return builtin_sleep(interpreter, args, arg_count);
-  } else if (strcmp(name, "assert") == 0) {
-    return builtin_assert(interpreter, args, arg_count);
-  } else if (strcmp(name, "fopen") == 0) {
-    return builtin_fopen(interpreter, args, arg_count);
-  } else if (strcmp(name, "fclose") == 0) {
-    return builtin_fclose(interpreter, args, arg_count);
-  } else if (strcmp(name, "fwrite") == 0) {
-    return builtin_fwrite(interpreter, args, arg_count);
-  } else if (strcmp(name, "fread") == 0) {
-    return builtin_fread(interpreter, args, arg_count);
-  } else if (strcmp(name, "freadline") == 0) {
-    return builtin_freadline(interpreter, args, arg_count);
-  } else if (strcmp(name, "fwriteline") == 0) {
-    return builtin_fwriteline(interpreter, args, arg_count);
-  } else if (strcmp(name, "fexists") == 0) {
-    return builtin_fexists(interpreter, args, arg_count);
+/* Byte buffer and binary packing functions */
+static Value *bytes_value_new(ByteBuffer *buffer) {
+  Value *result = value_new(VALUE_BYTES);
+  result->as.bytes = buffer;
+  return result;
+}
+
+/* Largest zero-filled buffer bytes(n) allocates (1 GiB) */
+#define BYTES_MAX_LENGTH 1073741824.0
+
+static Value *builtin_bytes(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 1) {
+    return NULL; // Error: wrong number of arguments
   }
 
-  return NULL; // Unknown builtin
+  switch (args[0]->type) {
+  case VALUE_NUMBER: {
+    // Written to also reject NaN, which fails every comparison
+    if (!(args[0]->as.number >= 0 && args[0]->as.number <= BYTES_MAX_LENGTH)) {
+      return NULL; // Error: negative, not a number or too large
+    }
+    return bytes_value_new(byte_buffer_new((size_t)args[0]->as.number));
+  }
+  case VALUE_STRING: {
+    size_t length = strlen(args[0]->as.string);
+    ByteBuffer *buffer = byte_buffer_new(length);
+    memcpy(buffer->data, args[0]->as.string, length);
+    return bytes_value_new(buffer);
+  }
+  case VALUE_BYTES: {
+    // Independent copy of the contents
+    ByteBuffer *buffer = byte_buffer_new(args[0]->as.bytes->length);
+    memcpy(buffer->data, args[0]->as.bytes->data, args[0]->as.bytes->length);
+    return bytes_value_new(buffer);
+  }
+  case VALUE_LIST: {
+    ValueList *list = args[0]->as.list;
+    ByteBuffer *buffer = byte_buffer_new(list->count);
+    for (size_t i = 0; i < list->count; i++) {
+      Value *element = &list->elements[i];
+      if (element->type != VALUE_NUMBER ||
+          !(element->as.number >= 0 && element->as.number <= 255)) {
+        byte_buffer_release(buffer);
+        return NULL; // Error: elements must be byte values
+      }
+      buffer->data[i] = (unsigned char)element->as.number;
+    }
+    return bytes_value_new(buffer);
+  }
+  default:
+    return NULL; // Error: invalid argument type
+  }
 }
 
-/* Interpreter implementation */
-Interpreter *interpreter_new(void) {
-  Interpreter *interpreter = malloc(sizeof(Interpreter));
-  interpreter->globals = environment_new(NULL);
-  interpreter->environment = interpreter->globals;
-  interpreter->modules_path = NULL;
-  interpreter->modules_path_count = 0;
-  interpreter->return_value = NULL;
-  interpreter->current_filename = NULL;
+static Value *builtin_bytes_append(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 2 || args[0]->type != VALUE_BYTES) {
+    return NULL; // Error: invalid arguments
+  }
 
-  interpreter_define_builtins(interpreter);
+  ByteBuffer *buffer = args[0]->as.bytes;
+  switch (args[1]->type) {
+  case VALUE_NUMBER: {
+    if (args[1]->as.number < 0 || args[1]->as.number > 255) {
+      return NULL; // Error: not a byte value
+    }
+    unsigned char byte = (unsigned char)args[1]->as.number;
+    byte_buffer_append(buffer, &byte, 1);
+    break;
+  }
+  case VALUE_STRING:
+    byte_buffer_append(buffer, (const unsigned char *)args[1]->as.string,
+                       strlen(args[1]->as.string));
+    break;
+  case VALUE_BYTES: {
+    // Copy first: appending a buffer to itself may reallocate the source
+    ByteBuffer *other = args[1]->as.bytes;
+    size_t length = other->length;
+    unsigned char *data = malloc(length > 0 ? length : 1);
+    memcpy(data, other->data, length);
+    byte_buffer_append(buffer, data, length);
+    free(data);
+    break;
+  }
+  default:
+    return NULL; // Error: invalid argument type
+  }
 
-  return interpreter;
+  Value *result = value_new(VALUE_NUMBER);
+  result->as.number = (double)buffer->length;
+  return result;
 }
 
-void interpreter_free(Interpreter *interpreter) {
-  if (interpreter) {
-    environment_free(interpreter->globals);
-    for (size_t i = 0; i < interpreter->modules_path_count; i++) {
-      free(interpreter->modules_path[i]);
-    }
-    free(interpreter->modules_path);
-    if (interpreter->return_value) {
-      value_free(interpreter->return_value);
-    }
-    if (interpreter->current_filename) {
-      free(interpreter->current_filename);
+/* Parse the byte-order prefix of a pack format. Returns true for
+ * little-endian. The default (no prefix) is little-endian without padding. */
+static bool pack_format_order(const char **fmt) {
+  static const union {
+    unsigned short word;
+    unsigned char bytes[2];
+  } probe = {1};
+
+  switch (**fmt) {
+  case '<':
+    (*fmt)++;
+    return true;
+  case '>':
+  case '!':
+    (*fmt)++;
+    return false;
+  case '=':
+    (*fmt)++;
+    return probe.bytes[0] == 1;
+  default:
+    return true;
+  }
+}
+
+/* Read the next "[count]code" item from a pack format. Returns false at the
+ * end of the format; sets *code to '\0' on a malformed item. */
+static bool pack_format_next(const char **fmt, char *code, size_t *count) {
+  while (**fmt == ' ')
+    (*fmt)++;
+  if (**fmt == '\0')
+    return false;
+
+  *count = 1;
+  if (**fmt >= '0' && **fmt <= '9') {
+    *count = 0;
+    while (**fmt >= '0' && **fmt <= '9') {
+      *count = *count * 10 + (size_t)(**fmt - '0');
+      (*fmt)++;
     }
-    free(interpreter);
   }
+
+  *code = **fmt;
+  if (*code != '\0')
+    (*fmt)++;
+  return true;
 }
 
-void interpreter_set_filename(Interpreter *interpreter, const char *filename) {
-  if (interpreter->current_filename) {
-    free(interpreter->current_filename);
+/* Size in bytes of a pack code, or 0 if the code is unknown */
+static size_t pack_code_size(char code) {
+  switch (code) {
+  case 'x':
+  case 'b':
+  case 'B':
+    return 1;
+  case 'h':
+  case 'H':
+    return 2;
+  case 'i':
+  case 'I':
+  case 'f':
+    return 4;
+  case 'q':
+  case 'Q':
+  case 'd':
+    return 8;
+  default:
+    return 0;
   }
-  if (filename) {
-    interpreter->current_filename = ms_strdup(filename);
+}
+
+static void pack_store(unsigned char *out, unsigned long long bits, size_t size,
+                       bool little_endian) {
+  for (size_t k = 0; k < size; k++) {
+    unsigned char byte = (unsigned char)((bits >> (8 * k)) & 0xff);
+    out[little_endian ? k : size - 1 - k] = byte;
+  }
+}
+
+static unsigned long long pack_load(const unsigned char *in, size_t size,
+                                    bool little_endian) {
+  unsigned long long bits = 0;
+  for (size_t k = 0; k < size; k++) {
+    unsigned long long byte = in[little_endian ? k : size - 1 - k];
+    bits |= byte << (8 * k);
+  }
+  return bits;
+}
+
+/* Encode one number as a pack code; returns false if it does not fit */
+static bool pack_encode(char code, double number, unsigned char *out,
+                        bool little_endian) {
+  size_t size = pack_code_size(code);
+  unsigned long long bits;
+
+  if (code == 'f') {
+    float narrow = (float)number;
+    unsigned int raw;
+    memcpy(&raw, &narrow, sizeof(raw));
+    bits = raw;
+  } else if (code == 'd') {
+    memcpy(&bits, &number, sizeof(bits));
+  } else if (number != number || number != floor(number)) {
+    return false; // Integer codes need integral values
+  } else if (code >= 'a' && code <= 'z') {
+    double limit = ldexp(1.0, (int)(8 * size - 1));
+    if (number < -limit || number >= limit)
+      return false;
+    bits = (unsigned long long)(long long)number;
   } else {
-    interpreter->current_filename = NULL;
+    if (number < 0 || number >= ldexp(1.0, (int)(8 * size)))
+      return false;
+    bits = (unsigned long long)number;
   }
+
+  pack_store(out, bits, size, little_endian);
+  return true;
 }
 
-void interpreter_define_builtins(Interpreter *interpreter) {
-  Value *print_builtin = value_new(VALUE_BUILTIN);
-  print_builtin->as.builtin_name = ms_strdup("print");
-  environment_define(interpreter->globals, "print", print_builtin);
+static double pack_decode(char code, const unsigned char *in,
+                          bool little_endian) {
+  size_t size = pack_code_size(code);
+  unsigned long long bits = pack_load(in, size, little_endian);
+
+  switch (code) {
+  case 'f': {
+    unsigned int raw = (unsigned int)bits;
+    float narrow;
+    memcpy(&narrow, &raw, sizeof(narrow));
+    return (double)narrow;
+  }
+  case 'd': {
+    double wide;
+    memcpy(&wide, &bits, sizeof(wide));
+    return wide;
+  }
+  case 'b':
+  case 'h':
+  case 'i':
+  case 'q': {
+    // Sign-extend from the field width
+    unsigned long long sign = 1ULL << (8 * size - 1);
+    if (bits & sign) {
+      return (double)(long long)(bits | ~((sign << 1) - 1));
+    }
+    return (double)bits;
+  }
+  default:
+    return (double)bits;
+  }
+}
 
-  Value *len_builtin = value_new(VALUE_BUILTIN);
-  len_builtin->as.builtin_name = ms_strdup("len");
-  environment_define(interpreter->globals, "len", len_builtin);
+static Value *builtin_pack(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count < 1 || args[0]->type != VALUE_STRING) {
+    return NULL; // Error: format string required
+  }
 
-  Value *time_now_builtin = value_new(VALUE_BUILTIN);
-  time_now_builtin->as.builtin_name = ms_strdup("time_now");
-  environment_define(interpreter->globals, "time_now", time_now_builtin);
+  const char *fmt = args[0]->as.string;
+  bool little_endian = pack_format_order(&fmt);
+  ByteBuffer *buffer = byte_buffer_new(0);
+  int next_arg = 1;
+  char code;
+  size_t count;
 
-  Value *time_add_builtin = value_new(VALUE_BUILTIN);
-  time_add_builtin->as.builtin_name = ms_strdup("time_add");
-  environment_define(interpreter->globals, "time_add", time_add_builtin);
+  while (pack_format_next(&fmt, &code, &count)) {
+    size_t size = pack_code_size(code);
+    if (size == 0) {
+      byte_buffer_release(buffer);
+      return NULL; // Error: unknown format code
+    }
+    for (size_t i = 0; i < count; i++) {
+      unsigned char field[8] = {0};
+      if (code != 'x') {
+        if (next_arg >= arg_count || args[next_arg]->type != VALUE_NUMBER ||
+            !pack_encode(code, args[next_arg]->as.number, field,
+                         little_endian)) {
+          byte_buffer_release(buffer);
+          return NULL; // Error: missing, non-numeric or out-of-range value
+        }
+        next_arg++;
+      }
+      byte_buffer_append(buffer, field, size);
+    }
+  }
 
-  Value *time_diff_builtin = value_new(VALUE_BUILTIN);
-  time_diff_builtin->as.builtin_name = ms_strdup("time_diff");
-  environment_define(interpreter->globals, "time_diff", time_diff_builtin);
+  if (next_arg != arg_count) {
+    byte_buffer_release(buffer);
+    return NULL; // Error: too many values for format
+  }
 
-  Value *time_parse_builtin = value_new(VALUE_BUILTIN);
-  time_parse_builtin->as.builtin_name = ms_strdup("time_parse");
-  environment_define(interpreter->globals, "time_parse", time_parse_builtin);
+  return bytes_value_new(buffer);
+}
 
-  Value *time_format_builtin = value_new(VALUE_BUILTIN);
-  time_format_builtin->as.builtin_name = ms_strdup("time_format");
-  environment_define(interpreter->globals, "time_format", time_format_builtin);
+static Value *builtin_unpack(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count < 2 || arg_count > 3) {
+    return NULL; // Error: wrong number of arguments
+  }
 
-  Value *time_year_builtin = value_new(VALUE_BUILTIN);
-  time_year_builtin->as.builtin_name = ms_strdup("time_year");
-  environment_define(interpreter->globals, "time_year", time_year_builtin);
+  if (args[0]->type != VALUE_STRING || args[1]->type != VALUE_BYTES ||
+      (arg_count == 3 && args[2]->type != VALUE_NUMBER)) {
+    return NULL; // Error: invalid argument types
+  }
 
-  Value *time_month_builtin = value_new(VALUE_BUILTIN);
-  time_month_builtin->as.builtin_name = ms_strdup("time_month");
-  environment_define(interpreter->globals, "time_month", time_month_builtin);
+  ByteBuffer *buffer = args[1]->as.bytes;
+  double start = arg_count == 3 ? args[2]->as.number : 0;
+  if (start < 0 || start > (double)buffer->length) {
+    return NULL; // Error: offset out of range
+  }
+  size_t offset = (size_t)start;
 
-  Value *time_day_builtin = value_new(VALUE_BUILTIN);
-  time_day_builtin->as.builtin_name = ms_strdup("time_day");
-  environment_define(interpreter->globals, "time_day", time_day_builtin);
+  const char *fmt = args[0]->as.string;
+  bool little_endian = pack_format_order(&fmt);
 
-  Value *time_hour_builtin = value_new(VALUE_BUILTIN);
-  time_hour_builtin->as.builtin_name = ms_strdup("time_hour");
-  environment_define(interpreter->globals, "time_hour", time_hour_builtin);
+  Value *result = value_new(VALUE_LIST);
+  result->as.list = value_list_new(8);
 
-  Value *time_minute_builtin = value_new(VALUE_BUILTIN);
-  time_minute_builtin->as.builtin_name = ms_strdup("time_minute");
-  environment_define(interpreter->globals, "time_minute", time_minute_builtin);
+  char code;
+  size_t count;
+  while (pack_format_next(&fmt, &code, &count)) {
+    size_t size = pack_code_size(code);
+    if (size == 0 || count > (buffer->length - offset) / size) {
+      value_free(result);
+      return NULL; // Error: unknown code or read past end of buffer
+    }
+    for (size_t i = 0; i < count; i++, offset += size) {
+      if (code == 'x')
+        continue;
+      ValueList *list = result->as.list;
+      if (list->count >= list->capacity) {
+        list->capacity *= 2;
+        list->elements = realloc(list->elements, list->capacity * sizeof(Value));
+      }
+      list->elements[list->count].type = VALUE_NUMBER;
+      list->elements[list->count].as.number =
+          pack_decode(code, buffer->data + offset, little_endian);
+      list->count++;
+    }
+  }
 
-  Value *time_second_builtin = value_new(VALUE_BUILTIN);
-  time_second_builtin->as.builtin_name = ms_strdup("time_second");
-  environment_define(interpreter->globals, "time_second", time_second_builtin);
+  return result;
+}
 
-  Value *time_weekday_builtin = value_new(VALUE_BUILTIN);
-  time_weekday_builtin->as.builtin_name = ms_strdup("time_weekday");
-  environment_define(interpreter->globals, "time_weekday", time_weekday_builtin);
+static Value *builtin_fread_bytes(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count < 1 || arg_count > 2) {
+    return NULL; // Error: wrong number of arguments
+  }
 
-  Value *sleep_builtin = value_new(VALUE_BUILTIN);
-  sleep_builtin->as.builtin_name = ms_strdup("sleep");
-  environment_define(interpreter->globals, "sleep", sleep_builtin);
+  if (args[0]->type != VALUE_FILE_HANDLE ||
+      (arg_count == 2 && (args[1]->type != VALUE_NUMBER || args[1]->as.number < 0))) {
+    return NULL; // Error: invalid argument types
+  }
+
+  ByteBuffer *buffer = byte_buffer_new(0);
+  FILE *file = args[0]->as.file_handle;
+  if (file == NULL) {
+    return bytes_value_new(buffer); // Closed file reads as empty
+  }
+
+  // Read up to the requested count, or to end of file
+  bool bounded = arg_count == 2;
+  size_t wanted = bounded ? (size_t)args[1]->as.number : 0;
+  unsigned char chunk[8192];
+  while (!bounded || buffer->length < wanted) {
+    size_t request = sizeof(chunk);
+    if (bounded && wanted - buffer->length < request)
+      request = wanted - buffer->length;
+    size_t got = fread(chunk, 1, request, file);
+    byte_buffer_append(buffer, chunk, got);
+    if (got < request)
+      break;
+  }
+
+  return bytes_value_new(buffer);
+}
+
+static Value *builtin_fwrite_bytes(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 2) {
+    return NULL; // Error: wrong number of arguments
+  }
+
+  if (args[0]->type != VALUE_FILE_HANDLE || args[1]->type != VALUE_BYTES) {
+    return NULL; // Error: invalid argument types
+  }
+
+  FILE *file = args[0]->as.file_handle;
+  Value *result = value_new(VALUE_NUMBER);
+  if (file == NULL) {
+    result->as.number = 0.0; // Can't write to closed file
+    return result;
+  }
+
+  size_t bytes_written =
+      fwrite(args[1]->as.bytes->data, 1, args[1]->as.bytes->length, file);
+  fflush(file);
+
+  result->as.number = (double)bytes_written;
+  return result;
+}
+
+// Memory statistics: mem_stats() returns a list of [name, value] pairs;
+// mem_stats(name) returns the single value
+static Value *builtin_mem_stats(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count > 1 || (arg_count == 1 && args[0]->type != VALUE_STRING)) {
+    return NULL; // Error: optional argument must be a field name
+  }
+
+  MemStats stats;
+  mem_stats_collect(interpreter, &stats);
+  size_t field_count = mem_stats_field_count();
+
+  if (arg_count == 1) {
+    for (size_t i = 0; i < field_count; i++) {
+      if (strcmp(args[0]->as.string, mem_stats_field_name(i)) == 0) {
+        Value *result = value_new(VALUE_NUMBER);
+        result->as.number = (double)mem_stats_field(&stats, i);
+        return result;
+      }
+    }
+    return NULL; // Error: unknown field
+  }
+
+  Value *result = value_new(VALUE_LIST);
+  result->as.list = value_list_new(field_count);
+  result->as.list->count = field_count;
+  for (size_t i = 0; i < field_count; i++) {
+    ValueList *pair = value_list_new(2);
+    pair->count = 2;
+    pair->elements[0].type = VALUE_STRING;
+    pair->elements[0].as.string = ms_strdup(mem_stats_field_name(i));
+    pair->elements[1].type = VALUE_NUMBER;
+    pair->elements[1].as.number = (double)mem_stats_field(&stats, i);
+    result->as.list->elements[i].type = VALUE_LIST;
+    result->as.list->elements[i].as.list = pair;
+  }
+  return result;
+}
+
+static bool is_callable(Value *value) {
+  return value->type == VALUE_FUNCTION || value->type == VALUE_BUILTIN;
+}
+
+/* Calls the key function KEY_FN (a function or builtin) on ELEMENT; NULL if
+ * it fails, after keeping a function's error to report for the builtin */
+static Value *call_key_function(Interpreter *interpreter, Value *key_fn, Value *element) {
+  RuntimeError *error = NULL;
+  Value *key = key_fn->type == VALUE_FUNCTION
+                   ? interpreter_call_function(interpreter, key_fn, &element, 1, 0, &error)
+                   : interpreter_call_builtin(interpreter, key_fn->as.builtin_name, &element, 1);
+  if (error) {
+    builtin_raise(interpreter, error);
+    value_free(key);
+    key = NULL;
+  }
+  return key;
+}
+
+// sort(list): sorts LIST where it is stored, so every variable holding it
+// sees the result, and returns it. The elements must be all numbers
+// (ascending) or all strings (byte order).
+static Value *builtin_sort(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 1 || args[0]->type != VALUE_LIST)
+    return NULL;
+
+  ValueList *list = args[0]->as.list;
+  if (!sort_values(list->elements, list->count))
+    return NULL; // Error: mixed or unorderable elements
+  return value_copy(args[0]);
+}
+
+// sort_by(list, key_fn): sorts LIST in place by key_fn(element), called once
+// per element, and returns it. The keys must be all numbers or all strings;
+// elements with equal keys keep their order.
+static Value *builtin_sort_by(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 2 || args[0]->type != VALUE_LIST || !is_callable(args[1]))
+    return NULL;
+
+  ValueList *list = args[0]->as.list;
+  size_t count = list->count;
+  Value *keys = malloc((count > 0 ? count : 1) * sizeof(Value));
+  size_t key_count = 0;
+  bool ok = true;
+  for (; key_count < count && ok; key_count++) {
+    Value *key = call_key_function(interpreter, args[1], &list->elements[key_count]);
+    if (!key) {
+      ok = false; // Error: the key function failed
+      break;
+    }
+    keys[key_count] = *key;
+    free(key); /* contents now live inline in KEYS */
+    mem_counters.values--;
+  }
+
+  /* The key function may have shrunk or grown the list meanwhile */
+  ok = ok && list->count == count && sort_values_by(list->elements, keys, count);
+  for (size_t i = 0; i < key_count; i++)
+    value_dispose_inline(&keys[i]);
+  free(keys);
+  return ok ? value_copy(args[0]) : NULL;
+}
+
+// range(stop), range(start, stop) or range(start, stop, step): the numbers
+// from START (default 0) up to but excluding STOP, STEP (default 1) apart.
+// Lazy: elements are computed when indexed or iterated, never stored.
+static Value *builtin_range(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count < 1 || arg_count > 3)
+    return NULL;
+  for (int i = 0; i < arg_count; i++) {
+    if (args[i]->type != VALUE_NUMBER)
+      return NULL;
+  }
+
+  RangeValue range = {0, 0, 1};
+  if (arg_count == 1) {
+    range.stop = args[0]->as.number;
+  } else {
+    range.start = args[0]->as.number;
+    range.stop = args[1]->as.number;
+  }
+  if (arg_count == 3)
+    range.step = args[2]->as.number;
+  if (range.step == 0 || range.step != range.step)
+    return NULL; // Error: the range would never end
+
+  Value *result = value_new(VALUE_RANGE);
+  result->as.range = malloc(sizeof(RangeValue));
+  *result->as.range = range;
+  return result;
+}
+
+static Value *set_value_new(ValueSet *set) {
+  Value *result = value_new(VALUE_SET);
+  result->as.set = set;
+  return result;
+}
+
+static Value *boolean_value_new(bool boolean) {
+  Value *result = value_new(VALUE_BOOLEAN);
+  result->as.boolean = boolean;
+  return result;
+}
+
+// set() or set(elements): a new set, empty or holding the elements of a
+// list or set. Elements must be numbers, strings, booleans or nil.
+static Value *builtin_set(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count == 0)
+    return set_value_new(value_set_new(0));
+  if (arg_count != 1)
+    return NULL;
+
+  Value *elements;
+  size_t count;
+  if (args[0]->type == VALUE_LIST) {
+    elements = args[0]->as.list->elements;
+    count = args[0]->as.list->count;
+  } else if (args[0]->type == VALUE_SET) {
+    elements = args[0]->as.set->elements;
+    count = args[0]->as.set->count;
+  } else {
+    return NULL;
+  }
+
+  ValueSet *set = value_set_new(count);
+  for (size_t i = 0; i < count; i++) {
+    if (!value_hashable(&elements[i])) {
+      value_set_release(set);
+      return NULL; // Error: element cannot be hashed
+    }
+    value_set_add(set, &elements[i]);
+  }
+  return set_value_new(set);
+}
+
+// add(set, value): adds VALUE to SET in place; true if it was not there yet
+static Value *builtin_add(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 2 || args[0]->type != VALUE_SET || !value_hashable(args[1]))
+    return NULL;
+  return boolean_value_new(value_set_add(args[0]->as.set, args[1]));
+}
+
+// has(set, value): whether VALUE is in SET
+static Value *builtin_has(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 2 || args[0]->type != VALUE_SET)
+    return NULL;
+  return boolean_value_new(value_set_has(args[0]->as.set, args[1]));
+}
+
+// remove(set, value): removes VALUE from SET in place; true if it was there
+static Value *builtin_remove(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 2 || args[0]->type != VALUE_SET)
+    return NULL;
+  return boolean_value_new(value_set_remove(args[0]->as.set, args[1]));
+}
+
+typedef enum { SET_UNION, SET_INTERSECT, SET_DIFFERENCE } SetOperation;
+
+// union(a, b), intersect(a, b) and difference(a, b): a new set, with the
+// elements in the order they appear in A (then B, for a union)
+static Value *set_operation(Value **args, int arg_count, SetOperation operation) {
+  if (arg_count != 2 || args[0]->type != VALUE_SET || args[1]->type != VALUE_SET)
+    return NULL;
+
+  ValueSet *a = args[0]->as.set;
+  ValueSet *b = args[1]->as.set;
+  ValueSet *result = value_set_new(operation == SET_UNION ? a->count + b->count : a->count);
+  for (size_t i = 0; i < a->count; i++) {
+    if (operation == SET_UNION ||
+        value_set_has(b, &a->elements[i]) == (operation == SET_INTERSECT))
+      value_set_add(result, &a->elements[i]);
+  }
+  if (operation == SET_UNION) {
+    for (size_t i = 0; i < b->count; i++)
+      value_set_add(result, &b->elements[i]);
+  }
+  return set_value_new(result);
+}
+
+// deque() or deque(list): a new double-ended queue, empty or holding the
+// elements of LIST
+static Value *builtin_deque(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count > 1 || (arg_count == 1 && args[0]->type != VALUE_LIST))
+    return NULL;
+
+  size_t count = arg_count == 1 ? args[0]->as.list->count : 0;
+  ValueDeque *deque = value_deque_new(count);
+  for (size_t i = 0; i < count; i++)
+    value_deque_push_back(deque, value_copy(&args[0]->as.list->elements[i]));
+  Value *result = value_new(VALUE_DEQUE);
+  result->as.deque = deque;
+  return result;
+}
+
+// push_back(deque, value) and push_front(deque, value): add VALUE at one
+// end in place; return the new length
+static Value *deque_push(Value **args, int arg_count, bool front) {
+  if (arg_count != 2 || args[0]->type != VALUE_DEQUE)
+    return NULL;
+
+  ValueDeque *deque = args[0]->as.deque;
+  if (front)
+    value_deque_push_front(deque, value_copy(args[1]));
+  else
+    value_deque_push_back(deque, value_copy(args[1]));
+  Value *result = value_new(VALUE_NUMBER);
+  result->as.number = deque->count;
+  return result;
+}
+
+// pop_back(deque) and pop_front(deque): remove and return the element at one
+// end; an error when the deque is empty
+static Value *deque_pop(Value **args, int arg_count, bool front) {
+  if (arg_count != 1 || args[0]->type != VALUE_DEQUE)
+    return NULL;
+  return front ? value_deque_pop_front(args[0]->as.deque)
+               : value_deque_pop_back(args[0]->as.deque);
+}
+
+// heap() or heap(key_fn): a new priority queue that pops the element with
+// the least key first, where the key is the element itself or key_fn(element),
+// called once per push. Elements with equal keys pop in the order pushed.
+static Value *builtin_heap(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count > 1 || (arg_count == 1 && !is_callable(args[0])))
+    return NULL;
+
+  Value *result = value_new(VALUE_HEAP);
+  result->as.heap = value_heap_new(arg_count == 1 ? value_copy(args[0]) : NULL);
+  return result;
+}
+
+// heap_push(heap, value): adds VALUE in place; returns the new length
+static Value *builtin_heap_push(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 2 || args[0]->type != VALUE_HEAP)
+    return NULL;
+
+  ValueHeap *heap = args[0]->as.heap;
+  Value *key = NULL;
+  if (heap->key_fn && !(key = call_key_function(interpreter, heap->key_fn, args[1])))
+    return NULL; // Error: the key function failed
+  Value *element = value_copy(args[1]);
+  if (!value_heap_push(heap, key, element, heap->pushes++)) {
+    value_free(key);
+    value_free(element);
+    return NULL; // Error: key not a number or string, or of another type
+  }
+  Value *result = value_new(VALUE_NUMBER);
+  result->as.number = heap->count;
+  return result;
+}
+
+// heap_pop(heap) and heap_peek(heap): remove and return, or return, the
+// element with the least key; an error when the heap is empty
+static Value *builtin_heap_pop(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 1 || args[0]->type != VALUE_HEAP)
+    return NULL;
+  return value_heap_pop(args[0]->as.heap);
+}
+
+static Value *builtin_heap_peek(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count != 1 || args[0]->type != VALUE_HEAP || args[0]->as.heap->count == 0)
+    return NULL;
+  return value_copy(&args[0]->as.heap->entries[0].element);
+}
+
+// top_k(list, k) or top_k(list, k, key_fn): the K elements of LIST with the
+// greatest keys, greatest first; of elements with equal keys, the earlier
+// ones. Keeps the best K seen so far in a heap whose top is the worst of
+// them, so it takes O(n log k) and calls key_fn once per element.
+static Value *builtin_top_k(Interpreter *interpreter, Value **args, int arg_count) {
+  if (arg_count < 2 || arg_count > 3 || args[0]->type != VALUE_LIST ||
+      args[1]->type != VALUE_NUMBER || !(args[1]->as.number >= 0) ||
+      (arg_count == 3 && !is_callable(args[2])))
+    return NULL;
+
+  ValueList *list = args[0]->as.list;
+  size_t k = args[1]->as.number < (double)list->count ? (size_t)args[1]->as.number : list->count;
+  Value *key_fn = arg_count == 3 ? args[2] : NULL;
+
+  /* Entries hold the element's index. Ordering equal keys by descending
+   * index puts the latest of them on top, to be replaced first. */
+  ValueHeap *heap = value_heap_new(NULL);
+  bool ok = true;
+  for (size_t i = 0; i < list->count && ok; i++) {
+    Value *element = &list->elements[i];
+    Value *key = NULL;
+    if (key_fn && !(key = call_key_function(interpreter, key_fn, element))) {
+      ok = false; // Error: the key function failed
+      break;
+    }
+    if (heap->count == k) {
+      const Value *candidate = key ? key : element;
+      const Value *top = value_heap_top_key(heap);
+      if (!top || (candidate->type == top->type && value_key_compare(candidate, top) <= 0)) {
+        value_free(key); /* not among the best K (or K is 0) */
+        continue;
+      }
+    }
+    if (!key)
+      key = value_copy(element); /* copied only when it enters the heap */
+    Value *index = value_new(VALUE_NUMBER);
+    index->as.number = (double)i;
+    if (heap->count < k ? value_heap_push(heap, key, index, UINT64_MAX - i)
+                        : value_heap_replace_top(heap, key, index, UINT64_MAX - i))
+      continue;
+    value_free(key);
+    value_free(index);
+    ok = false; // Error: key not a number or string, or of another type
+  }
+
+  Value *result = NULL;
+  if (ok) {
+    /* The list may have changed under the key function; indices held
+     * are checked against it */
+    result = value_new(VALUE_LIST);
+    result->as.list = value_list_new(heap->count);
+    result->as.list->count = heap->count;
+    for (size_t slot = heap->count; slot-- > 0;) {
+      Value *index = value_heap_pop(heap);
+      size_t i = (size_t)index->as.number;
+      value_free(index);
+      Value *element = value_copy(i < list->count ? &list->elements[i] : NULL);
+      if (!element)
+        element = value_new(VALUE_NIL);
+      result->as.list->elements[slot] = *element;
+      free(element);
+      mem_counters.values--;
+    }
+  }
+  value_heap_release(heap);
+  return result;
+}
+
+/* Dispatch a call to the builtin registered under NAME. Returns NULL when the
+ * builtin reports an error or NAME is not a builtin. */
+Value *interpreter_call_builtin(Interpreter *interpreter, const char *name,
+                                Value **args, int arg_count) {
+  if (strcmp(name, "print") == 0) {
+    return builtin_print(interpreter, args, arg_count);
+  } else if (strcmp(name, "len") == 0) {
+    return builtin_len(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_now") == 0) {
+    return builtin_time_now(interpreter, args, arg_count);
+  } else if (strcmp(name, "clock_ns") == 0) {
+    return builtin_clock_ns(interpreter, args, arg_count);
+  } else if (strcmp(name, "perf_counter") == 0) {
+    return builtin_perf_counter(interpreter, args, arg_count);
+  } else if (strcmp(name, "bench") == 0) {
+    return builtin_bench(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_add") == 0) {
+    return builtin_time_add(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_diff") == 0) {
+    return builtin_time_diff(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_parse") == 0) {
+    return builtin_time_parse(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_format") == 0) {
+    return builtin_time_format(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_year") == 0) {
+    return builtin_time_year(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_month") == 0) {
+    return builtin_time_month(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_day") == 0) {
+    return builtin_time_day(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_hour") == 0) {
+    return builtin_time_hour(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_minute") == 0) {
+    return builtin_time_minute(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_second") == 0) {
+    return builtin_time_second(interpreter, args, arg_count);
+  } else if (strcmp(name, "time_weekday") == 0) {
+    return builtin_time_weekday(interpreter, args, arg_count);
+  } else if (strcmp(name, "sleep") == 0) {
+    return builtin_sleep(interpreter, args, arg_count);
+  } else if (strcmp(name, "assert") == 0) {
+    return builtin_assert(interpreter, args, arg_count);
+  } else if (strcmp(name, "fopen") == 0) {
+    return builtin_fopen(interpreter, args, arg_count);
+  } else if (strcmp(name, "fclose") == 0) {
+    return builtin_fclose(interpreter, args, arg_count);
+  } else if (strcmp(name, "fwrite") == 0) {
+    return builtin_fwrite(interpreter, args, arg_count);
+  } else if (strcmp(name, "fread") == 0) {
+    return builtin_fread(interpreter, args, arg_count);
+  } else if (strcmp(name, "freadline") == 0) {
+    return builtin_freadline(interpreter, args, arg_count);
+  } else if (strcmp(name, "fwriteline") == 0) {
+    return builtin_fwriteline(interpreter, args, arg_count);
+  } else if (strcmp(name, "fexists") == 0) {
+    return builtin_fexists(interpreter, args, arg_count);
+  } else if (strcmp(name, "bytes") == 0) {
+    return builtin_bytes(interpreter, args, arg_count);
+  } else if (strcmp(name, "bytes_append") == 0) {
+    return builtin_bytes_append(interpreter, args, arg_count);
+  } else if (strcmp(name, "pack") == 0) {
+    return builtin_pack(interpreter, args, arg_count);
+  } else if (strcmp(name, "unpack") == 0) {
+    return builtin_unpack(interpreter, args, arg_count);
+  } else if (strcmp(name, "fread_bytes") == 0) {
+    return builtin_fread_bytes(interpreter, args, arg_count);
+  } else if (strcmp(name, "fwrite_bytes") == 0) {
+    return builtin_fwrite_bytes(interpreter, args, arg_count);
+  } else if (strcmp(name, "mem_stats") == 0) {
+    return builtin_mem_stats(interpreter, args, arg_count);
+  } else if (strcmp(name, "sort") == 0) {
+    return builtin_sort(interpreter, args, arg_count);
+  } else if (strcmp(name, "sort_by") == 0) {
+    return builtin_sort_by(interpreter, args, arg_count);
+  } else if (strcmp(name, "range") == 0) {
+    return builtin_range(interpreter, args, arg_count);
+  } else if (strcmp(name, "set") == 0) {
+    return builtin_set(interpreter, args, arg_count);
+  } else if (strcmp(name, "add") == 0) {
+    return builtin_add(interpreter, args, arg_count);
+  } else if (strcmp(name, "has") == 0) {
+    return builtin_has(interpreter, args, arg_count);
+  } else if (strcmp(name, "remove") == 0) {
+    return builtin_remove(interpreter, args, arg_count);
+  } else if (strcmp(name, "union") == 0) {
+    return set_operation(args, arg_count, SET_UNION);
+  } else if (strcmp(name, "intersect") == 0) {
+    return set_operation(args, arg_count, SET_INTERSECT);
+  } else if (strcmp(name, "difference") == 0) {
+    return set_operation(args, arg_count, SET_DIFFERENCE);
+  } else if (strcmp(name, "deque") == 0) {
+    return builtin_deque(interpreter, args, arg_count);
+  } else if (strcmp(name, "push_back") == 0) {
+    return deque_push(args, arg_count, false);
+  } else if (strcmp(name, "push_front") == 0) {
+    return deque_push(args, arg_count, true);
+  } else if (strcmp(name, "pop_back") == 0) {
+    return deque_pop(args, arg_count, false);
+  } else if (strcmp(name, "pop_front") == 0) {
+    return deque_pop(args, arg_count, true);
+  } else if (strcmp(name, "heap") == 0) {
+    return builtin_heap(interpreter, args, arg_count);
+  } else if (strcmp(name, "heap_push") == 0) {
+    return builtin_heap_push(interpreter, args, arg_count);
+  } else if (strcmp(name, "heap_pop") == 0) {
+    return builtin_heap_pop(interpreter, args, arg_count);
+  } else if (strcmp(name, "heap_peek") == 0) {
+    return builtin_heap_peek(interpreter, args, arg_count);
+  } else if (strcmp(name, "top_k") == 0) {
+    return builtin_top_k(interpreter, args, arg_count);
+  }
+
+  return NULL; // Unknown builtin
+}
+
+/* Interpreter implementation */
+Interpreter *interpreter_new(void) {
+  Interpreter *interpreter = malloc(sizeof(Interpreter));
+  interpreter->globals = environment_new(NULL);
+  interpreter->environment = interpreter->globals;
+  interpreter->modules_path = NULL;
+  interpreter->modules_path_count = 0;
+  interpreter->return_value = NULL;
+  interpreter->current_filename = NULL;
+  interpreter->imported.statements = NULL;
+  interpreter->imported.count = 0;
+  interpreter->imported.capacity = 0;
+
+  const char *debug_trace = getenv("MS_DEBUG_TRACE");
+  interpreter->debug_trace = debug_trace && strcmp(debug_trace, "0") != 0;
+
+  interpreter->frames = NULL;
+  interpreter_set_max_depth(interpreter, MS_DEFAULT_MAX_DEPTH);
+  interpreter->stack_limit = 0;
+  interpreter->on_script_stack = false;
+  interpreter->instrument = false;
+  interpreter->trace = false;
+  interpreter->line_counts = NULL;
+#ifdef MS_USDT
+  /* Compiled calls fire no function probes, so a traced build interprets */
+  interpreter->jit = false;
+#else
+  const char *jit = getenv("MS_JIT");
+  interpreter->jit = jit_available() && !(jit && strcmp(jit, "0") == 0);
+#endif
+  interpreter->current_function = NULL;
+  interpreter->tail_position = false;
+  interpreter->tail_call.pending = false;
+  interpreter->builtin_error = NULL;
+
+  interpreter_define_builtins(interpreter);
+
+  return interpreter;
+}
+
+void interpreter_free(Interpreter *interpreter) {
+  if (interpreter) {
+    environment_free(interpreter->globals);
+    for (size_t i = 0; i < interpreter->modules_path_count; i++) {
+      free(interpreter->modules_path[i]);
+    }
+    free(interpreter->modules_path);
+    if (interpreter->return_value) {
+      value_free(interpreter->return_value);
+    }
+    if (interpreter->current_filename) {
+      free(interpreter->current_filename);
+    }
+    for (size_t i = 0; i < interpreter->imported.count; i++) {
+      stmt_free(interpreter->imported.statements[i]);
+    }
+    free(interpreter->imported.statements);
+    free((void *)interpreter->frames);
+    runtime_error_free(interpreter->builtin_error);
+    free(interpreter);
+  }
+}
+
+/* Returns the interpreter's long-lived copy of a script or module path,
+ * adding it to modules_path on first use. */
+static const char *intern_module_path(Interpreter *interpreter, const char *path) {
+  for (size_t i = 0; i < interpreter->modules_path_count; i++) {
+    if (strcmp(interpreter->modules_path[i], path) == 0)
+      return interpreter->modules_path[i];
+  }
+  interpreter->modules_path =
+      realloc(interpreter->modules_path,
+              (interpreter->modules_path_count + 1) * sizeof(char *));
+  interpreter->modules_path[interpreter->modules_path_count] = ms_strdup(path);
+  return interpreter->modules_path[interpreter->modules_path_count++];
+}
+
+void interpreter_set_filename(Interpreter *interpreter, const char *filename) {
+  if (interpreter->current_filename) {
+    free(interpreter->current_filename);
+  }
+  if (filename) {
+    interpreter->current_filename = ms_strdup(filename);
+    if (interpreter->frame_count == 1)
+      interpreter->frames[0].filename = intern_module_path(interpreter, filename);
+  } else {
+    interpreter->current_filename = NULL;
+  }
+}
+
+/* Sets the call depth limit, reallocating the (empty) call stack; only
+ * valid while no script is running */
+void interpreter_set_max_depth(Interpreter *interpreter, size_t max_depth) {
+  const char *filename =
+      interpreter->frames ? interpreter->frames[0].filename : "<unknown>";
+  free((void *)interpreter->frames);
+  interpreter->max_depth = max_depth;
+  interpreter->frames = calloc(max_depth + 1, sizeof(CallFrame));
+  interpreter->frames[0].function = "<main>";
+  interpreter->frames[0].filename = filename;
+  interpreter->frames[0].line = 0;
+  interpreter->frame_count = 1;
+}
+
+/* Reports a stack overflow if another frame would exceed the depth limit or
+ * the native stack is close to running out */
+static bool check_stack(Interpreter *interpreter, size_t line, RuntimeError **error) {
+  char here;
+  const char *reason = NULL;
+  char message[96];
+  if (interpreter->frame_count > interpreter->max_depth) {
+    snprintf(message, sizeof(message),
+             "Stack overflow (more than %zu nested calls).", interpreter->max_depth);
+    reason = message;
+  } else if ((uintptr_t)&here < interpreter->stack_limit) {
+    reason = "Stack overflow (native stack exhausted).";
+  }
+  if (!reason)
+    return true;
+  *error = runtime_error_new(reason, line,
+                             interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+  return false;
+}
+
+/* Call stack maintenance; callers check_stack first. The frame is filled in
+ * before the count is raised so that a profiler signal never sees a
+ * half-written entry. */
+static void push_frame(Interpreter *interpreter, const char *function,
+                       const char *filename, size_t line) {
+  size_t index = interpreter->frame_count;
+  interpreter->frames[index].function = function;
+  interpreter->frames[index].filename = filename;
+  interpreter->frames[index].line = line;
+  interpreter->frame_count = index + 1;
+}
+
+static void pop_frame(Interpreter *interpreter) {
+  interpreter->frame_count = interpreter->frame_count - 1;
+}
+
+void interpreter_define_builtins(Interpreter *interpreter) {
+  Value *print_builtin = value_new(VALUE_BUILTIN);
+  print_builtin->as.builtin_name = ms_strdup("print");
+  environment_define(interpreter->globals, "print", print_builtin);
+
+  Value *len_builtin = value_new(VALUE_BUILTIN);
+  len_builtin->as.builtin_name = ms_strdup("len");
+  environment_define(interpreter->globals, "len", len_builtin);
+
+  Value *time_now_builtin = value_new(VALUE_BUILTIN);
+  time_now_builtin->as.builtin_name = ms_strdup("time_now");
+  environment_define(interpreter->globals, "time_now", time_now_builtin);
+
+  Value *clock_ns_builtin = value_new(VALUE_BUILTIN);
+  clock_ns_builtin->as.builtin_name = ms_strdup("clock_ns");
+  environment_define(interpreter->globals, "clock_ns", clock_ns_builtin);
+
+  Value *perf_counter_builtin = value_new(VALUE_BUILTIN);
+  perf_counter_builtin->as.builtin_name = ms_strdup("perf_counter");
+  environment_define(interpreter->globals, "perf_counter", perf_counter_builtin);
+
+  Value *bench_builtin = value_new(VALUE_BUILTIN);
+  bench_builtin->as.builtin_name = ms_strdup("bench");
+  environment_define(interpreter->globals, "bench", bench_builtin);
+
+  Value *time_add_builtin = value_new(VALUE_BUILTIN);
+  time_add_builtin->as.builtin_name = ms_strdup("time_add");
+  environment_define(interpreter->globals, "time_add", time_add_builtin);
+
+  Value *time_diff_builtin = value_new(VALUE_BUILTIN);
+  time_diff_builtin->as.builtin_name = ms_strdup("time_diff");
+  environment_define(interpreter->globals, "time_diff", time_diff_builtin);
+
+  Value *time_parse_builtin = value_new(VALUE_BUILTIN);
+  time_parse_builtin->as.builtin_name = ms_strdup("time_parse");
+  environment_define(interpreter->globals, "time_parse", time_parse_builtin);
+
+  Value *time_format_builtin = value_new(VALUE_BUILTIN);
+  time_format_builtin->as.builtin_name = ms_strdup("time_format");
+  environment_define(interpreter->globals, "time_format", time_format_builtin);
+
+  Value *time_year_builtin = value_new(VALUE_BUILTIN);
+  time_year_builtin->as.builtin_name = ms_strdup("time_year");
+  environment_define(interpreter->globals, "time_year", time_year_builtin);
+
+  Value *time_month_builtin = value_new(VALUE_BUILTIN);
+  time_month_builtin->as.builtin_name = ms_strdup("time_month");
+  environment_define(interpreter->globals, "time_month", time_month_builtin);
+
+  Value *time_day_builtin = value_new(VALUE_BUILTIN);
+  time_day_builtin->as.builtin_name = ms_strdup("time_day");
+  environment_define(interpreter->globals, "time_day", time_day_builtin);
+
+  Value *time_hour_builtin = value_new(VALUE_BUILTIN);
+  time_hour_builtin->as.builtin_name = ms_strdup("time_hour");
+  environment_define(interpreter->globals, "time_hour", time_hour_builtin);
+
+  Value *time_minute_builtin = value_new(VALUE_BUILTIN);
+  time_minute_builtin->as.builtin_name = ms_strdup("time_minute");
+  environment_define(interpreter->globals, "time_minute", time_minute_builtin);
+
+  Value *time_second_builtin = value_new(VALUE_BUILTIN);
+  time_second_builtin->as.builtin_name = ms_strdup("time_second");
+  environment_define(interpreter->globals, "time_second", time_second_builtin);
+
+  Value *time_weekday_builtin = value_new(VALUE_BUILTIN);
+  time_weekday_builtin->as.builtin_name = ms_strdup("time_weekday");
+  environment_define(interpreter->globals, "time_weekday", time_weekday_builtin);
+
+  Value *sleep_builtin = value_new(VALUE_BUILTIN);
+  sleep_builtin->as.builtin_name = ms_strdup("sleep");
+  environment_define(interpreter->globals, "sleep", sleep_builtin);
+
+  Value *assert_builtin = value_new(VALUE_BUILTIN);
+  assert_builtin->as.builtin_name = ms_strdup("assert");
+  environment_define(interpreter->globals, "assert", assert_builtin);
+
+  // File I/O functions
+  Value *fopen_builtin = value_new(VALUE_BUILTIN);
+  fopen_builtin->as.builtin_name = ms_strdup("fopen");
+  environment_define(interpreter->globals, "fopen", fopen_builtin);
+
+  Value *fclose_builtin = value_new(VALUE_BUILTIN);
+  fclose_builtin->as.builtin_name = ms_strdup("fclose");
+  environment_define(interpreter->globals, "fclose", fclose_builtin);
+
+  Value *fwrite_builtin = value_new(VALUE_BUILTIN);
+  fwrite_builtin->as.builtin_name = ms_strdup("fwrite");
+  environment_define(interpreter->globals, "fwrite", fwrite_builtin);
+
+  Value *fread_builtin = value_new(VALUE_BUILTIN);
+  fread_builtin->as.builtin_name = ms_strdup("fread");
+  environment_define(interpreter->globals, "fread", fread_builtin);
+
+  Value *freadline_builtin = value_new(VALUE_BUILTIN);
+  freadline_builtin->as.builtin_name = ms_strdup("freadline");
+  environment_define(interpreter->globals, "freadline", freadline_builtin);
+
+  Value *fwriteline_builtin = value_new(VALUE_BUILTIN);
+  fwriteline_builtin->as.builtin_name = ms_strdup("fwriteline");
+  environment_define(interpreter->globals, "fwriteline", fwriteline_builtin);
+
+  Value *fexists_builtin = value_new(VALUE_BUILTIN);
+  fexists_builtin->as.builtin_name = ms_strdup("fexists");
+  environment_define(interpreter->globals, "fexists", fexists_builtin);
+
+  // Binary data functions
+  Value *bytes_builtin = value_new(VALUE_BUILTIN);
+  bytes_builtin->as.builtin_name = ms_strdup("bytes");
+  environment_define(interpreter->globals, "bytes", bytes_builtin);
+
+  Value *bytes_append_builtin = value_new(VALUE_BUILTIN);
+  bytes_append_builtin->as.builtin_name = ms_strdup("bytes_append");
+  environment_define(interpreter->globals, "bytes_append", bytes_append_builtin);
+
+  Value *pack_builtin = value_new(VALUE_BUILTIN);
+  pack_builtin->as.builtin_name = ms_strdup("pack");
+  environment_define(interpreter->globals, "pack", pack_builtin);
+
+  Value *unpack_builtin = value_new(VALUE_BUILTIN);
+  unpack_builtin->as.builtin_name = ms_strdup("unpack");
+  environment_define(interpreter->globals, "unpack", unpack_builtin);
+
+  Value *fread_bytes_builtin = value_new(VALUE_BUILTIN);
+  fread_bytes_builtin->as.builtin_name = ms_strdup("fread_bytes");
+  environment_define(interpreter->globals, "fread_bytes", fread_bytes_builtin);
+
+  Value *fwrite_bytes_builtin = value_new(VALUE_BUILTIN);
+  fwrite_bytes_builtin->as.builtin_name = ms_strdup("fwrite_bytes");
+  environment_define(interpreter->globals, "fwrite_bytes", fwrite_bytes_builtin);
+
+  Value *mem_stats_builtin = value_new(VALUE_BUILTIN);
+  mem_stats_builtin->as.builtin_name = ms_strdup("mem_stats");
+  environment_define(interpreter->globals, "mem_stats", mem_stats_builtin);
+
+  Value *sort_builtin = value_new(VALUE_BUILTIN);
+  sort_builtin->as.builtin_name = ms_strdup("sort");
+  environment_define(interpreter->globals, "sort", sort_builtin);
+
+  Value *sort_by_builtin = value_new(VALUE_BUILTIN);
+  sort_by_builtin->as.builtin_name = ms_strdup("sort_by");
+  environment_define(interpreter->globals, "sort_by", sort_by_builtin);
+
+  Value *range_builtin = value_new(VALUE_BUILTIN);
+  range_builtin->as.builtin_name = ms_strdup("range");
+  environment_define(interpreter->globals, "range", range_builtin);
+
+  Value *set_builtin = value_new(VALUE_BUILTIN);
+  set_builtin->as.builtin_name = ms_strdup("set");
+  environment_define(interpreter->globals, "set", set_builtin);
+
+  Value *add_builtin = value_new(VALUE_BUILTIN);
+  add_builtin->as.builtin_name = ms_strdup("add");
+  environment_define(interpreter->globals, "add", add_builtin);
+
+  Value *has_builtin = value_new(VALUE_BUILTIN);
+  has_builtin->as.builtin_name = ms_strdup("has");
+  environment_define(interpreter->globals, "has", has_builtin);
+
+  Value *remove_builtin = value_new(VALUE_BUILTIN);
+  remove_builtin->as.builtin_name = ms_strdup("remove");
+  environment_define(interpreter->globals, "remove", remove_builtin);
+
+  Value *union_builtin = value_new(VALUE_BUILTIN);
+  union_builtin->as.builtin_name = ms_strdup("union");
+  environment_define(interpreter->globals, "union", union_builtin);
+
+  Value *intersect_builtin = value_new(VALUE_BUILTIN);
+  intersect_builtin->as.builtin_name = ms_strdup("intersect");
+  environment_define(interpreter->globals, "intersect", intersect_builtin);
+
+  Value *difference_builtin = value_new(VALUE_BUILTIN);
+  difference_builtin->as.builtin_name = ms_strdup("difference");
+  environment_define(interpreter->globals, "difference", difference_builtin);
+
+  Value *deque_builtin = value_new(VALUE_BUILTIN);
+  deque_builtin->as.builtin_name = ms_strdup("deque");
+  environment_define(interpreter->globals, "deque", deque_builtin);
+
+  Value *push_back_builtin = value_new(VALUE_BUILTIN);
+  push_back_builtin->as.builtin_name = ms_strdup("push_back");
+  environment_define(interpreter->globals, "push_back", push_back_builtin);
+
+  Value *push_front_builtin = value_new(VALUE_BUILTIN);
+  push_front_builtin->as.builtin_name = ms_strdup("push_front");
+  environment_define(interpreter->globals, "push_front", push_front_builtin);
+
+  Value *pop_back_builtin = value_new(VALUE_BUILTIN);
+  pop_back_builtin->as.builtin_name = ms_strdup("pop_back");
+  environment_define(interpreter->globals, "pop_back", pop_back_builtin);
+
+  Value *pop_front_builtin = value_new(VALUE_BUILTIN);
+  pop_front_builtin->as.builtin_name = ms_strdup("pop_front");
+  environment_define(interpreter->globals, "pop_front", pop_front_builtin);
+
+  Value *heap_builtin = value_new(VALUE_BUILTIN);
+  heap_builtin->as.builtin_name = ms_strdup("heap");
+  environment_define(interpreter->globals, "heap", heap_builtin);
+
+  Value *heap_push_builtin = value_new(VALUE_BUILTIN);
+  heap_push_builtin->as.builtin_name = ms_strdup("heap_push");
+  environment_define(interpreter->globals, "heap_push", heap_push_builtin);
+
+  Value *heap_pop_builtin = value_new(VALUE_BUILTIN);
+  heap_pop_builtin->as.builtin_name = ms_strdup("heap_pop");
+  environment_define(interpreter->globals, "heap_pop", heap_pop_builtin);
+
+  Value *heap_peek_builtin = value_new(VALUE_BUILTIN);
+  heap_peek_builtin->as.builtin_name = ms_strdup("heap_peek");
+  environment_define(interpreter->globals, "heap_peek", heap_peek_builtin);
+
+  Value *top_k_builtin = value_new(VALUE_BUILTIN);
+  top_k_builtin->as.builtin_name = ms_strdup("top_k");
+  environment_define(interpreter->globals, "top_k", top_k_builtin);
+}
+
+/* Binds DECLARATION's parameters in the interpreter's environment; OWNED
+ * arguments are moved in rather than copied */
+static void bind_parameters(Interpreter *interpreter, Stmt *declaration,
+                            Value **arguments, bool owned) {
+  for (size_t i = 0; i < declaration->as.function.param_count; i++) {
+    environment_define(interpreter->environment,
+                       declaration->as.function.params[i].lexeme,
+                       owned ? arguments[i] : value_copy(arguments[i]));
+  }
+}
+
+static void free_arguments(Value **arguments, size_t arg_count) {
+  for (size_t i = 0; i < arg_count; i++)
+    value_free(arguments[i]);
+  free(arguments);
+}
+
+/* Call a MiniScript function value with ARG_COUNT evaluated arguments, which
+ * stay owned by the caller. LINE is the call site, for arity errors. Returns
+ * the function's result (nil if it does not return one).
+ * Calls the body makes in tail position run one after another in this
+ * frame rather than nesting. */
+Value *interpreter_call_function(Interpreter *interpreter, Value *function,
+                                 Value **arguments, size_t arg_count,
+                                 size_t line, RuntimeError **error) {
+  Stmt *declaration = function->as.function->declaration;
+  if (arg_count != declaration->as.function.param_count) {
+    *error = runtime_error_new("Wrong number of arguments.", line,
+                               interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+    return NULL;
+  }
+
+  Value *result = NULL;
+  if (!check_stack(interpreter, line, error))
+    return NULL;
+  if (interpreter->jit && jit_call(function, arguments, arg_count, &result))
+    return result;
+
+  uint64_t started = interpreter->trace ? monotonic_ns() : 0;
+  push_frame(interpreter, declaration->as.function.name.lexeme,
+             declaration->as.function.filename, declaration->line);
+  if (interpreter->instrument)
+    instrument_enter_function(declaration);
+  PROBE_FUNCTION_ENTRY(declaration->as.function.name.lexeme,
+                       declaration->as.function.filename, declaration->line);
+
+  // Create new environment for function scope
+  Environment *previous = interpreter->environment;
+  interpreter->environment = environment_new(function->as.function->closure);
+  LineCounts *previous_lines = interpreter->line_counts;
+  if (previous_lines)
+    interpreter->line_counts = line_counts_file(declaration->as.function.filename);
+  Stmt *previous_function = interpreter->current_function;
+  interpreter->current_function = declaration;
+
+  // Bind parameters to arguments
+  bind_parameters(interpreter, declaration, arguments, false);
+
+  bool in_frame = true; /* false between a tail call's frames */
+  for (;;) {
+    // Execute function body
+    if (declaration->as.function.native) {
+      result = declaration->as.function.native(interpreter, error);
+      if (interpreter->tail_call.pending) {
+        value_free(result); /* the tail call below produces it */
+        result = NULL;
+      }
+    }
+    for (size_t i = 0; i < declaration->as.function.body.count && !*error; i++) {
+      interpreter_execute(interpreter, declaration->as.function.body.statements[i], error);
+
+      // Check if this was a return statement
+      if (*error && strcmp((*error)->message, "return") == 0) {
+        // This is a return, extract the return value
+        if (interpreter->tail_call.pending) {
+          result = NULL; /* the tail call below produces it */
+        } else if ((*error)->return_value) {
+          result = value_copy((*error)->return_value);
+        } else {
+          result = value_new(VALUE_NIL);
+        }
+        runtime_error_free(*error);
+        *error = NULL;
+        break;
+      }
+    }
+    if (!interpreter->tail_call.pending)
+      break;
+
+    /* `return f(...)`: finish this call's bookkeeping, then run F in the
+     * same C frame, reusing the environment unless something else holds
+     * it. TAIL holds a reference on F's closure until F's scope does. */
+    TailCall tail = interpreter->tail_call;
+    interpreter->tail_call.pending = false;
+    in_frame = false;
+    PROBE_FUNCTION_RETURN(declaration->as.function.name.lexeme,
+                          declaration->as.function.filename, declaration->line);
+    if (interpreter->instrument)
+      instrument_exit();
+    pop_frame(interpreter);
+    if (interpreter->trace)
+      trace_call(declaration, started);
+
+    declaration = tail.function.declaration;
+    if (tail.arg_count != declaration->as.function.param_count) {
+      free_arguments(tail.arguments, tail.arg_count);
+      environment_release(tail.function.closure);
+      *error = runtime_error_new("Wrong number of arguments.", tail.line,
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      break;
+    }
+    Value callee = {VALUE_FUNCTION, {.function = &tail.function}};
+    if (interpreter->jit &&
+        jit_call(&callee, tail.arguments, tail.arg_count, &result)) {
+      free_arguments(tail.arguments, tail.arg_count);
+      environment_release(tail.function.closure);
+      break;
+    }
+
+    started = interpreter->trace ? monotonic_ns() : 0;
+    push_frame(interpreter, declaration->as.function.name.lexeme,
+               declaration->as.function.filename, declaration->line);
+    if (interpreter->instrument)
+      instrument_enter_function(declaration);
+    PROBE_FUNCTION_ENTRY(declaration->as.function.name.lexeme,
+                         declaration->as.function.filename, declaration->line);
+    in_frame = true;
+    if (previous_lines)
+      interpreter->line_counts = line_counts_file(declaration->as.function.filename);
+    interpreter->current_function = declaration;
+
+    if (interpreter->environment->refcount > 1) {
+      environment_release(interpreter->environment);
+      interpreter->environment = environment_new(tail.function.closure);
+    } else {
+      environment_reset(interpreter->environment, tail.function.closure);
+    }
+    environment_release(tail.function.closure);
+    bind_parameters(interpreter, declaration, tail.arguments, true);
+    free(tail.arguments);
+  }
+
+  // Restore previous environment; it is freed unless a closure holds it
+  environment_release(interpreter->environment);
+  interpreter->environment = previous;
+  interpreter->line_counts = previous_lines;
+  interpreter->current_function = previous_function;
+  if (in_frame) {
+    PROBE_FUNCTION_RETURN(declaration->as.function.name.lexeme,
+                          declaration->as.function.filename, declaration->line);
+    if (interpreter->instrument)
+      instrument_exit();
+    pop_frame(interpreter);
+    if (interpreter->trace)
+      trace_call(declaration, started);
+  }
+
+  // If no return statement was executed, return nil
+  if (!result && !*error) {
+    result = value_new(VALUE_NIL);
+  }
+  return result;
+}
+
+/* Applies the binary operator OP (at LINE) to LEFT and RIGHT, which it
+ * frees */
+Value *interpreter_binary(Interpreter *interpreter, MSTokenType op, size_t line,
+                          Value *left, Value *right, RuntimeError **error) {
+  Value *result = value_new(VALUE_NIL);
+
+  switch (op) {
+  case PLUS:
+    if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
+      result->type = VALUE_NUMBER;
+      result->as.number = left->as.number + right->as.number;
+    } else if (left->type == VALUE_STRING || right->type == VALUE_STRING) {
+      /* Coerce both sides to string */
+      char *lstr = left->type == VALUE_STRING ? ms_strdup(left->as.string)
+                                              : stringify_value(left);
+      char *rstr = right->type == VALUE_STRING ? ms_strdup(right->as.string)
+                                               : stringify_value(right);
+      size_t len = strlen(lstr) + strlen(rstr) + 1;
+      result->type = VALUE_STRING;
+      result->as.string = malloc(len);
+      strcpy(result->as.string, lstr);
+      strcat(result->as.string, rstr);
+      free(lstr);
+      free(rstr);
+    } else {
+      value_free(result);
+      value_free(left);
+      value_free(right);
+      *error =
+          runtime_error_new("Operands must be two numbers or two strings.",
+                            line, 
+                            interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    break;
+  case MINUS:
+    if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
+      result->type = VALUE_NUMBER;
+      result->as.number = left->as.number - right->as.number;
+    } else {
+      value_free(result);
+      value_free(left);
+      value_free(right);
+      *error = runtime_error_new("Operands must be numbers.",
+                                 line, 
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    break;
+  case MULTIPLY:
+    if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
+      result->type = VALUE_NUMBER;
+      result->as.number = left->as.number * right->as.number;
+    } else {
+      value_free(result);
+      value_free(left);
+      value_free(right);
+      *error = runtime_error_new("Operands must be numbers.",
+                                 line, 
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    break;
+  case DIVIDE:
+    if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
+      result->type = VALUE_NUMBER;
+      result->as.number = left->as.number / right->as.number;
+    } else {
+      value_free(result);
+      value_free(left);
+      value_free(right);
+      *error = runtime_error_new("Operands must be numbers.",
+                                 line, 
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    break;
+  case GREATER:
+    if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
+      result->type = VALUE_BOOLEAN;
+      result->as.boolean = left->as.number > right->as.number;
+    } else {
+      value_free(result);
+      value_free(left);
+      value_free(right);
+      *error = runtime_error_new("Operands must be numbers.",
+                                 line, 
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    break;
+  case GREATER_EQUAL:
+    if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
+      result->type = VALUE_BOOLEAN;
+      result->as.boolean = left->as.number >= right->as.number;
+    } else {
+      value_free(result);
+      value_free(left);
+      value_free(right);
+      *error = runtime_error_new("Operands must be numbers.",
+                                 line, 
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    break;
+  case LESS:
+    if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
+      result->type = VALUE_BOOLEAN;
+      result->as.boolean = left->as.number < right->as.number;
+    } else {
+      value_free(result);
+      value_free(left);
+      value_free(right);
+      *error = runtime_error_new("Operands must be numbers.",
+                                 line, 
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    break;
+  case LESS_EQUAL:
+    if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
+      result->type = VALUE_BOOLEAN;
+      result->as.boolean = left->as.number <= right->as.number;
+    } else {
+      value_free(result);
+      value_free(left);
+      value_free(right);
+      *error = runtime_error_new("Operands must be numbers.",
+                                 line, 
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    break;
+  case EQUAL:
+    result->type = VALUE_BOOLEAN;
+    result->as.boolean = values_equal(left, right);
+    break;
+  case NOT_EQUAL:
+    result->type = VALUE_BOOLEAN;
+    result->as.boolean = !values_equal(left, right);
+    break;
+  default:
+    value_free(result);
+    value_free(left);
+    value_free(right);
+    *error = runtime_error_new("Unknown binary operator.",
+                               line, 
+                               interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+    return NULL;
+  }
+
+  value_free(left);
+  value_free(right);
+  return result;
+}
+
+static bool is_number_operator(MSTokenType op) {
+  return op == PLUS || op == MINUS || op == MULTIPLY || op == DIVIDE;
+}
+
+static bool is_comparison_operator(MSTokenType op) {
+  return op == GREATER || op == GREATER_EQUAL || op == LESS ||
+         op == LESS_EQUAL || op == EQUAL || op == NOT_EQUAL;
+}
+
+static bool quick_binary_number(Interpreter *interpreter, Expr *expr,
+                                double *number, Value **boxed,
+                                RuntimeError **error);
+
+/* Evaluates EXPR for a number-only operation. Literals, variables and
+ * quickened arithmetic yield their number without allocating a Value.
+ * Returns true with the number in *NUMBER; otherwise *ERROR is set or
+ * *BOXED holds the (non-number) value. */
+static bool evaluate_number(Interpreter *interpreter, Expr *expr, double *number,
+                            Value **boxed, RuntimeError **error) {
+  switch (expr->type) {
+  case EXPR_LITERAL:
+    if (expr->as.literal.value.type == LITERAL_NUMBER) {
+      STATS_EXPR(expr->type);
+      *number = expr->as.literal.value.value.number;
+      return true;
+    }
+    if (expr->as.literal.value.type == LITERAL_INTEGER) {
+      STATS_EXPR(expr->type);
+      *number = (double)expr->as.literal.value.value.integer;
+      return true;
+    }
+    break;
+  case EXPR_GROUPING:
+    STATS_EXPR(expr->type);
+    return evaluate_number(interpreter, expr->as.grouping.expression, number,
+                           boxed, error);
+  case EXPR_VARIABLE: {
+    Value **slot = environment_lookup(interpreter->environment,
+                                      expr->as.variable.name.lexeme,
+                                      &expr->as.variable.cache);
+    if (slot && (*slot)->type == VALUE_NUMBER) {
+      STATS_EXPR(expr->type);
+      *number = (*slot)->as.number;
+      return true;
+    }
+    break;
+  }
+  case EXPR_BINARY:
+    if (expr->as.binary.quick == QUICK_NUMBER &&
+        is_number_operator(expr->as.binary.op.type)) {
+      STATS_EXPR(expr->type);
+      return quick_binary_number(interpreter, expr, number, boxed, error);
+    }
+    break;
+  default:
+    break;
+  }
+
+  Value *value = interpreter_evaluate(interpreter, expr, error);
+  if (*error)
+    return false;
+  if (value->type == VALUE_NUMBER) {
+    *number = value->as.number;
+    value_free(value);
+    return true;
+  }
+  *boxed = value;
+  return false;
+}
+
+/* Fast path of a site quickened to QUICK_NUMBER. Returns true with the
+ * result in *NUMBER (0 or 1 for comparisons). If an operand turns out not
+ * to be a number the site deoptimizes to QUICK_GENERIC and returns false
+ * with the generic result in *BOXED, or *ERROR set. */
+static bool quick_binary_number(Interpreter *interpreter, Expr *expr,
+                                double *number, Value **boxed,
+                                RuntimeError **error) {
+  double left, right;
+  Value *left_boxed = NULL, *right_boxed = NULL;
+  if (!evaluate_number(interpreter, expr->as.binary.left, &left, &left_boxed, error)) {
+    if (*error)
+      return false;
+    expr->as.binary.quick = QUICK_GENERIC;
+    right_boxed = interpreter_evaluate(interpreter, expr->as.binary.right, error);
+    if (*error) {
+      value_free(left_boxed);
+      return false;
+    }
+    *boxed = interpreter_binary(interpreter, expr->as.binary.op.type,
+                                expr->as.binary.op.line, left_boxed,
+                                right_boxed, error);
+    return false;
+  }
+  if (!evaluate_number(interpreter, expr->as.binary.right, &right, &right_boxed, error)) {
+    if (*error)
+      return false;
+    expr->as.binary.quick = QUICK_GENERIC;
+    left_boxed = value_new(VALUE_NUMBER);
+    left_boxed->as.number = left;
+    *boxed = interpreter_binary(interpreter, expr->as.binary.op.type,
+                                expr->as.binary.op.line, left_boxed,
+                                right_boxed, error);
+    return false;
+  }
+
+  switch (expr->as.binary.op.type) {
+  case PLUS:
+    *number = left + right;
+    break;
+  case MINUS:
+    *number = left - right;
+    break;
+  case MULTIPLY:
+    *number = left * right;
+    break;
+  case DIVIDE:
+    *number = left / right;
+    break;
+  case GREATER:
+    *number = left > right;
+    break;
+  case GREATER_EQUAL:
+    *number = left >= right;
+    break;
+  case LESS:
+    *number = left < right;
+    break;
+  case LESS_EQUAL:
+    *number = left <= right;
+    break;
+  case EQUAL:
+    *number = left == right;
+    break;
+  case NOT_EQUAL:
+    *number = left != right;
+    break;
+  default:
+    *number = 0;
+    break;
+  }
+  return true;
+}
+
+static Value *evaluate_quick_binary(Interpreter *interpreter, Expr *expr,
+                                    RuntimeError **error) {
+  double number;
+  Value *boxed = NULL;
+  if (!quick_binary_number(interpreter, expr, &number, &boxed, error))
+    return boxed; /* NULL on error */
+  if (is_comparison_operator(expr->as.binary.op.type)) {
+    Value *result = value_new(VALUE_BOOLEAN);
+    result->as.boolean = number != 0;
+    return result;
+  }
+  Value *result = value_new(VALUE_NUMBER);
+  result->as.number = number;
+  return result;
+}
+
+/* Calls CALLEE (a builtin or MiniScript function, not freed) with ARG_COUNT
+ * ARGUMENTS, which it frees. LINE is the call site. A function called in
+ * TAIL position is handed back to the returning function's frame instead,
+ * with nil returned for now; see interpreter_call_function. */
+Value *interpreter_call_value(Interpreter *interpreter, Value *callee,
+                              Value **arguments, size_t arg_count, size_t line,
+                              bool tail, RuntimeError **error) {
+  Value *result = NULL;
+
+  if (callee->type == VALUE_BUILTIN) {
+    STATS_BUILTIN(callee->as.builtin_name);
+    if (interpreter->instrument)
+      instrument_enter_builtin(callee->as.builtin_name);
+    uint64_t started = interpreter->trace ? monotonic_ns() : 0;
+    PROBE_BUILTIN_ENTRY(callee->as.builtin_name, interpreter->current_filename, line);
+    result = interpreter_call_builtin(interpreter, callee->as.builtin_name,
+                                      arguments, arg_count);
+    PROBE_BUILTIN_RETURN(callee->as.builtin_name, interpreter->current_filename, line);
+    if (interpreter->trace)
+      trace_builtin(callee->as.builtin_name, arguments, arg_count, started,
+                    interpreter->current_filename, line);
+    if (interpreter->instrument)
+      instrument_exit();
+    if (!result && interpreter->builtin_error) {
+      /* A function the builtin called failed; report that error */
+      *error = interpreter->builtin_error;
+      interpreter->builtin_error = NULL;
+    } else if (!result) {
+      *error = runtime_error_new("Error calling builtin function.", line,
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+    }
+  } else if (callee->type == VALUE_FUNCTION && tail) {
+    /* The returning function's frame makes the call; see
+     * interpreter_call_function */
+    interpreter->tail_call.pending = true;
+    interpreter->tail_call.function = *callee->as.function;
+    interpreter->tail_call.function.owns_closure = true;
+    environment_retain(callee->as.function->closure);
+    interpreter->tail_call.arguments = arguments;
+    interpreter->tail_call.arg_count = arg_count;
+    interpreter->tail_call.line = line;
+    return value_new(VALUE_NIL);
+  } else if (callee->type == VALUE_FUNCTION) {
+    result = interpreter_call_function(interpreter, callee, arguments, arg_count,
+                                       line, error);
+  } else {
+    *error = runtime_error_new("Can only call functions and classes.", line,
+                               interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+  }
 
-  Value *assert_builtin = value_new(VALUE_BUILTIN);
-  assert_builtin->as.builtin_name = ms_strdup("assert");
-  environment_define(interpreter->globals, "assert", assert_builtin);
+  free_arguments(arguments, arg_count);
+  return result;
+}
 
-  // File I/O functions
-  Value *fopen_builtin = value_new(VALUE_BUILTIN);
-  fopen_builtin->as.builtin_name = ms_strdup("fopen");
-  environment_define(interpreter->globals, "fopen", fopen_builtin);
+/* Indexes OBJECT (a list or bytes) with INDEX, freeing both */
+Value *interpreter_get_index(Interpreter *interpreter, Value *object,
+                             Value *index, RuntimeError **error) {
+  if (object->type == VALUE_BYTES && index->type == VALUE_NUMBER) {
+    long idx = (long)index->as.number;
+    value_free(index);
+    if (idx < 0 || (size_t)idx >= object->as.bytes->length) {
+      value_free(object);
+      *error = runtime_error_new("Bytes index out of range.", 0,
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    Value *byte = value_new(VALUE_NUMBER);
+    byte->as.number = object->as.bytes->data[idx];
+    value_free(object);
+    return byte;
+  }
+  if (object->type == VALUE_RANGE && index->type == VALUE_NUMBER) {
+    long idx = (long)index->as.number;
+    value_free(index);
+    if (idx < 0 || (size_t)idx >= range_length(object->as.range)) {
+      value_free(object);
+      *error = runtime_error_new("Range index out of range.", 0,
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    Value *number = value_new(VALUE_NUMBER);
+    number->as.number = range_at(object->as.range, idx);
+    value_free(object);
+    return number;
+  }
+  bool deque = object->type == VALUE_DEQUE;
+  if ((object->type != VALUE_LIST && !deque) || index->type != VALUE_NUMBER) {
+    value_free(object);
+    value_free(index);
+    *error =
+        runtime_error_new("Invalid index operation.", 0, 
+                           interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+    return NULL;
+  }
+  long idx = (long)index->as.number;
+  value_free(index);
+  if (idx < 0 || (size_t)idx >= (deque ? object->as.deque->count : object->as.list->count)) {
+    value_free(object);
+    *error =
+        runtime_error_new(deque ? "Deque index out of range." : "List index out of range.", 0, 
+                           interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+    return NULL;
+  }
+  /* Return copy of element */
+  Value *copy = value_copy(deque ? value_deque_at(object->as.deque, idx)
+                                 : &object->as.list->elements[idx]);
+  value_free(object);
+  return copy;
+}
 
-  Value *fclose_builtin = value_new(VALUE_BUILTIN);
-  fclose_builtin->as.builtin_name = ms_strdup("fclose");
-  environment_define(interpreter->globals, "fclose", fclose_builtin);
+/* Stores VALUE at INDEX of OBJECT, freeing all three; returns the value
+ * stored */
+Value *interpreter_set_index(Interpreter *interpreter, Value *object,
+                             Value *index, Value *value, RuntimeError **error) {
+  if (object->type == VALUE_BYTES && index->type == VALUE_NUMBER) {
+    /* Byte buffers are shared, so the write is visible through the variable */
+    long idx = (long)index->as.number;
+    value_free(index);
+    if (idx < 0 || (size_t)idx >= object->as.bytes->length ||
+        value->type != VALUE_NUMBER || value->as.number < 0 ||
+        value->as.number > 255) {
+      value_free(object);
+      value_free(value);
+      *error = runtime_error_new("Invalid bytes set operation.", 0,
+                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      return NULL;
+    }
+    object->as.bytes->data[idx] = (unsigned char)value->as.number;
+    value_free(object);
+    return value;
+  }
+  bool deque = object->type == VALUE_DEQUE;
+  if ((object->type != VALUE_LIST && !deque) || index->type != VALUE_NUMBER) {
+    value_free(object);
+    value_free(index);
+    value_free(value);
+    *error = runtime_error_new("Invalid set operation.", 0, 
+                                interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+    return NULL;
+  }
+  long idx = (long)index->as.number;
+  value_free(index);
+  if (idx < 0 || (size_t)idx >= (deque ? object->as.deque->count : object->as.list->count)) {
+    value_free(object);
+    value_free(value);
+    *error =
+        runtime_error_new(deque ? "Deque index out of range." : "List index out of range.", 0, 
+                           interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+    return NULL;
+  }
+  /* Replace the element in the shared storage, so the write is visible
+   * through the variable */
+  Value *element = deque ? value_deque_at(object->as.deque, idx)
+                         : &object->as.list->elements[idx];
+  Value *ret = value_copy(value);
+  value_dispose_inline(element);
+  *element = *value;
+  free(value); /* contents now live inline in the list or deque */
+  mem_counters.values--;
+  value_free(object);
+  return ret;
+}
 
-  Value *fwrite_builtin = value_new(VALUE_BUILTIN);
-  fwrite_builtin->as.builtin_name = ms_strdup("fwrite");
-  environment_define(interpreter->globals, "fwrite", fwrite_builtin);
+bool interpreter_for_in_begin(Interpreter *interpreter, ForIn *loop,
+                              Value *iterable, size_t line,
+                              RuntimeError **error) {
+  loop->iterable = iterable;
+  loop->index = 0;
+  switch (iterable->type) {
+  case VALUE_LIST:
+  case VALUE_BYTES:
+  case VALUE_SET:
+  case VALUE_DEQUE:
+    loop->length = 0;
+    return true;
+  case VALUE_STRING:
+    loop->length = strlen(iterable->as.string);
+    return true;
+  case VALUE_RANGE:
+    loop->length = range_length(iterable->as.range);
+    return true;
+  default:
+    value_free(iterable);
+    loop->iterable = NULL;
+    *error = runtime_error_new("Can only iterate over lists, sets, deques, strings, bytes and ranges.", line,
+                               interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+    return false;
+  }
+}
 
-  Value *fread_builtin = value_new(VALUE_BUILTIN);
-  fread_builtin->as.builtin_name = ms_strdup("fread");
-  environment_define(interpreter->globals, "fread", fread_builtin);
+/* Stores VALUE in the loop variable: SLOT if it exists, else a new
+ * variable in the current scope */
+static void bind_loop_variable(Interpreter *interpreter, Value **slot,
+                               const char *name, Value *value) {
+  if (slot) {
+    value_free(*slot);
+    *slot = value;
+    environment_adopt(slot, value);
+  } else {
+    environment_define(interpreter->environment, name, value);
+  }
+}
 
-  Value *freadline_builtin = value_new(VALUE_BUILTIN);
-  freadline_builtin->as.builtin_name = ms_strdup("freadline");
-  environment_define(interpreter->globals, "freadline", freadline_builtin);
+static void bind_loop_number(Interpreter *interpreter, Value **slot,
+                             const char *name, double number) {
+  if (slot && (*slot)->type == VALUE_NUMBER) {
+    (*slot)->as.number = number; /* no allocation per iteration */
+    return;
+  }
+  Value *value = value_new(VALUE_NUMBER);
+  value->as.number = number;
+  bind_loop_variable(interpreter, slot, name, value);
+}
 
-  Value *fwriteline_builtin = value_new(VALUE_BUILTIN);
-  fwriteline_builtin->as.builtin_name = ms_strdup("fwriteline");
-  environment_define(interpreter->globals, "fwriteline", fwriteline_builtin);
+bool interpreter_for_in_next(Interpreter *interpreter, ForIn *loop,
+                             const char *name, LookupCache *cache) {
+  Value *iterable = loop->iterable;
+  Value **slot;
+  switch (iterable->type) {
+  case VALUE_LIST: {
+    /* The element is read from the list's shared storage, not a copy */
+    ValueList *list = iterable->as.list;
+    if (loop->index >= list->count)
+      return false;
+    Value *element = &list->elements[loop->index++];
+    slot = environment_lookup(interpreter->environment, name, cache);
+    if (element->type == VALUE_NUMBER)
+      bind_loop_number(interpreter, slot, name, element->as.number);
+    else
+      bind_loop_variable(interpreter, slot, name, value_copy(element));
+    return true;
+  }
+  case VALUE_SET:
+  case VALUE_DEQUE: {
+    /* Read from the shared storage, like list elements */
+    Value *element;
+    if (iterable->type == VALUE_SET) {
+      if (loop->index >= iterable->as.set->count)
+        return false;
+      element = &iterable->as.set->elements[loop->index++];
+    } else {
+      if (loop->index >= iterable->as.deque->count)
+        return false;
+      element = value_deque_at(iterable->as.deque, loop->index++);
+    }
+    slot = environment_lookup(interpreter->environment, name, cache);
+    if (element->type == VALUE_NUMBER)
+      bind_loop_number(interpreter, slot, name, element->as.number);
+    else
+      bind_loop_variable(interpreter, slot, name, value_copy(element));
+    return true;
+  }
+  case VALUE_STRING: {
+    if (loop->index >= loop->length)
+      return false;
+    char character = iterable->as.string[loop->index++];
+    slot = environment_lookup(interpreter->environment, name, cache);
+    if (slot && (*slot)->type == VALUE_STRING && (*slot)->as.string[0] != '\0') {
+      /* Reuse the previous character's string, which has room for one */
+      (*slot)->as.string[0] = character;
+      (*slot)->as.string[1] = '\0';
+      return true;
+    }
+    Value *value = value_new(VALUE_STRING);
+    value->as.string = malloc(2);
+    value->as.string[0] = character;
+    value->as.string[1] = '\0';
+    bind_loop_variable(interpreter, slot, name, value);
+    return true;
+  }
+  case VALUE_BYTES:
+    if (loop->index >= iterable->as.bytes->length)
+      return false;
+    slot = environment_lookup(interpreter->environment, name, cache);
+    bind_loop_number(interpreter, slot, name, iterable->as.bytes->data[loop->index++]);
+    return true;
+  case VALUE_RANGE:
+    if (loop->index >= loop->length)
+      return false;
+    slot = environment_lookup(interpreter->environment, name, cache);
+    bind_loop_number(interpreter, slot, name, range_at(iterable->as.range, loop->index++));
+    return true;
+  default:
+    return false;
+  }
+}
 
-  Value *fexists_builtin = value_new(VALUE_BUILTIN);
-  fexists_builtin->as.builtin_name = ms_strdup("fexists");
-  environment_define(interpreter->globals, "fexists", fexists_builtin);
+void interpreter_for_in_end(ForIn *loop) {
+  value_free(loop->iterable);
+  loop->iterable = NULL;
 }
 
 Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
@@ -778,6 +2697,8 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
     return NULL;
   }
 
+  STATS_EXPR(expr->type);
+
   switch (expr->type) {
   case EXPR_LITERAL: {
     Value *value = value_new(VALUE_NIL);
@@ -811,12 +2732,15 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
   }
 
   case EXPR_VARIABLE: {
-    Value *stored_value = environment_get(interpreter->environment,
-                                          &expr->as.variable.name, error, 
-                                          interpreter->current_filename);
-    if (*error)
+    Value **slot = environment_lookup(interpreter->environment,
+                                      expr->as.variable.name.lexeme,
+                                      &expr->as.variable.cache);
+    if (!slot) {
+      environment_get(interpreter->environment, &expr->as.variable.name, error,
+                      interpreter->current_filename); /* reports the error */
       return NULL;
-    return value_copy(stored_value); /* caller owns copy */
+    }
+    return value_copy(*slot); /* caller owns copy */
   }
 
   case EXPR_ASSIGN: {
@@ -826,13 +2750,15 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
       return NULL;
       
     // Try to assign to existing variable first
-    RuntimeError *assign_error = NULL;
-    environment_assign(interpreter->environment, &expr->as.assign.name, rhs,
-                       &assign_error, interpreter->current_filename);
-    
-    if (assign_error) {
+    Value **slot = environment_lookup(interpreter->environment,
+                                      expr->as.assign.name.lexeme,
+                                      &expr->as.assign.cache);
+    if (slot) {
+      value_free(*slot);
+      *slot = rhs;
+      environment_adopt(slot, rhs);
+    } else {
       // Variable doesn't exist, create it (implicit variable declaration)
-      runtime_error_free(assign_error);
       environment_define(interpreter->environment, expr->as.assign.name.lexeme, rhs);
     }
     
@@ -841,6 +2767,9 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
   }
 
   case EXPR_BINARY: {
+    if (expr->as.binary.quick == QUICK_NUMBER)
+      return evaluate_quick_binary(interpreter, expr, error);
+
     Value *left =
         interpreter_evaluate(interpreter, expr->as.binary.left, error);
     if (*error)
@@ -853,156 +2782,16 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
       return NULL;
     }
 
-    Value *result = value_new(VALUE_NIL);
-
-    switch (expr->as.binary.op.type) {
-    case PLUS:
-      if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
-        result->type = VALUE_NUMBER;
-        result->as.number = left->as.number + right->as.number;
-      } else if (left->type == VALUE_STRING || right->type == VALUE_STRING) {
-        /* Coerce both sides to string */
-        char *lstr = left->type == VALUE_STRING ? ms_strdup(left->as.string)
-                                                : stringify_value(left);
-        char *rstr = right->type == VALUE_STRING ? ms_strdup(right->as.string)
-                                                 : stringify_value(right);
-        size_t len = strlen(lstr) + strlen(rstr) + 1;
-        result->type = VALUE_STRING;
-        result->as.string = malloc(len);
-        strcpy(result->as.string, lstr);
-        strcat(result->as.string, rstr);
-        free(lstr);
-        free(rstr);
-      } else {
-        value_free(result);
-        value_free(left);
-        value_free(right);
-        *error =
-            runtime_error_new("Operands must be two numbers or two strings.",
-                              expr->as.binary.op.line, 
-                              interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-        return NULL;
-      }
-      break;
-    case MINUS:
-      if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
-        result->type = VALUE_NUMBER;
-        result->as.number = left->as.number - right->as.number;
-      } else {
-        value_free(result);
-        value_free(left);
-        value_free(right);
-        *error = runtime_error_new("Operands must be numbers.",
-                                   expr->as.binary.op.line, 
-                                   interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-        return NULL;
-      }
-      break;
-    case MULTIPLY:
-      if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
-        result->type = VALUE_NUMBER;
-        result->as.number = left->as.number * right->as.number;
-      } else {
-        value_free(result);
-        value_free(left);
-        value_free(right);
-        *error = runtime_error_new("Operands must be numbers.",
-                                   expr->as.binary.op.line, 
-                                   interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-        return NULL;
-      }
-      break;
-    case DIVIDE:
-      if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
-        result->type = VALUE_NUMBER;
-        result->as.number = left->as.number / right->as.number;
-      } else {
-        value_free(result);
-        value_free(left);
-        value_free(right);
-        *error = runtime_error_new("Operands must be numbers.",
-                                   expr->as.binary.op.line, 
-                                   interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-        return NULL;
-      }
-      break;
-    case GREATER:
-      if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
-        result->type = VALUE_BOOLEAN;
-        result->as.boolean = left->as.number > right->as.number;
-      } else {
-        value_free(result);
-        value_free(left);
-        value_free(right);
-        *error = runtime_error_new("Operands must be numbers.",
-                                   expr->as.binary.op.line, 
-                                   interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-        return NULL;
-      }
-      break;
-    case GREATER_EQUAL:
-      if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
-        result->type = VALUE_BOOLEAN;
-        result->as.boolean = left->as.number >= right->as.number;
-      } else {
-        value_free(result);
-        value_free(left);
-        value_free(right);
-        *error = runtime_error_new("Operands must be numbers.",
-                                   expr->as.binary.op.line, 
-                                   interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-        return NULL;
-      }
-      break;
-    case LESS:
-      if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
-        result->type = VALUE_BOOLEAN;
-        result->as.boolean = left->as.number < right->as.number;
-      } else {
-        value_free(result);
-        value_free(left);
-        value_free(right);
-        *error = runtime_error_new("Operands must be numbers.",
-                                   expr->as.binary.op.line, 
-                                   interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-        return NULL;
-      }
-      break;
-    case LESS_EQUAL:
-      if (left->type == VALUE_NUMBER && right->type == VALUE_NUMBER) {
-        result->type = VALUE_BOOLEAN;
-        result->as.boolean = left->as.number <= right->as.number;
-      } else {
-        value_free(result);
-        value_free(left);
-        value_free(right);
-        *error = runtime_error_new("Operands must be numbers.",
-                                   expr->as.binary.op.line, 
-                                   interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-        return NULL;
-      }
-      break;
-    case EQUAL:
-      result->type = VALUE_BOOLEAN;
-      result->as.boolean = values_equal(left, right);
-      break;
-    case NOT_EQUAL:
-      result->type = VALUE_BOOLEAN;
-      result->as.boolean = !values_equal(left, right);
-      break;
-    default:
-      value_free(result);
-      value_free(left);
-      value_free(right);
-      *error = runtime_error_new("Unknown binary operator.",
-                                 expr->as.binary.op.line, 
-                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-      return NULL;
-    }
-
-    value_free(left);
-    value_free(right);
-    return result;
+    /* Operations that have only seen numbers run on unboxed numbers */
+    MSTokenType op = expr->as.binary.op.type;
+    if (expr->as.binary.quick == QUICK_UNSEEN)
+      expr->as.binary.quick =
+          left->type == VALUE_NUMBER && right->type == VALUE_NUMBER &&
+                  (is_number_operator(op) || is_comparison_operator(op))
+              ? QUICK_NUMBER
+              : QUICK_GENERIC;
+    return interpreter_binary(interpreter, expr->as.binary.op.type,
+                              expr->as.binary.op.line, left, right, error);
   }
 
   case EXPR_GET: {
@@ -1016,27 +2805,7 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
       value_free(object);
       return NULL;
     }
-    if (object->type != VALUE_LIST || index_val->type != VALUE_NUMBER) {
-      value_free(object);
-      value_free(index_val);
-      *error =
-          runtime_error_new("Invalid index operation.", 0, 
-                             interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-      return NULL;
-    }
-    long idx = (long)index_val->as.number;
-    value_free(index_val);
-    if (idx < 0 || (size_t)idx >= object->as.list->count) {
-      value_free(object);
-      *error =
-          runtime_error_new("List index out of range.", 0, 
-                             interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-      return NULL;
-    }
-    /* Return copy of element */
-    Value *copy = value_copy(&object->as.list->elements[idx]);
-    value_free(object);
-    return copy;
+    return interpreter_get_index(interpreter, object, index_val, error);
   }
 
   case EXPR_SET: {
@@ -1057,31 +2826,8 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
       value_free(index_val);
       return NULL;
     }
-    if (object->type != VALUE_LIST || index_val->type != VALUE_NUMBER) {
-      value_free(object);
-      value_free(index_val);
-      value_free(value_rhs);
-      *error = runtime_error_new("Invalid set operation.", 0, 
-                                  interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-      return NULL;
-    }
-    long idx = (long)index_val->as.number;
-    value_free(index_val);
-    if (idx < 0 || (size_t)idx >= object->as.list->count) {
-      value_free(object);
-      value_free(value_rhs);
-      *error =
-          runtime_error_new("List index out of range.", 0, 
-                             interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-      return NULL;
-    }
-    /* Replace element */
-    value_free(&object->as.list->elements[idx]);
-    object->as.list->elements[idx] = *value_copy(value_rhs);
-    Value *ret = value_copy(&object->as.list->elements[idx]);
-    value_free(object);
-    value_free(value_rhs);
-    return ret;
+    return interpreter_set_index(interpreter, object, index_val, value_rhs,
+                                 error);
   }
 
   case EXPR_UNARY: {
@@ -1124,13 +2870,34 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
   }
 
   case EXPR_CALL: {
-    Value *callee =
-        interpreter_evaluate(interpreter, expr->as.call.callee, error);
-    if (*error)
-      return NULL;
+    bool tail = interpreter->tail_position;
+    interpreter->tail_position = false;
+
+    /* A named MiniScript function is called through a copy on the C stack
+     * rather than a heap copy of the variable's value */
+    Value function_value;
+    MiniScriptFunction function;
+    Value *callee = NULL;
+    if (expr->as.call.callee->type == EXPR_VARIABLE) {
+      Value **slot = environment_lookup(interpreter->environment,
+                                        expr->as.call.callee->as.variable.name.lexeme,
+                                        &expr->as.call.callee->as.variable.cache);
+      if (slot && (*slot)->type == VALUE_FUNCTION) {
+        function = *(*slot)->as.function;
+        function_value.type = VALUE_FUNCTION;
+        function_value.as.function = &function;
+        callee = &function_value;
+      }
+    }
+    if (!callee) {
+      callee = interpreter_evaluate(interpreter, expr->as.call.callee, error);
+      if (*error)
+        return NULL;
+    }
 
     // Evaluate arguments
     Value **arguments = malloc(expr->as.call.arguments.count * sizeof(Value *));
+    ALLOC_TRACK(ALLOC_CALL_ARGS, 1, expr->as.call.arguments.count * sizeof(Value *));
     for (size_t i = 0; i < expr->as.call.arguments.count; i++) {
       arguments[i] = interpreter_evaluate(
           interpreter, expr->as.call.arguments.expressions[i], error);
@@ -1140,80 +2907,17 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
           value_free(arguments[j]);
         }
         free(arguments);
-        value_free(callee);
+        if (callee != &function_value)
+          value_free(callee);
         return NULL;
       }
     }
 
-    Value *result = NULL;
-
-    if (callee->type == VALUE_BUILTIN) {
-      result = call_builtin_function(interpreter, callee->as.builtin_name,
-                                     arguments, expr->as.call.arguments.count);
-      if (!result) {
-        *error = runtime_error_new("Error calling builtin function.",
-                                   expr->as.call.paren.line, 
-                                   interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-      }
-    } else if (callee->type == VALUE_FUNCTION) {
-      // Check parameter count
-      if (expr->as.call.arguments.count != callee->as.function->declaration->as.function.param_count) {
-        *error = runtime_error_new("Wrong number of arguments.",
-                                   expr->as.call.paren.line, 
-                                   interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-      } else {
-        // Create new environment for function scope
-        Environment *previous = interpreter->environment;
-        interpreter->environment = environment_new(callee->as.function->closure);
-        
-        // Bind parameters to arguments
-        for (size_t i = 0; i < callee->as.function->declaration->as.function.param_count; i++) {
-          // Create a copy of the argument value for the parameter
-          Value *arg_copy = value_copy(arguments[i]);
-          environment_define(interpreter->environment, 
-                           callee->as.function->declaration->as.function.params[i].lexeme, 
-                           arg_copy);
-        }
-        
-        // Execute function body
-        for (size_t i = 0; i < callee->as.function->declaration->as.function.body.count && !*error; i++) {
-          interpreter_execute(interpreter, callee->as.function->declaration->as.function.body.statements[i], error);
-          
-          // Check if this was a return statement
-          if (*error && strcmp((*error)->message, "return") == 0) {
-            // This is a return, extract the return value
-            if ((*error)->return_value) {
-              result = value_copy((*error)->return_value);
-            } else {
-              result = value_new(VALUE_NIL);
-            }
-            runtime_error_free(*error);
-            *error = NULL;
-            break;
-          }
-        }
-        
-        // Restore previous environment
-        interpreter->environment = previous;
-        
-        // If no return statement was executed, return nil
-        if (!result) {
-          result = value_new(VALUE_NIL);
-        }
-      }
-    } else {
-      *error = runtime_error_new("Can only call functions and classes.",
-                                 expr->as.call.paren.line, 
-                                 interpreter->current_filename ? interpreter->current_filename : "<unknown>");
-    }
-
-    // Clean up
-    for (size_t i = 0; i < expr->as.call.arguments.count; i++) {
-      value_free(arguments[i]);
-    }
-    free(arguments);
-    value_free(callee);
-
+    Value *result = interpreter_call_value(interpreter, callee, arguments,
+                                           expr->as.call.arguments.count,
+                                           expr->as.call.paren.line, tail, error);
+    if (callee != &function_value)
+      value_free(callee);
     return result;
   }
 
@@ -1224,11 +2928,7 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
 
   case EXPR_LIST_LITERAL: {
     Value *list_value = value_new(VALUE_LIST);
-    list_value->as.list = malloc(sizeof(ValueList));
-    list_value->as.list->capacity = expr->as.list_literal.elements.count;
-    list_value->as.list->count = 0;
-    list_value->as.list->elements =
-        malloc(list_value->as.list->capacity * sizeof(Value));
+    list_value->as.list = value_list_new(expr->as.list_literal.elements.count);
 
     for (size_t i = 0; i < expr->as.list_literal.elements.count; i++) {
       Value *element = interpreter_evaluate(
@@ -1237,8 +2937,7 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
         value_free(list_value);
         return NULL;
       }
-      list_value->as.list->elements[list_value->as.list->count++] = *element;
-      free(element);
+      value_list_push(list_value->as.list, element);
     }
 
     return list_value;
@@ -1274,6 +2973,44 @@ Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
   }
 }
 
+/* Defines the function DECLARATION in the current scope, closing over it */
+void interpreter_define_function(Interpreter *interpreter, Stmt *declaration) {
+  Value *func = value_new(VALUE_FUNCTION);
+  func->as.function = malloc(sizeof(MiniScriptFunction));
+  func->as.function->declaration = declaration;
+  func->as.function->closure = interpreter->environment;
+  func->as.function->owns_closure = false; /* stored in its closure below */
+
+  environment_define(interpreter->environment, declaration->as.function.name.lexeme, func);
+}
+
+/* Enters the module at PATH, imported on LINE: pushes its frame and makes
+ * it the current file, saving what interpreter_leave_module restores.
+ * Returns false with *ERROR set if the call stack is full. */
+bool interpreter_enter_module(Interpreter *interpreter, const char *path,
+                              size_t line, ModuleScope *scope,
+                              RuntimeError **error) {
+  if (!check_stack(interpreter, line, error))
+    return false;
+  scope->filename = interpreter->current_filename ? ms_strdup(interpreter->current_filename) : NULL;
+  push_frame(interpreter, "<module>", intern_module_path(interpreter, path), 0);
+  interpreter_set_filename(interpreter, path);
+  scope->line_counts = interpreter->line_counts;
+  if (scope->line_counts)
+    interpreter->line_counts = line_counts_file(path);
+  scope->function = interpreter->current_function;
+  interpreter->current_function = NULL;
+  return true;
+}
+
+void interpreter_leave_module(Interpreter *interpreter, ModuleScope *scope) {
+  interpreter_set_filename(interpreter, scope->filename);
+  interpreter->line_counts = scope->line_counts;
+  interpreter->current_function = scope->function;
+  pop_frame(interpreter);
+  free(scope->filename);
+}
+
 // Debug helper function to get line number from expression
 static size_t get_expr_line_number(Expr *expr) {
   if (!expr) return 0;
@@ -1372,26 +3109,33 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
   if (!stmt)
     return;
 
-// Debug: Print statement type being executed (always enabled for debugging)
-  const char *stmt_type_names[] = {
-    "BLOCK", "EXPRESSION", "PRINT", "FUNCTION", "FOR", 
-    "IF", "RETURN", "WHILE", "IMPORT", "ASSERT", "VAR"
-  };
-  
-  size_t line_num = get_stmt_line_number(stmt);
-  const char *filename = interpreter->current_filename ? interpreter->current_filename : "<unknown>";
-  
-  if (stmt->type >= 0 && stmt->type < sizeof(stmt_type_names)/sizeof(stmt_type_names[0])) {
-    if (line_num > 0) {
-      char *source_line = read_line_from_file(filename, line_num);
-      if (source_line) {
-        printf("[DEBUG] %s:%zu: %s | %s\n", filename, line_num, stmt_type_names[stmt->type], source_line);
-        free(source_line);
+  interpreter->frames[interpreter->frame_count - 1].line = stmt->line;
+  if (stmt->type != STMT_BLOCK) /* counted through the statements inside */
+    LINE_COUNT(interpreter->line_counts, stmt->line);
+  STATS_STMT(stmt->type);
+
+  // Debug: Print statement type being executed (set MS_DEBUG_TRACE=1)
+  if (interpreter->debug_trace) {
+    const char *stmt_type_names[] = {
+      "BLOCK", "EXPRESSION", "PRINT", "FUNCTION", "FOR",
+      "IF", "RETURN", "WHILE", "IMPORT", "ASSERT", "VAR"
+    };
+
+    size_t line_num = get_stmt_line_number(stmt);
+    const char *filename = interpreter->current_filename ? interpreter->current_filename : "<unknown>";
+
+    if (stmt->type >= 0 && stmt->type < sizeof(stmt_type_names)/sizeof(stmt_type_names[0])) {
+      if (line_num > 0) {
+        char *source_line = read_line_from_file(filename, line_num);
+        if (source_line) {
+          printf("[DEBUG] %s:%zu: %s | %s\n", filename, line_num, stmt_type_names[stmt->type], source_line);
+          free(source_line);
+        } else {
+          printf("[DEBUG] %s:%zu: %s\n", filename, line_num, stmt_type_names[stmt->type]);
+        }
       } else {
-        printf("[DEBUG] %s:%zu: %s\n", filename, line_num, stmt_type_names[stmt->type]);
+        printf("[DEBUG] %s: %s\n", filename, stmt_type_names[stmt->type]);
       }
-    } else {
-      printf("[DEBUG] %s: %s\n", filename, stmt_type_names[stmt->type]);
     }
   }
 
@@ -1434,7 +3178,8 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
       value = value_new(VALUE_NIL);
     }
 
-    printf("[DEBUG] Defining variable: %s\n", stmt->as.var.name.lexeme);
+    if (interpreter->debug_trace)
+      printf("[DEBUG] Defining variable: %s\n", stmt->as.var.name.lexeme);
 
     environment_define(interpreter->environment, stmt->as.var.name.lexeme,
                        value);
@@ -1453,7 +3198,7 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
         break;
     }
 
-    environment_free(interpreter->environment);
+    environment_release(interpreter->environment);
     interpreter->environment = previous;
     break;
   }
@@ -1490,6 +3235,10 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
       interpreter_execute(interpreter, stmt->as.while_stmt.body, error);
       if (*error)
         return;
+      if (interpreter->current_function)
+        interpreter->current_function->as.function.hotness++;
+      if (interpreter->jit && jit_loop(interpreter, stmt))
+        break;
     }
     break;
   }
@@ -1531,7 +3280,34 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
           return;
         value_free(inc_result);
       }
+      if (interpreter->current_function)
+        interpreter->current_function->as.function.hotness++;
+      if (interpreter->jit && jit_loop(interpreter, stmt))
+        break;
+    }
+    break;
+  }
+
+  case STMT_FOR_IN: {
+    Value *iterable =
+        interpreter_evaluate(interpreter, stmt->as.for_in.iterable, error);
+    if (*error)
+      return;
+    const char *name = stmt->as.for_in.name.lexeme;
+    ForIn loop;
+    if (!interpreter_for_in_begin(interpreter, &loop, iterable, stmt->line, error))
+      return;
+    if (stmt->as.for_in.declare)
+      environment_define(interpreter->environment, name, value_new(VALUE_NIL));
+
+    while (interpreter_for_in_next(interpreter, &loop, name, &stmt->as.for_in.cache)) {
+      interpreter_execute(interpreter, stmt->as.for_in.body, error);
+      if (*error)
+        break;
+      if (interpreter->current_function)
+        interpreter->current_function->as.function.hotness++;
     }
+    interpreter_for_in_end(&loop);
     break;
   }
 
@@ -1544,37 +3320,38 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
     value_free(condition);
     if (!ok) {
       const char *msg = "Assertion failed";
+      Value *msg_val = NULL;
       if (stmt->as.assert_stmt.message) {
-        Value *msg_val = interpreter_evaluate(
+        msg_val = interpreter_evaluate(
             interpreter, stmt->as.assert_stmt.message, error);
-        if (!*error && msg_val && msg_val->type == VALUE_STRING) {
+        if (*error) {
+          if (msg_val)
+            value_free(msg_val);
+          return;
+        }
+        if (msg_val && msg_val->type == VALUE_STRING) {
           msg = msg_val->as.string;
         }
-        if (msg_val)
-          value_free(msg_val);
       }
       *error =
           runtime_error_new(msg, stmt->as.assert_stmt.keyword.line, 
                              interpreter->current_filename ? interpreter->current_filename : "<unknown>");
+      if (msg_val)
+        value_free(msg_val); /* runtime_error_new copies the message */
       return;
     }
     break;
   }
 
-  case STMT_FUNCTION: {
-    // Create a function value and define it in the current environment
-    Value *func = value_new(VALUE_FUNCTION);
-    func->as.function = malloc(sizeof(MiniScriptFunction));
-    func->as.function->declaration = stmt;
-    func->as.function->closure = interpreter->environment;
-    
-    environment_define(interpreter->environment, stmt->as.function.name.lexeme, func);
+  case STMT_FUNCTION:
+    interpreter_define_function(interpreter, stmt);
     break;
-  }
 
   case STMT_RETURN: {
     Value *return_value = NULL;
     if (stmt->as.return_stmt.value != NULL) {
+      interpreter->tail_position = stmt->as.return_stmt.value->type == EXPR_CALL &&
+                                   interpreter->current_function != NULL;
       return_value = interpreter_evaluate(interpreter, stmt->as.return_stmt.value, error);
       if (*error)
         return;
@@ -1593,7 +3370,8 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
     // The path should be a string literal from the import statement
     const char *path = stmt->as.import.path_token.lexeme;
     
-    printf("[DEBUG] Importing file: %s\n", path);
+    if (interpreter->debug_trace)
+      printf("[DEBUG] Importing file: %s\n", path);
     
     // Remove quotes from the path (it comes as "path")
     size_t path_len = strlen(path);
@@ -1603,18 +3381,23 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
       strncpy(clean_path, path + 1, path_len - 2);
       clean_path[path_len - 2] = '\0';
       
-      printf("[DEBUG] Clean import path: %s\n", clean_path);
+      if (interpreter->debug_trace)
+        printf("[DEBUG] Clean import path: %s\n", clean_path);
       
       // Add .ms extension if not present
       if (strlen(clean_path) < 3 || strcmp(clean_path + strlen(clean_path) - 3, ".ms") != 0) {
         strcat(clean_path, ".ms");
       }
       
-      printf("[DEBUG] Final import path: %s\n", clean_path);
+      if (interpreter->debug_trace)
+        printf("[DEBUG] Final import path: %s\n", clean_path);
       
       // Load and execute the imported file
+      uint64_t import_started = interpreter->trace ? monotonic_ns() : 0;
+      PROBE_IMPORT_START(clean_path);
       FILE *file = fopen(clean_path, "r");
       if (!file) {
+        PROBE_IMPORT_DONE(clean_path);
         free(clean_path);
         *error = runtime_error_new("Could not open import file.", 
                                    stmt->as.import.path_token.line, 
@@ -1631,38 +3414,58 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
       fread(source, 1, file_size, file);
       source[file_size] = '\0';
       fclose(file);
+      if (interpreter->trace)
+        trace_span("import", "read", import_started, clean_path);
       
       // Parse and execute the imported file
+      if (alloc_tracking)
+        alloc_source_begin(clean_path);
+      uint64_t phase_started = interpreter->trace ? monotonic_ns() : 0;
       Lexer *lexer = lexer_new(source);
       lexer_scan_tokens(lexer);
+      if (interpreter->trace) {
+        trace_span("import", "lex", phase_started, clean_path);
+        phase_started = monotonic_ns();
+      }
       
       // Check if lexer encountered errors (simplified check)
       Parser *parser = parser_new(lexer->tokens, lexer->token_count, clean_path);
       StmtList statements = parser_parse(parser, error);
+      if (alloc_tracking)
+        alloc_source_end();
+      if (interpreter->trace)
+        trace_span("import", "parse", phase_started, clean_path);
       
-      if (!*error) {
-        // Save the current filename and set it to the imported file
-        char *previous_filename = interpreter->current_filename ? ms_strdup(interpreter->current_filename) : NULL;
-        interpreter_set_filename(interpreter, clean_path);
-        
+      ModuleScope scope;
+      if (!*error && interpreter_enter_module(interpreter, clean_path,
+                                              stmt->as.import.path_token.line,
+                                              &scope, error)) {
+        phase_started = interpreter->trace ? monotonic_ns() : 0;
         interpreter_interpret(interpreter, statements, error);
-        
-        // Restore the previous filename
-        interpreter_set_filename(interpreter, previous_filename);
-        if (previous_filename) {
-          free(previous_filename);
-        }
+        if (interpreter->trace)
+          trace_span("import", "execute", phase_started, clean_path);
+        interpreter_leave_module(interpreter, &scope);
       }
       
-      // Cleanup statements
+      // Keep the module's statements alive: functions it declared refer to
+      // their declarations for as long as the interpreter runs.
       for (size_t i = 0; i < statements.count; i++) {
-        stmt_free(statements.statements[i]);
+        StmtList *imported = &interpreter->imported;
+        if (imported->count >= imported->capacity) {
+          imported->capacity = imported->capacity == 0 ? 8 : imported->capacity * 2;
+          imported->statements =
+              realloc(imported->statements, imported->capacity * sizeof(Stmt *));
+        }
+        imported->statements[imported->count++] = statements.statements[i];
       }
       free(statements.statements);
       
       parser_free(parser);
       lexer_free(lexer);
       free(source);
+      PROBE_IMPORT_DONE(clean_path);
+      if (interpreter->trace)
+        trace_span("import", clean_path, import_started, clean_path);
       free(clean_path);
     } else {
       *error = runtime_error_new("Invalid import path format.", 
@@ -1680,11 +3483,84 @@ void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
   }
 }
 
+#ifndef _WIN32
+/* Native stack given to each allowed nested call (one script call passes
+ * through the call, block, statement and expression evaluators), plus a
+ * reserve below stack_limit for builtins and error reporting */
+#define STACK_BYTES_PER_CALL (8 * 1024)
+#define STACK_RESERVE (1024 * 1024)
+
+typedef struct {
+  Interpreter *interpreter;
+  StmtList statements;
+  NativeCode native; /* run instead of the statements, if set */
+  RuntimeError **error;
+} ScriptRun;
+
+static void *run_script(void *argument) {
+  ScriptRun *run = argument;
+  if (run->native)
+    interpreter_run_native(run->interpreter, run->native, run->error);
+  else
+    interpreter_interpret(run->interpreter, run->statements, run->error);
+  return NULL;
+}
+
+/* The tree walker recurses on the C stack, so a script runs on a thread
+ * whose stack is sized from max_depth rather than the process's default.
+ * Pages are only committed as deep calls touch them. Returns false if the
+ * stack could not be set up and the caller should run in place. */
+static bool run_on_script_stack(Interpreter *interpreter, ScriptRun *run) {
+  size_t size = interpreter->max_depth * STACK_BYTES_PER_CALL + 2 * STACK_RESERVE;
+  void *base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED)
+    return false;
+  mprotect(base, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+
+  pthread_attr_t attributes;
+  pthread_t thread;
+  bool started = pthread_attr_init(&attributes) == 0;
+  if (started) {
+    interpreter->stack_limit = (uintptr_t)base + STACK_RESERVE;
+    interpreter->on_script_stack = true;
+    started = pthread_attr_setstack(&attributes, base, size) == 0 &&
+              pthread_create(&thread, &attributes, run_script, run) == 0;
+    pthread_attr_destroy(&attributes);
+  }
+  if (started)
+    pthread_join(thread, NULL);
+  interpreter->stack_limit = 0;
+  interpreter->on_script_stack = false;
+  munmap(base, size);
+  return started;
+}
+#endif
+
 void interpreter_interpret(Interpreter *interpreter, StmtList statements,
                            RuntimeError **error) {
+#ifndef _WIN32
+  ScriptRun run = {interpreter, statements, NULL, error};
+  if (!interpreter->on_script_stack && run_on_script_stack(interpreter, &run))
+    return;
+#endif
   for (size_t i = 0; i < statements.count; i++) {
     interpreter_execute(interpreter, statements.statements[i], error);
     if (*error)
       return;
   }
 }
+
+/* Runs the compiled top level of a script (aot.c) the way
+ * interpreter_interpret runs its statements */
+void interpreter_run_native(Interpreter *interpreter, NativeCode native,
+                            RuntimeError **error) {
+#ifndef _WIN32
+  ScriptRun run = {interpreter, {NULL, 0, 0}, native, error};
+  if (!interpreter->on_script_stack && run_on_script_stack(interpreter, &run))
+    return;
+#endif
+  Value *result = native(interpreter, error);
+  if (result)
+    value_free(result);
+}
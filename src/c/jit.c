@@ -0,0 +1,1234 @@
+#define _GNU_SOURCE
+#include "mini_script.h"
+
+/* Baseline JIT.
+ *
+ * Functions that become hot (calls plus loop iterations, counted by the
+ * interpreter) are compiled to x86-64 machine code if everything they do
+ * fits the numeric subset: parameters and locals holding numbers or
+ * booleans, arithmetic, comparisons, logical operators, if/while/for,
+ * assert, return, and calls to functions that fit the subset too. Such
+ * code has no side effects outside its own frame, so whenever compiled code
+ * cannot continue (a failed assert, falling off the end of a function,
+ * native recursion deeper than JIT_MAX_DEPTH) it bails out and the
+ * interpreter simply runs the call again from the start.
+ *
+ * Loops that become hot are compiled the same way and entered mid-loop
+ * (on-stack replacement): the variables the loop uses from enclosing scopes
+ * are copied into native slots when it is entered, written back to their
+ * environments at the top of every iteration, and so are left as they were
+ * at the start of the iteration if the loop bails out. The interpreter then
+ * carries on with that iteration.
+ *
+ * A compilation unit is the hot function or loop plus every function it calls,
+ * transitively, each resolved by name in its closure at compile time. The
+ * resolutions are rechecked on every entry from the interpreter, so
+ * reassigning a global function falls back to the interpreter.
+ *
+ * Values live in SSE registers and stack slots as doubles; booleans are
+ * 0.0 and 1.0, their static type tracked by the compiler. Expressions are
+ * compiled to leave their result in xmm0, with operands spilled to the
+ * machine stack.
+ */
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define JIT_HOT_THRESHOLD 1000 /* calls plus loop iterations before compiling */
+#define JIT_MAX_DEPTH 20000    /* native call depth before bailing out */
+
+typedef enum { JT_NUMBER, JT_BOOLEAN } JitType;
+
+typedef struct {
+  const char *name;
+  size_t slot;
+  JitType type;
+} JitLocal;
+
+typedef struct {
+  Environment *env;   /* scope the name was resolved in, NULL for the loop's */
+  const char *name;   /* borrowed from the call expression */
+  Stmt *declaration;  /* function it resolved to */
+  Environment *closure;
+  uint64_t closure_stamp; /* scopes are freed and their memory reused; the
+                             stamp tells a new scope at the same address */
+} JitDependency;
+
+struct JitCode {
+  unsigned char *memory;
+  size_t size;
+  int (*entry)(double *args, double *result);
+  JitType return_type;
+  Environment *closure;
+  uint64_t closure_stamp;
+  JitDependency *deps;
+  size_t dep_count;
+  JitLocal *outers; /* loops: variables of enclosing scopes, in entry order */
+  size_t outer_count;
+  unsigned bails;   /* times native code could not run */
+  unsigned skip;    /* entries to leave to the interpreter after a bail */
+};
+
+static JitCode jit_unsupported; /* marks declarations that failed to compile */
+static long jit_depth;          /* native frames active, for JIT_MAX_DEPTH */
+static FILE *perf_map;
+
+/* Code buffers */
+
+typedef struct {
+  size_t offset; /* of the rel32 field */
+  size_t target; /* label, or unit function for calls */
+} JitFixup;
+
+typedef struct {
+  unsigned char *bytes;
+  size_t length;
+  size_t capacity;
+  size_t *labels; /* offsets; SIZE_MAX until placed */
+  size_t label_count;
+  JitFixup *jumps;
+  size_t jump_count;
+  JitFixup *calls;
+  size_t call_count;
+} CodeBuffer;
+
+static void emit_bytes(CodeBuffer *code, const unsigned char *bytes, size_t n) {
+  if (code->length + n > code->capacity) {
+    while (code->length + n > code->capacity)
+      code->capacity = code->capacity == 0 ? 256 : code->capacity * 2;
+    code->bytes = realloc(code->bytes, code->capacity);
+  }
+  memcpy(code->bytes + code->length, bytes, n);
+  code->length += n;
+}
+
+#define EMIT(code, ...)                                                        \
+  emit_bytes((code), (const unsigned char[]){__VA_ARGS__},                    \
+             sizeof((const unsigned char[]){__VA_ARGS__}))
+
+static void emit_u32(CodeBuffer *code, uint32_t value) {
+  emit_bytes(code, (const unsigned char *)&value, 4);
+}
+
+static void emit_u64(CodeBuffer *code, uint64_t value) {
+  emit_bytes(code, (const unsigned char *)&value, 8);
+}
+
+static size_t new_label(CodeBuffer *code) {
+  code->labels = realloc(code->labels, (code->label_count + 1) * sizeof(size_t));
+  code->labels[code->label_count] = SIZE_MAX;
+  return code->label_count++;
+}
+
+static void place_label(CodeBuffer *code, size_t label) {
+  code->labels[label] = code->length;
+}
+
+static void add_fixup(JitFixup **fixups, size_t *count, size_t offset,
+                      size_t target) {
+  *fixups = realloc(*fixups, (*count + 1) * sizeof(JitFixup));
+  (*fixups)[*count].offset = offset;
+  (*fixups)[*count].target = target;
+  (*count)++;
+}
+
+/* jmp rel32 (opcode E9) or jcc rel32 (0F 8x) to a label */
+static void emit_jump(CodeBuffer *code, unsigned char condition, size_t label) {
+  if (condition == 0)
+    EMIT(code, 0xE9);
+  else
+    EMIT(code, 0x0F, condition);
+  add_fixup(&code->jumps, &code->jump_count, code->length, label);
+  emit_u32(code, 0);
+}
+
+#define JMP 0x00
+#define JA 0x87
+#define JAE 0x83
+#define JB 0x82
+#define JBE 0x86
+#define JE 0x84
+#define JNE 0x85
+#define JP 0x8A
+#define JG 0x8F
+
+/* call rel32 to a label of the same function */
+static void emit_call_label(CodeBuffer *code, size_t label) {
+  EMIT(code, 0xE8);
+  add_fixup(&code->jumps, &code->jump_count, code->length, label);
+  emit_u32(code, 0);
+}
+
+static void resolve_jumps(CodeBuffer *code) {
+  for (size_t i = 0; i < code->jump_count; i++) {
+    JitFixup *jump = &code->jumps[i];
+    int32_t rel = (int32_t)(code->labels[jump->target] - (jump->offset + 4));
+    memcpy(code->bytes + jump->offset, &rel, 4);
+  }
+}
+
+static void free_code_buffer(CodeBuffer *code) {
+  free(code->bytes);
+  free(code->labels);
+  free(code->jumps);
+  free(code->calls);
+}
+
+/* Compilation units */
+
+typedef struct {
+  Stmt *declaration;
+  Environment *closure;
+  CodeBuffer code;
+  Stmt *loop;    /* the loop, when compiling one instead of a function */
+  size_t offset; /* in the unit's memory after layout */
+  bool return_known;
+  JitType return_type;
+  bool assumed_number; /* called before its return type was known */
+} UnitFunction;
+
+typedef struct {
+  UnitFunction *functions;
+  size_t count;
+  JitDependency *deps;
+  size_t dep_count;
+  JitLocal *outers; /* of the loop being compiled */
+  size_t outer_count;
+  const char *failure; /* first construct that could not be compiled */
+} Unit;
+
+typedef struct {
+  Unit *unit;
+  size_t index; /* of the function in the unit */
+  CodeBuffer *code;
+  JitLocal *locals; /* innermost scope last */
+  size_t local_count;
+  size_t slot_count;
+  size_t depth; /* doubles pushed on the machine stack */
+  size_t exit_label;
+  size_t bail_label;
+  Environment *loop_env; /* loops: where outer variables are looked up */
+  JitLocal *outers;
+  size_t outer_count;
+  size_t commit_label; /* loops: stores the outer variables to the vars array */
+  size_t body_label;   /* functions: after the parameters are loaded */
+} FunctionCompiler;
+
+static bool compile_unit_function(Unit *unit, size_t index);
+
+static bool fail(FunctionCompiler *fc, const char *reason) {
+  if (!fc->unit->failure)
+    fc->unit->failure = reason;
+  return false;
+}
+
+static int32_t slot_offset(size_t slot) {
+  return -16 - 8 * (int32_t)slot; /* below the saved rbp and rbx */
+}
+
+static void load_slot(FunctionCompiler *fc, size_t slot) {
+  EMIT(fc->code, 0xF2, 0x0F, 0x10, 0x85); /* movsd xmm0, [rbp+disp32] */
+  emit_u32(fc->code, (uint32_t)slot_offset(slot));
+}
+
+static void store_slot(FunctionCompiler *fc, size_t slot) {
+  EMIT(fc->code, 0xF2, 0x0F, 0x11, 0x85); /* movsd [rbp+disp32], xmm0 */
+  emit_u32(fc->code, (uint32_t)slot_offset(slot));
+}
+
+static void load_constant(FunctionCompiler *fc, double value, bool into_xmm1) {
+  uint64_t bits;
+  memcpy(&bits, &value, 8);
+  EMIT(fc->code, 0x48, 0xB8); /* mov rax, imm64 */
+  emit_u64(fc->code, bits);
+  if (into_xmm1)
+    EMIT(fc->code, 0x66, 0x48, 0x0F, 0x6E, 0xC8); /* movq xmm1, rax */
+  else
+    EMIT(fc->code, 0x66, 0x48, 0x0F, 0x6E, 0xC0); /* movq xmm0, rax */
+}
+
+static void push_xmm0(FunctionCompiler *fc) {
+  EMIT(fc->code, 0x48, 0x83, 0xEC, 0x08);       /* sub rsp, 8 */
+  EMIT(fc->code, 0xF2, 0x0F, 0x11, 0x04, 0x24); /* movsd [rsp], xmm0 */
+  fc->depth++;
+}
+
+static void pop_xmm0(FunctionCompiler *fc) {
+  EMIT(fc->code, 0xF2, 0x0F, 0x10, 0x04, 0x24); /* movsd xmm0, [rsp] */
+  EMIT(fc->code, 0x48, 0x83, 0xC4, 0x08);       /* add rsp, 8 */
+  fc->depth--;
+}
+
+static void pop_xmm1(FunctionCompiler *fc) {
+  EMIT(fc->code, 0xF2, 0x0F, 0x10, 0x0C, 0x24); /* movsd xmm1, [rsp] */
+  EMIT(fc->code, 0x48, 0x83, 0xC4, 0x08);       /* add rsp, 8 */
+  fc->depth--;
+}
+
+static JitLocal *find_local(FunctionCompiler *fc, const char *name) {
+  for (size_t i = fc->local_count; i > 0; i--) {
+    if (strcmp(fc->locals[i - 1].name, name) == 0)
+      return &fc->locals[i - 1];
+  }
+  return NULL;
+}
+
+static Value *lookup_name(Environment *env, const char *name);
+
+/* Locals first, then (compiling a loop) a number or boolean variable of an
+ * enclosing scope, which gets a slot of its own */
+static JitLocal *find_variable(FunctionCompiler *fc, const char *name) {
+  JitLocal *local = find_local(fc, name);
+  if (local || !fc->loop_env)
+    return local;
+  for (size_t i = 0; i < fc->outer_count; i++) {
+    if (strcmp(fc->outers[i].name, name) == 0)
+      return &fc->outers[i];
+  }
+  Value *value = lookup_name(fc->loop_env, name);
+  if (!value || (value->type != VALUE_NUMBER && value->type != VALUE_BOOLEAN))
+    return NULL;
+  fc->outers = realloc(fc->outers, (fc->outer_count + 1) * sizeof(JitLocal));
+  fc->outers[fc->outer_count].name = name;
+  fc->outers[fc->outer_count].slot = fc->slot_count++;
+  fc->outers[fc->outer_count].type =
+      value->type == VALUE_NUMBER ? JT_NUMBER : JT_BOOLEAN;
+  return &fc->outers[fc->outer_count++];
+}
+
+static size_t declare_local(FunctionCompiler *fc, const char *name, JitType type) {
+  fc->locals = realloc(fc->locals, (fc->local_count + 1) * sizeof(JitLocal));
+  fc->locals[fc->local_count].name = name;
+  fc->locals[fc->local_count].slot = fc->slot_count;
+  fc->locals[fc->local_count].type = type;
+  fc->local_count++;
+  return fc->slot_count++;
+}
+
+static Value *lookup_name(Environment *env, const char *name) {
+  for (; env; env = env->enclosing) {
+    for (size_t i = 0; i < env->values.count; i++) {
+      if (strcmp(env->values.keys[i], name) == 0)
+        return env->values.values[i];
+    }
+  }
+  return NULL;
+}
+
+/* Expressions */
+
+static bool compile_expr(FunctionCompiler *fc, Expr *expr, JitType *type);
+
+static bool is_comparison(MSTokenType op) {
+  return op == GREATER || op == GREATER_EQUAL || op == LESS ||
+         op == LESS_EQUAL || op == EQUAL || op == NOT_EQUAL;
+}
+
+/* Evaluates both operands: left ends up in xmm1, right in xmm0 */
+static bool compile_operands(FunctionCompiler *fc, Expr *expr, JitType *left,
+                             JitType *right) {
+  if (!compile_expr(fc, expr->as.binary.left, left))
+    return false;
+  push_xmm0(fc);
+  if (!compile_expr(fc, expr->as.binary.right, right))
+    return false;
+  pop_xmm1(fc);
+  return true;
+}
+
+static bool compile_binary(FunctionCompiler *fc, Expr *expr, JitType *type) {
+  JitType left, right;
+  if (!compile_operands(fc, expr, &left, &right))
+    return false;
+
+  MSTokenType op = expr->as.binary.op.type;
+  if (op == EQUAL || op == NOT_EQUAL) {
+    *type = JT_BOOLEAN;
+    if (left != right) {
+      load_constant(fc, op == NOT_EQUAL ? 1.0 : 0.0, false);
+      return true;
+    }
+    EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC8); /* ucomisd xmm1, xmm0 */
+    if (op == EQUAL) {
+      EMIT(fc->code, 0x0F, 0x94, 0xC0); /* sete al */
+      EMIT(fc->code, 0x0F, 0x9B, 0xC1); /* setnp cl */
+      EMIT(fc->code, 0x20, 0xC8);       /* and al, cl */
+    } else {
+      EMIT(fc->code, 0x0F, 0x95, 0xC0); /* setne al */
+      EMIT(fc->code, 0x0F, 0x9A, 0xC1); /* setp cl */
+      EMIT(fc->code, 0x08, 0xC8);       /* or al, cl */
+    }
+  } else {
+    if (left != JT_NUMBER || right != JT_NUMBER)
+      return fail(fc, "arithmetic on booleans");
+    switch (op) {
+    case PLUS:
+      EMIT(fc->code, 0xF2, 0x0F, 0x58, 0xC1); /* addsd xmm0, xmm1 */
+      *type = JT_NUMBER;
+      return true;
+    case MULTIPLY:
+      EMIT(fc->code, 0xF2, 0x0F, 0x59, 0xC1); /* mulsd xmm0, xmm1 */
+      *type = JT_NUMBER;
+      return true;
+    case MINUS:
+      EMIT(fc->code, 0xF2, 0x0F, 0x5C, 0xC8); /* subsd xmm1, xmm0 */
+      EMIT(fc->code, 0x66, 0x0F, 0x28, 0xC1); /* movapd xmm0, xmm1 */
+      *type = JT_NUMBER;
+      return true;
+    case DIVIDE:
+      EMIT(fc->code, 0xF2, 0x0F, 0x5E, 0xC8); /* divsd xmm1, xmm0 */
+      EMIT(fc->code, 0x66, 0x0F, 0x28, 0xC1); /* movapd xmm0, xmm1 */
+      *type = JT_NUMBER;
+      return true;
+    case GREATER:
+      EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC8); /* ucomisd xmm1, xmm0 */
+      EMIT(fc->code, 0x0F, 0x97, 0xC0);       /* seta al */
+      break;
+    case GREATER_EQUAL:
+      EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC8); /* ucomisd xmm1, xmm0 */
+      EMIT(fc->code, 0x0F, 0x93, 0xC0);       /* setae al */
+      break;
+    case LESS:
+      EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC1); /* ucomisd xmm0, xmm1 */
+      EMIT(fc->code, 0x0F, 0x97, 0xC0);       /* seta al */
+      break;
+    case LESS_EQUAL:
+      EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC1); /* ucomisd xmm0, xmm1 */
+      EMIT(fc->code, 0x0F, 0x93, 0xC0);       /* setae al */
+      break;
+    default:
+      return fail(fc, "unknown binary operator");
+    }
+    *type = JT_BOOLEAN;
+  }
+  EMIT(fc->code, 0x0F, 0xB6, 0xC0);       /* movzx eax, al */
+  EMIT(fc->code, 0xF2, 0x0F, 0x2A, 0xC0); /* cvtsi2sd xmm0, eax */
+  return true;
+}
+
+/* Jumps to FALSE_LABEL unless the boolean in xmm0 is true */
+static void jump_if_false(FunctionCompiler *fc, size_t false_label) {
+  EMIT(fc->code, 0x66, 0x0F, 0x57, 0xC9); /* xorpd xmm1, xmm1 */
+  EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC1); /* ucomisd xmm0, xmm1 */
+  emit_jump(fc->code, JE, false_label);
+}
+
+/* Branches on a condition without materializing it where possible */
+static bool compile_condition(FunctionCompiler *fc, Expr *expr, size_t false_label) {
+  while (expr->type == EXPR_GROUPING)
+    expr = expr->as.grouping.expression;
+
+  if (expr->type == EXPR_BINARY && is_comparison(expr->as.binary.op.type)) {
+    JitType left, right;
+    if (!compile_operands(fc, expr, &left, &right))
+      return false;
+    MSTokenType op = expr->as.binary.op.type;
+    if (op == EQUAL || op == NOT_EQUAL) {
+      if (left != right) {
+        if (op == EQUAL)
+          emit_jump(fc->code, JMP, false_label);
+        return true;
+      }
+      EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC8); /* ucomisd xmm1, xmm0 */
+      if (op == EQUAL) {
+        emit_jump(fc->code, JNE, false_label);
+        emit_jump(fc->code, JP, false_label);
+      } else {
+        size_t unordered = new_label(fc->code);
+        emit_jump(fc->code, JP, unordered);
+        emit_jump(fc->code, JE, false_label);
+        place_label(fc->code, unordered);
+      }
+      return true;
+    }
+    if (left != JT_NUMBER || right != JT_NUMBER)
+      return fail(fc, "comparison of booleans");
+    if (op == GREATER || op == GREATER_EQUAL)
+      EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC8); /* ucomisd xmm1, xmm0 */
+    else
+      EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC1); /* ucomisd xmm0, xmm1 */
+    emit_jump(fc->code, op == GREATER || op == LESS ? JBE : JB, false_label);
+    return true;
+  }
+
+  JitType type;
+  if (!compile_expr(fc, expr, &type))
+    return false;
+  if (type == JT_BOOLEAN)
+    jump_if_false(fc, false_label);
+  /* numbers are always truthy */
+  return true;
+}
+
+static bool compile_call(FunctionCompiler *fc, Expr *expr, JitType *type) {
+  Expr *callee = expr->as.call.callee;
+  if (callee->type != EXPR_VARIABLE)
+    return fail(fc, "call of a computed function");
+  const char *name = callee->as.variable.name.lexeme;
+  if (find_local(fc, name))
+    return fail(fc, "call through a local variable");
+
+  Environment *env = fc->unit->functions[fc->index].closure;
+  Value *function = lookup_name(env, name);
+  if (!function || function->type != VALUE_FUNCTION)
+    return fail(fc, "call of something other than a MiniScript function");
+  Stmt *declaration = function->as.function->declaration;
+  Environment *closure = function->as.function->closure;
+  size_t arg_count = expr->as.call.arguments.count;
+  if (arg_count != declaration->as.function.param_count)
+    return fail(fc, "call with the wrong number of arguments");
+
+  Unit *unit = fc->unit;
+  unit->deps = realloc(unit->deps, (unit->dep_count + 1) * sizeof(JitDependency));
+  unit->deps[unit->dep_count++] =
+      (JitDependency){fc->loop_env ? NULL : env, name, declaration, closure,
+                      closure->stamp};
+
+  size_t target = unit->count;
+  for (size_t i = 0; i < unit->count; i++) {
+    if (unit->functions[i].declaration == declaration &&
+        unit->functions[i].closure == closure) {
+      target = i;
+      break;
+    }
+  }
+  if (target == unit->count) {
+    unit->functions = realloc(unit->functions, (unit->count + 1) * sizeof(UnitFunction));
+    memset(&unit->functions[target], 0, sizeof(UnitFunction));
+    unit->functions[target].declaration = declaration;
+    unit->functions[target].closure = closure;
+    unit->count++;
+    if (!compile_unit_function(unit, target))
+      return false;
+  }
+  UnitFunction *callee_function = &unit->functions[target];
+  if (callee_function->return_known) {
+    *type = callee_function->return_type;
+  } else {
+    callee_function->assumed_number = true; /* recursive: checked at the end */
+    *type = JT_NUMBER;
+  }
+
+  /* Return slot and arguments, args[i] at [rsp + 8i], 16-byte aligned */
+  size_t pad = (fc->depth + 1 + arg_count) % 2;
+  EMIT(fc->code, 0x48, 0x83, 0xEC, (unsigned char)(8 * (pad + 1))); /* sub rsp */
+  fc->depth += pad + 1;
+  for (size_t i = arg_count; i > 0; i--) {
+    JitType arg_type;
+    if (!compile_expr(fc, expr->as.call.arguments.expressions[i - 1], &arg_type))
+      return false;
+    if (arg_type != JT_NUMBER)
+      return fail(fc, "boolean argument");
+    push_xmm0(fc);
+  }
+  EMIT(fc->code, 0x48, 0x8D, 0x3C, 0x24);       /* lea rdi, [rsp] */
+  EMIT(fc->code, 0x48, 0x8D, 0xB4, 0x24);       /* lea rsi, [rsp+disp32] */
+  emit_u32(fc->code, (uint32_t)(8 * arg_count));
+  EMIT(fc->code, 0xE8);                         /* call rel32 */
+  add_fixup(&fc->code->calls, &fc->code->call_count, fc->code->length, target);
+  emit_u32(fc->code, 0);
+  EMIT(fc->code, 0x85, 0xC0);                   /* test eax, eax */
+  emit_jump(fc->code, JNE, fc->exit_label);     /* callee bailed out */
+  EMIT(fc->code, 0xF2, 0x0F, 0x10, 0x84, 0x24); /* movsd xmm0, [rsp+disp32] */
+  emit_u32(fc->code, (uint32_t)(8 * arg_count));
+  EMIT(fc->code, 0x48, 0x81, 0xC4);             /* add rsp, imm32 */
+  emit_u32(fc->code, (uint32_t)(8 * (arg_count + 1 + pad)));
+  fc->depth -= arg_count + 1 + pad;
+  return true;
+}
+
+static bool compile_expr(FunctionCompiler *fc, Expr *expr, JitType *type) {
+  switch (expr->type) {
+  case EXPR_LITERAL:
+    switch (expr->as.literal.value.type) {
+    case LITERAL_NUMBER:
+      load_constant(fc, expr->as.literal.value.value.number, false);
+      *type = JT_NUMBER;
+      return true;
+    case LITERAL_INTEGER:
+      load_constant(fc, (double)expr->as.literal.value.value.integer, false);
+      *type = JT_NUMBER;
+      return true;
+    case LITERAL_BOOLEAN:
+      load_constant(fc, expr->as.literal.value.value.boolean ? 1.0 : 0.0, false);
+      *type = JT_BOOLEAN;
+      return true;
+    default:
+      return fail(fc, "string or nil literal");
+    }
+
+  case EXPR_VARIABLE: {
+    JitLocal *local = find_variable(fc, expr->as.variable.name.lexeme);
+    if (!local)
+      return fail(fc, "global or non-numeric variable");
+    load_slot(fc, local->slot);
+    *type = local->type;
+    return true;
+  }
+
+  case EXPR_ASSIGN: {
+    JitLocal *local = find_variable(fc, expr->as.assign.name.lexeme);
+    if (!local)
+      return fail(fc, "assignment to a global or non-numeric variable");
+    size_t slot = local->slot;
+    JitType slot_type = local->type;
+    if (!compile_expr(fc, expr->as.assign.value, type))
+      return false;
+    if (*type != slot_type)
+      return fail(fc, "variable changes type");
+    store_slot(fc, slot);
+    return true;
+  }
+
+  case EXPR_GROUPING:
+    return compile_expr(fc, expr->as.grouping.expression, type);
+
+  case EXPR_UNARY:
+    if (!compile_expr(fc, expr->as.unary.right, type))
+      return false;
+    if (expr->as.unary.op.type == MINUS) {
+      if (*type != JT_NUMBER)
+        return fail(fc, "negated boolean");
+      load_constant(fc, -0.0, true);          /* sign bit */
+      EMIT(fc->code, 0x66, 0x0F, 0x57, 0xC1); /* xorpd xmm0, xmm1 */
+      return true;
+    }
+    if (*type == JT_NUMBER) {
+      load_constant(fc, 0.0, false); /* !number is false */
+    } else {
+      load_constant(fc, 1.0, true);
+      EMIT(fc->code, 0xF2, 0x0F, 0x5C, 0xC8); /* subsd xmm1, xmm0 */
+      EMIT(fc->code, 0x66, 0x0F, 0x28, 0xC1); /* movapd xmm0, xmm1 */
+    }
+    *type = JT_BOOLEAN;
+    return true;
+
+  case EXPR_BINARY:
+    return compile_binary(fc, expr, type);
+
+  case EXPR_LOGICAL: {
+    /* and/or yield one of their operands, so both must have one type */
+    JitType left, right;
+    if (!compile_expr(fc, expr->as.logical.left, &left))
+      return false;
+    bool is_and = expr->as.logical.op.type == AND;
+    if (left == JT_NUMBER) {
+      /* numbers are truthy: `a or b` is a, `a and b` is b */
+      if (!is_and) {
+        *type = JT_NUMBER;
+        return true;
+      }
+      if (!compile_expr(fc, expr->as.logical.right, &right))
+        return false;
+      if (right != JT_NUMBER)
+        return fail(fc, "logical operands of different types");
+      *type = JT_NUMBER;
+      return true;
+    }
+    size_t done = new_label(fc->code);
+    EMIT(fc->code, 0x66, 0x0F, 0x57, 0xC9); /* xorpd xmm1, xmm1 */
+    EMIT(fc->code, 0x66, 0x0F, 0x2E, 0xC1); /* ucomisd xmm0, xmm1 */
+    emit_jump(fc->code, is_and ? JE : JNE, done);
+    if (!compile_expr(fc, expr->as.logical.right, &right))
+      return false;
+    if (right != JT_BOOLEAN)
+      return fail(fc, "logical operands of different types");
+    place_label(fc->code, done);
+    *type = JT_BOOLEAN;
+    return true;
+  }
+
+  case EXPR_CALL:
+    return compile_call(fc, expr, type);
+
+  default:
+    return fail(fc, "list or index expression");
+  }
+}
+
+/* Statements */
+
+static bool compile_stmt(FunctionCompiler *fc, Stmt *stmt);
+
+static bool compile_block(FunctionCompiler *fc, StmtList *statements) {
+  size_t scope = fc->local_count;
+  for (size_t i = 0; i < statements->count; i++) {
+    if (!compile_stmt(fc, statements->statements[i]))
+      return false;
+  }
+  fc->local_count = scope;
+  return true;
+}
+
+/* Whether EXPR calls the function being compiled, by a name that the
+ * interpreter resolves the same way */
+static bool is_self_call(FunctionCompiler *fc, Expr *expr) {
+  if (expr->type != EXPR_CALL || expr->as.call.callee->type != EXPR_VARIABLE)
+    return false;
+  const char *name = expr->as.call.callee->as.variable.name.lexeme;
+  UnitFunction *function = &fc->unit->functions[fc->index];
+  if (find_local(fc, name))
+    return false;
+  Value *callee = lookup_name(function->closure, name);
+  return callee && callee->type == VALUE_FUNCTION &&
+         callee->as.function->declaration == function->declaration &&
+         callee->as.function->closure == function->closure &&
+         expr->as.call.arguments.count == function->declaration->as.function.param_count;
+}
+
+/* `return f(...)` to the function itself: rebinds the parameters and jumps
+ * back to the top, so it runs in constant native stack */
+static bool compile_self_tail_call(FunctionCompiler *fc, Expr *expr) {
+  UnitFunction *function = &fc->unit->functions[fc->index];
+  Unit *unit = fc->unit;
+  const char *name = expr->as.call.callee->as.variable.name.lexeme;
+  unit->deps = realloc(unit->deps, (unit->dep_count + 1) * sizeof(JitDependency));
+  unit->deps[unit->dep_count++] = (JitDependency){
+      function->closure, name, function->declaration, function->closure,
+      function->closure->stamp};
+
+  size_t arg_count = expr->as.call.arguments.count;
+  for (size_t i = 0; i < arg_count; i++) {
+    JitType type;
+    if (!compile_expr(fc, expr->as.call.arguments.expressions[i], &type))
+      return false;
+    if (type != JT_NUMBER)
+      return fail(fc, "boolean argument");
+    push_xmm0(fc);
+  }
+  for (size_t i = arg_count; i > 0; i--) {
+    pop_xmm0(fc);
+    store_slot(fc, i - 1); /* parameters have the first slots */
+  }
+  emit_jump(fc->code, JMP, fc->body_label);
+  return true;
+}
+
+static bool compile_stmt(FunctionCompiler *fc, Stmt *stmt) {
+  JitType type;
+  switch (stmt->type) {
+  case STMT_EXPRESSION:
+    return compile_expr(fc, stmt->as.expression.expression, &type);
+
+  case STMT_VAR:
+    if (!stmt->as.var.initializer)
+      return fail(fc, "variable initialized to nil");
+    if (!compile_expr(fc, stmt->as.var.initializer, &type))
+      return false;
+    store_slot(fc, declare_local(fc, stmt->as.var.name.lexeme, type));
+    return true;
+
+  case STMT_BLOCK:
+    return compile_block(fc, &stmt->as.block.statements);
+
+  case STMT_IF: {
+    size_t otherwise = new_label(fc->code);
+    size_t done = new_label(fc->code);
+    if (!compile_condition(fc, stmt->as.if_stmt.condition, otherwise) ||
+        !compile_stmt(fc, stmt->as.if_stmt.then_branch))
+      return false;
+    emit_jump(fc->code, JMP, done);
+    place_label(fc->code, otherwise);
+    if (stmt->as.if_stmt.else_branch &&
+        !compile_stmt(fc, stmt->as.if_stmt.else_branch))
+      return false;
+    place_label(fc->code, done);
+    return true;
+  }
+
+  case STMT_WHILE: {
+    size_t top = new_label(fc->code);
+    size_t done = new_label(fc->code);
+    place_label(fc->code, top);
+    if (!compile_condition(fc, stmt->as.while_stmt.condition, done) ||
+        !compile_stmt(fc, stmt->as.while_stmt.body))
+      return false;
+    emit_jump(fc->code, JMP, top);
+    place_label(fc->code, done);
+    return true;
+  }
+
+  case STMT_FOR: {
+    /* The initializer's variable outlives the loop, as in the interpreter */
+    if (stmt->as.for_stmt.initializer &&
+        !compile_stmt(fc, stmt->as.for_stmt.initializer))
+      return false;
+    size_t top = new_label(fc->code);
+    size_t done = new_label(fc->code);
+    place_label(fc->code, top);
+    if (stmt->as.for_stmt.condition &&
+        !compile_condition(fc, stmt->as.for_stmt.condition, done))
+      return false;
+    if (!compile_stmt(fc, stmt->as.for_stmt.body))
+      return false;
+    if (stmt->as.for_stmt.increment &&
+        !compile_expr(fc, stmt->as.for_stmt.increment, &type))
+      return false;
+    emit_jump(fc->code, JMP, top);
+    place_label(fc->code, done);
+    return true;
+  }
+
+  case STMT_RETURN: {
+    if (fc->loop_env)
+      return fail(fc, "return from a loop");
+    if (!stmt->as.return_stmt.value)
+      return fail(fc, "return without a value");
+    if (is_self_call(fc, stmt->as.return_stmt.value))
+      return compile_self_tail_call(fc, stmt->as.return_stmt.value);
+    if (!compile_expr(fc, stmt->as.return_stmt.value, &type))
+      return false;
+    UnitFunction *function = &fc->unit->functions[fc->index];
+    if (!function->return_known) {
+      function->return_known = true;
+      function->return_type = type;
+    } else if (function->return_type != type) {
+      return fail(fc, "returns both numbers and booleans");
+    }
+    EMIT(fc->code, 0xF2, 0x0F, 0x11, 0x03); /* movsd [rbx], xmm0 */
+    EMIT(fc->code, 0x31, 0xC0);             /* xor eax, eax */
+    emit_jump(fc->code, JMP, fc->exit_label);
+    return true;
+  }
+
+  case STMT_ASSERT: {
+    /* A failing assert bails out; the interpreter then reports it */
+    size_t failed = new_label(fc->code);
+    size_t done = new_label(fc->code);
+    if (!compile_condition(fc, stmt->as.assert_stmt.condition, failed))
+      return false;
+    emit_jump(fc->code, JMP, done);
+    place_label(fc->code, failed);
+    emit_jump(fc->code, JMP, fc->bail_label);
+    place_label(fc->code, done);
+    return true;
+  }
+
+  default:
+    return fail(fc, "print, import, for-in or nested function");
+  }
+}
+
+/* Runs a loop from its condition, storing the outer variables at the top of
+ * each iteration and when it finishes */
+static bool compile_loop_root(FunctionCompiler *fc, Stmt *loop) {
+  Expr *condition, *increment = NULL;
+  Stmt *body;
+  if (loop->type == STMT_WHILE) {
+    condition = loop->as.while_stmt.condition;
+    body = loop->as.while_stmt.body;
+  } else {
+    condition = loop->as.for_stmt.condition;
+    increment = loop->as.for_stmt.increment;
+    body = loop->as.for_stmt.body;
+  }
+  if (body->type == STMT_VAR)
+    return fail(fc, "loop body declaring a variable outside a block");
+
+  size_t top = new_label(fc->code);
+  size_t done = new_label(fc->code);
+  JitType type;
+  place_label(fc->code, top);
+  emit_call_label(fc->code, fc->commit_label);
+  if (condition && !compile_condition(fc, condition, done))
+    return false;
+  if (!compile_stmt(fc, body))
+    return false;
+  if (increment && !compile_expr(fc, increment, &type))
+    return false;
+  emit_jump(fc->code, JMP, top);
+  place_label(fc->code, done);
+  emit_call_label(fc->code, fc->commit_label);
+  EMIT(fc->code, 0x31, 0xC0); /* xor eax, eax */
+  emit_jump(fc->code, JMP, fc->exit_label);
+  return true;
+}
+
+/* Native signature: int function(double *args, double *result), returning 0
+ * with the result stored, or 1 to bail out. Frame: saved rbp, saved rbx
+ * (holding RESULT), then one slot per local; rsp stays 16-byte aligned
+ * between pushes of pairs of temporaries.
+ *
+ * Loops are called with the outer variables as both ARGS and RESULT. */
+static bool compile_unit_function(Unit *unit, size_t index) {
+  Stmt *declaration = unit->functions[index].declaration;
+  Stmt *loop = unit->functions[index].loop;
+  CodeBuffer code = {0};
+  FunctionCompiler fc = {unit, index, &code, NULL, 0, 0, 0, 0, 0, NULL, NULL, 0, 0, 0};
+  fc.exit_label = new_label(&code);
+  fc.bail_label = new_label(&code);
+
+  EMIT(&code, 0x55);                   /* push rbp */
+  EMIT(&code, 0x48, 0x89, 0xE5);       /* mov rbp, rsp */
+  EMIT(&code, 0x53);                   /* push rbx */
+  EMIT(&code, 0x48, 0x81, 0xEC);       /* sub rsp, imm32 (patched below) */
+  size_t frame_size_offset = code.length;
+  emit_u32(&code, 0);
+  EMIT(&code, 0x48, 0x89, 0xF3);       /* mov rbx, rsi */
+  EMIT(&code, 0x48, 0xB8);             /* mov rax, &jit_depth */
+  emit_u64(&code, (uint64_t)(uintptr_t)&jit_depth);
+  EMIT(&code, 0x48, 0xFF, 0x00);       /* inc qword [rax] */
+  EMIT(&code, 0x48, 0x81, 0x38);       /* cmp qword [rax], imm32 */
+  emit_u32(&code, JIT_MAX_DEPTH);
+  emit_jump(&code, JG, fc.bail_label);
+
+  bool ok;
+  size_t load_label = 0, body_label = 0;
+  if (loop) {
+    /* The outer variables are only known once the loop is compiled */
+    fc.loop_env = unit->functions[index].closure;
+    fc.commit_label = new_label(&code);
+    load_label = new_label(&code);
+    body_label = new_label(&code);
+    emit_jump(&code, JMP, load_label);
+    place_label(&code, body_label);
+    ok = compile_loop_root(&fc, loop);
+  } else {
+    for (size_t i = 0; i < declaration->as.function.param_count; i++) {
+      size_t slot = declare_local(&fc, declaration->as.function.params[i].lexeme, JT_NUMBER);
+      EMIT(&code, 0xF2, 0x0F, 0x10, 0x87); /* movsd xmm0, [rdi+disp32] */
+      emit_u32(&code, (uint32_t)(8 * i));
+      store_slot(&fc, slot);
+    }
+    fc.body_label = new_label(&code);
+    place_label(&code, fc.body_label);
+    ok = compile_block(&fc, &declaration->as.function.body);
+    if (ok && !unit->functions[index].return_known)
+      ok = fail(&fc, "function never returns a value");
+  }
+
+  /* Falling off the end returns nil, which only the interpreter can do */
+  place_label(&code, fc.bail_label);
+  EMIT(&code, 0xB8, 0x01, 0x00, 0x00, 0x00); /* mov eax, 1 */
+  place_label(&code, fc.exit_label);
+  EMIT(&code, 0x48, 0xB9);                   /* mov rcx, &jit_depth */
+  emit_u64(&code, (uint64_t)(uintptr_t)&jit_depth);
+  EMIT(&code, 0x48, 0xFF, 0x09);             /* dec qword [rcx] */
+  EMIT(&code, 0x48, 0x8B, 0x5D, 0xF8);       /* mov rbx, [rbp-8] */
+  EMIT(&code, 0xC9, 0xC3);                   /* leave; ret */
+
+  if (loop) {
+    place_label(&code, load_label);
+    for (size_t i = 0; i < fc.outer_count; i++) {
+      EMIT(&code, 0xF2, 0x0F, 0x10, 0x87); /* movsd xmm0, [rdi+disp32] */
+      emit_u32(&code, (uint32_t)(8 * i));
+      store_slot(&fc, fc.outers[i].slot);
+    }
+    emit_jump(&code, JMP, body_label);
+    place_label(&code, fc.commit_label);
+    for (size_t i = 0; i < fc.outer_count; i++) {
+      load_slot(&fc, fc.outers[i].slot);
+      EMIT(&code, 0xF2, 0x0F, 0x11, 0x83); /* movsd [rbx+disp32], xmm0 */
+      emit_u32(&code, (uint32_t)(8 * i));
+    }
+    EMIT(&code, 0xC3);                     /* ret */
+  }
+
+  uint32_t frame_size = (uint32_t)(8 * (fc.slot_count | 1)); /* odd: aligns rsp */
+  memcpy(code.bytes + frame_size_offset, &frame_size, 4);
+  resolve_jumps(&code);
+  free(fc.locals);
+
+  unit->functions[index].code = code; /* the unit may have been reallocated */
+  if (loop)
+    unit->outers = fc.outers, unit->outer_count = fc.outer_count;
+  return ok;
+}
+
+/* Writes "name (file:line)" of a unit function or loop to OUT */
+static void describe(FILE *out, UnitFunction *function, const char *filename) {
+  if (function->loop)
+    fprintf(out, "loop (%s:%zu)", filename, function->loop->line);
+  else
+    fprintf(out, "%s (%s:%zu)", function->declaration->as.function.name.lexeme,
+            function->declaration->as.function.filename,
+            function->declaration->line);
+}
+
+static void write_perf_map(JitCode *jit, Unit *unit, size_t size,
+                           const char *filename) {
+  if (!perf_map)
+    return;
+  for (size_t i = 0; i < unit->count; i++) {
+    UnitFunction *function = &unit->functions[i];
+    size_t end = i + 1 < unit->count ? unit->functions[i + 1].offset : size;
+    fprintf(perf_map, "%lx %lx ms:",
+            (unsigned long)(uintptr_t)(jit->memory + function->offset),
+            (unsigned long)(end - function->offset));
+    describe(perf_map, function, filename);
+    fputc('\n', perf_map);
+  }
+  fflush(perf_map);
+}
+
+static void free_unit(Unit *unit) {
+  for (size_t i = 0; i < unit->count; i++)
+    free_code_buffer(&unit->functions[i].code);
+  free(unit->functions);
+  free(unit->deps);
+  free(unit->outers);
+}
+
+/* Compiles a function (LOOP NULL) or a loop running in CLOSURE; FILENAME
+ * names the loop's source in diagnostics */
+static JitCode *jit_compile(Stmt *declaration, Stmt *loop, Environment *closure,
+                            const char *filename) {
+  Unit unit = {0};
+  unit.functions = calloc(1, sizeof(UnitFunction));
+  unit.functions[0].declaration = declaration;
+  unit.functions[0].loop = loop;
+  unit.functions[0].closure = closure;
+  unit.count = 1;
+
+  bool ok = compile_unit_function(&unit, 0);
+  for (size_t i = 0; ok && i < unit.count; i++) {
+    if (unit.functions[i].assumed_number && unit.functions[i].return_type != JT_NUMBER) {
+      unit.failure = "recursive function returning a boolean";
+      ok = false;
+    }
+  }
+
+  const char *debug = getenv("MS_JIT_DEBUG");
+  if (debug && strcmp(debug, "0") != 0) {
+    fprintf(stderr, "[JIT] ");
+    describe(stderr, &unit.functions[0], filename);
+    fprintf(stderr, ": %s%s\n", ok ? "compiled" : "not compiled: ",
+            ok ? "" : unit.failure);
+  }
+  if (!ok) {
+    free_unit(&unit);
+    return &jit_unsupported;
+  }
+
+  /* Lay the functions out one after another and link the calls */
+  size_t size = 0;
+  for (size_t i = 0; i < unit.count; i++) {
+    unit.functions[i].offset = size;
+    size += unit.functions[i].code.length;
+  }
+  long page = sysconf(_SC_PAGESIZE);
+  size_t mapped = (size + (size_t)page - 1) & ~((size_t)page - 1);
+  unsigned char *memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    free_unit(&unit);
+    return &jit_unsupported;
+  }
+  for (size_t i = 0; i < unit.count; i++) {
+    CodeBuffer *code = &unit.functions[i].code;
+    size_t base = unit.functions[i].offset;
+    memcpy(memory + base, code->bytes, code->length);
+    for (size_t c = 0; c < code->call_count; c++) {
+      size_t at = base + code->calls[c].offset;
+      int32_t rel = (int32_t)(unit.functions[code->calls[c].target].offset - (at + 4));
+      memcpy(memory + at, &rel, 4);
+    }
+  }
+  if (mprotect(memory, mapped, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, mapped);
+    free_unit(&unit);
+    return &jit_unsupported;
+  }
+
+  JitCode *jit = calloc(1, sizeof(JitCode));
+  jit->memory = memory;
+  jit->size = mapped;
+  jit->entry = (int (*)(double *, double *))(void *)memory;
+  jit->return_type = unit.functions[0].return_type;
+  jit->closure = unit.functions[0].closure;
+  jit->closure_stamp = jit->closure->stamp;
+  jit->deps = unit.deps;
+  jit->dep_count = unit.dep_count;
+  jit->outers = unit.outers;
+  jit->outer_count = unit.outer_count;
+  unit.deps = NULL;
+  unit.outers = NULL;
+  write_perf_map(jit, &unit, size, filename);
+  free_unit(&unit);
+  return jit;
+}
+
+/* Checks that the callees still resolve to what was compiled; ENV stands
+ * in for the loop's own scope */
+static bool dependencies_hold(JitCode *jit, Environment *env) {
+  for (size_t i = 0; i < jit->dep_count; i++) {
+    JitDependency *dep = &jit->deps[i];
+    Value *callee = lookup_name(dep->env ? dep->env : env, dep->name);
+    if (!callee || callee->type != VALUE_FUNCTION ||
+        callee->as.function->declaration != dep->declaration ||
+        callee->as.function->closure != dep->closure ||
+        callee->as.function->closure->stamp != dep->closure_stamp)
+      return false;
+  }
+  return true;
+}
+
+/* After native code could not run, leaves the next 2, 4, ... 65536 entries
+ * to the interpreter, so code that always bails costs little */
+static void back_off(JitCode *jit) {
+  jit->skip = 2u << (jit->bails < 15 ? jit->bails : 15);
+  jit->bails++;
+}
+
+bool jit_call(Value *function, Value **arguments, size_t arg_count,
+              Value **result) {
+  Stmt *declaration = function->as.function->declaration;
+  JitCode *jit = declaration->as.function.jit;
+  if (!jit) {
+    if (++declaration->as.function.hotness < JIT_HOT_THRESHOLD)
+      return false;
+    jit = jit_compile(declaration, NULL, function->as.function->closure, NULL);
+    declaration->as.function.jit = jit;
+  }
+  if (jit == &jit_unsupported || jit->closure != function->as.function->closure ||
+      jit->closure_stamp != function->as.function->closure->stamp)
+    return false;
+  if (jit->skip > 0) {
+    jit->skip--;
+    return false;
+  }
+
+  double args[16];
+  double *values = arg_count <= 16 ? args : malloc(arg_count * sizeof(double));
+  bool entered = false;
+  for (size_t i = 0; i < arg_count; i++) {
+    if (arguments[i]->type != VALUE_NUMBER)
+      goto done;
+    values[i] = arguments[i]->as.number;
+  }
+  if (!dependencies_hold(jit, NULL))
+    goto done;
+
+  double value;
+  if (jit->entry(values, &value) == 0) {
+    *result = value_new(jit->return_type == JT_NUMBER ? VALUE_NUMBER : VALUE_BOOLEAN);
+    if (jit->return_type == JT_NUMBER)
+      (*result)->as.number = value;
+    else
+      (*result)->as.boolean = value != 0.0;
+    entered = true;
+  }
+
+done:
+  if (values != args)
+    free(values);
+  if (!entered)
+    back_off(jit);
+  return entered;
+}
+
+bool jit_loop(Interpreter *interpreter, Stmt *loop) {
+  bool is_while = loop->type == STMT_WHILE;
+  JitCode **code = is_while ? &loop->as.while_stmt.jit : &loop->as.for_stmt.jit;
+  JitCode *jit = *code;
+  if (!jit) {
+    unsigned *hotness = is_while ? &loop->as.while_stmt.hotness
+                                 : &loop->as.for_stmt.hotness;
+    if (++*hotness < JIT_HOT_THRESHOLD)
+      return false;
+    jit = jit_compile(NULL, loop, interpreter->environment,
+                      interpreter->current_filename ? interpreter->current_filename
+                                                    : "<unknown>");
+    *code = jit;
+  }
+  if (jit == &jit_unsupported)
+    return false;
+  if (jit->skip > 0) {
+    jit->skip--;
+    return false;
+  }
+
+  /* Carry the live variables into native slots */
+  Value *live[16];
+  double slots[16];
+  bool small = jit->outer_count <= 16;
+  Value **outers = small ? live : malloc(jit->outer_count * sizeof(Value *));
+  double *vars = small ? slots : malloc(jit->outer_count * sizeof(double));
+  bool finished = false;
+  for (size_t i = 0; i < jit->outer_count; i++) {
+    outers[i] = lookup_name(interpreter->environment, jit->outers[i].name);
+    if (!outers[i])
+      goto done;
+    if (jit->outers[i].type == JT_NUMBER && outers[i]->type == VALUE_NUMBER)
+      vars[i] = outers[i]->as.number;
+    else if (jit->outers[i].type == JT_BOOLEAN && outers[i]->type == VALUE_BOOLEAN)
+      vars[i] = outers[i]->as.boolean ? 1.0 : 0.0;
+    else
+      goto done;
+  }
+  if (!dependencies_hold(jit, interpreter->environment))
+    goto done;
+
+  /* On a bail the variables hold their values from the start of the
+   * iteration that could not finish */
+  finished = jit->entry(vars, vars) == 0;
+  for (size_t i = 0; i < jit->outer_count; i++) {
+    if (outers[i]->type == VALUE_NUMBER)
+      outers[i]->as.number = vars[i];
+    else
+      outers[i]->as.boolean = vars[i] != 0.0;
+  }
+
+done:
+  if (!small) {
+    free(outers);
+    free(vars);
+  }
+  if (!finished)
+    back_off(jit);
+  return finished;
+}
+
+void jit_release(JitCode *jit) {
+  if (!jit || jit == &jit_unsupported)
+    return;
+  munmap(jit->memory, jit->size);
+  free(jit->deps);
+  free(jit->outers);
+  free(jit);
+}
+
+bool jit_open_perf_map(void) {
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/perf-%ld.map", (long)getpid());
+  perf_map = fopen(path, "w");
+  return perf_map != NULL;
+}
+
+bool jit_available(void) {
+  return true;
+}
+
+#else /* no JIT for this platform: everything runs in the interpreter */
+
+bool jit_call(Value *function, Value **arguments, size_t arg_count,
+              Value **result) {
+  (void)function;
+  (void)arguments;
+  (void)arg_count;
+  (void)result;
+  return false;
+}
+
+bool jit_loop(Interpreter *interpreter, Stmt *loop) {
+  (void)interpreter;
+  (void)loop;
+  return false;
+}
+
+void jit_release(JitCode *jit) {
+  (void)jit;
+}
+
+bool jit_open_perf_map(void) {
+  return false;
+}
+
+bool jit_available(void) {
+  return false;
+}
+
+#endif
@@ -17,6 +17,7 @@ static const struct {
                 {"function", FUNCTION},
                 {"if", IF},
                 {"import", IMPORT},
+                {"in", IN},
                 {"int", INT_TYPE},
                 {"list", LIST},
                 {"map", MAP},
@@ -52,15 +53,18 @@ static bool is_alpha(char c) {
 static bool is_alphanumeric(char c) { return is_alpha(c) || is_digit(c); }
 
 static void add_token(Lexer *lexer, MSTokenType type, LiteralValue *literal) {
+  ALLOC_SOURCE_LINE(lexer->line);
   if (lexer->token_count >= lexer->token_capacity) {
     lexer->token_capacity =
         lexer->token_capacity == 0 ? 8 : lexer->token_capacity * 2;
     lexer->tokens =
         realloc(lexer->tokens, lexer->token_capacity * sizeof(Token));
+    ALLOC_TRACK(ALLOC_LEXER, 1, lexer->token_capacity * sizeof(Token));
   }
 
   size_t length = lexer->current - lexer->start;
   char *lexeme = malloc(length + 1);
+  ALLOC_TRACK(ALLOC_LEXER, 1, length + 1);
   strncpy(lexeme, lexer->source + lexer->start, length);
   lexeme[length] = '\0';
 
@@ -107,6 +111,7 @@ static void scan_string(Lexer *lexer) {
   // Trim the surrounding quotes
   size_t length = lexer->current - lexer->start - 2;
   char *value = malloc(length + 1);
+  ALLOC_TRACK(ALLOC_LEXER, 1, length + 1);
   strncpy(value, lexer->source + lexer->start + 1, length);
   value[length] = '\0';
 
@@ -327,6 +332,7 @@ void lexer_scan_tokens(Lexer *lexer) {
 /* Literal value functions */
 LiteralValue *literal_new(LiteralType type) {
   LiteralValue *literal = malloc(sizeof(LiteralValue));
+  ALLOC_TRACK(ALLOC_LEXER, 1, sizeof(LiteralValue));
   literal->type = type;
   memset(&literal->value, 0, sizeof(literal->value));
   literal->owns_string = false;
@@ -1,5 +1,27 @@
 #include "mini_script.h"
 
+/* Command line options */
+static struct {
+  const char *profile_path; /* --profile: folded stacks output, NULL if off */
+  long profile_interval_us;
+  size_t profile_top;
+  const char *instrument; /* --instrument: "table" or "json", NULL if off */
+  const char *instrument_path; /* report file, stderr when NULL */
+  size_t alloc_top;            /* --alloc-profile rows, 0 if off */
+  bool stats;                  /* --stats (MS_STATS builds only) */
+  bool mem_report;             /* --mem-report */
+  const char *trace_path;      /* --trace-events: output file, NULL if off */
+  long trace_threshold_us;
+  const char *line_counts;      /* --line-counts: "list" or "annotate", NULL if off */
+  const char *line_counts_path; /* report file, stderr when NULL */
+  bool no_jit;                  /* --no-jit */
+  bool perf_map;                /* --perf-map */
+  size_t max_depth;             /* --max-depth: nested call limit */
+  const char *emit_c_path;      /* --emit-c: C output file, NULL if off */
+  const char *aot_path;         /* --aot: executable output, NULL if off */
+} options = {NULL, 1000, 20, NULL, NULL, 0, false, false, NULL, 100, NULL, NULL,
+             false, false, MS_DEFAULT_MAX_DEPTH, NULL, NULL};
+
 char *read_file(const char *filename) {
   FILE *file = fopen(filename, "rb");
   if (file == NULL) {
@@ -32,8 +54,14 @@ char *read_file(const char *filename) {
 }
 
 static int run(const char *source, const char *filename) {
+  if (options.alloc_top > 0) {
+    alloc_tracking_start();
+    alloc_source_begin(filename);
+  }
+  uint64_t phase_started = monotonic_ns();
   Lexer *lexer = lexer_new(source);
   lexer_scan_tokens(lexer);
+  trace_span("script", "lex", phase_started, filename);
   const char *debug_tokens = getenv("MS_DEBUG_TOKENS");
   if (debug_tokens && strcmp(debug_tokens, "0") != 0) {
     fprintf(stderr, "[DEBUG] Tokens (count=%zu):\n", lexer->token_count);
@@ -48,9 +76,13 @@ static int run(const char *source, const char *filename) {
     }
   }
 
+  phase_started = monotonic_ns();
   Parser *parser = parser_new(lexer->tokens, lexer->token_count, filename);
   RuntimeError *error = NULL;
   StmtList statements = parser_parse(parser, &error);
+  trace_span("script", "parse", phase_started, filename);
+  if (options.alloc_top > 0)
+    alloc_source_end();
 
   if (error) {
     if (error->line > 0) {
@@ -64,9 +96,86 @@ static int run(const char *source, const char *filename) {
     return 65; // Exit code for parse error
   }
 
+  if (options.emit_c_path || options.aot_path) {
+    bool ok;
+    if (options.aot_path) {
+      ok = aot_build(options.aot_path, filename, statements, options.max_depth);
+    } else {
+      FILE *out = fopen(options.emit_c_path, "w");
+      ok = out && aot_emit_c(out, filename, statements, options.max_depth);
+      if (out)
+        fclose(out);
+      else
+        fprintf(stderr, "Could not write \"%s\".\n", options.emit_c_path);
+    }
+    for (size_t i = 0; i < statements.count; i++)
+      stmt_free(statements.statements[i]);
+    free(statements.statements);
+    parser_free(parser);
+    lexer_free(lexer);
+    return ok ? 0 : 70;
+  }
+
   Interpreter *interpreter = interpreter_new();
+  interpreter_set_max_depth(interpreter, options.max_depth);
   interpreter_set_filename(interpreter, filename);
+  if (options.alloc_top > 0)
+    alloc_tracking_attach(interpreter);
+  bool profiling = options.profile_path &&
+                   profiler_start(interpreter, options.profile_interval_us);
+  if (options.instrument) {
+    interpreter->instrument = true;
+    instrument_start();
+  }
+  interpreter->trace = options.trace_path != NULL;
+  if (options.line_counts)
+    interpreter->line_counts = line_counts_file(filename);
+  /* Compiled calls push no frames, count no lines, allocate no values and
+   * skip the statistics hooks, so tools that observe calls, lines, nodes or
+   * allocations run everything in the interpreter */
+  if (options.no_jit || profiling || options.instrument || options.trace_path ||
+      options.line_counts || options.stats || options.alloc_top > 0 ||
+      options.mem_report)
+    interpreter->jit = false;
+  if (options.perf_map && interpreter->jit && !jit_open_perf_map())
+    fprintf(stderr, "Could not open the perf map file.\n");
+  phase_started = monotonic_ns();
   interpreter_interpret(interpreter, statements, &error);
+  trace_span("script", "execute", phase_started, filename);
+  if (profiling) {
+    profiler_stop();
+    if (profiler_write_folded(options.profile_path))
+      fprintf(stderr, "Profile written to %s\n", options.profile_path);
+    profiler_print_summary(stderr, options.profile_top);
+  }
+  if (options.instrument) {
+    FILE *out = options.instrument_path ? fopen(options.instrument_path, "w") : stderr;
+    if (out) {
+      instrument_report(out, strcmp(options.instrument, "json") == 0);
+      if (out != stderr)
+        fclose(out);
+    } else {
+      fprintf(stderr, "Could not write \"%s\".\n", options.instrument_path);
+    }
+  }
+  if (options.alloc_top > 0)
+    alloc_report(stderr, options.alloc_top);
+#ifdef MS_STATS
+  if (options.stats)
+    stats_report(stderr);
+#endif
+  if (options.mem_report)
+    mem_report(stderr, interpreter);
+  if (options.line_counts) {
+    FILE *out = options.line_counts_path ? fopen(options.line_counts_path, "w") : stderr;
+    if (out) {
+      line_counts_report(out, strcmp(options.line_counts, "annotate") == 0);
+      if (out != stderr)
+        fclose(out);
+    } else {
+      fprintf(stderr, "Could not write \"%s\".\n", options.line_counts_path);
+    }
+  }
 
   int exit_code = 0;
   if (error) {
@@ -93,13 +202,22 @@ static int run(const char *source, const char *filename) {
 }
 
 void run_file(const char *filename) {
+  if (options.trace_path && !trace_start(options.trace_path, filename,
+                                         options.trace_threshold_us))
+    exit(74);
+  uint64_t read_started = monotonic_ns();
   char *source = read_file(filename);
   if (source == NULL) {
+    trace_stop();
     exit(74);
   }
+  trace_span("script", "read", read_started, filename);
 
   int exit_code = run(source, filename);
   free(source);
+  if (options.trace_path)
+    fprintf(stderr, "Trace written to %s (%zu events)\n", options.trace_path,
+            trace_stop());
   
   if (exit_code != 0) {
     exit(exit_code);
@@ -122,12 +240,144 @@ void run_prompt(void) {
   }
 }
 
+static void usage(FILE *out, int exit_code) {
+  fprintf(out,
+          "Usage: mini_script [options] [script]\n"
+          "Options:\n"
+          "  --profile[=FILE]        sample the call stack; write folded stacks\n"
+          "                          to FILE (default profile.folded) and print\n"
+          "                          the hottest functions and lines at exit\n"
+          "  --profile-interval=US   sampling interval in microseconds of CPU\n"
+          "                          time (default 1000)\n"
+          "  --profile-top=N         rows in the profile summary (default 20)\n"
+          "  --instrument[=FORMAT]   count and time every function and builtin\n"
+          "                          call; report as table (default) or json\n"
+          "  --instrument-output=FILE  write the call report to FILE instead\n"
+          "                          of stderr\n"
+          "  --alloc-profile[=N]     count allocations per interpreter site and\n"
+          "                          source line; print the top N (default 30)\n"
+          "  --stats                 print node-type, builtin, lookup-depth and\n"
+          "                          copy-size histograms at exit (needs a\n"
+          "                          build with `make stats`)\n"
+          "  --mem-report            print live values, environments, open\n"
+          "                          files, reachable string/list bytes and\n"
+          "                          RSS at exit\n"
+          "  --trace-events FILE     write a Chrome/Perfetto trace of script and\n"
+          "                          import phases, file I/O builtins and slow\n"
+          "                          function calls to FILE\n"
+          "  --trace-threshold=US    shortest function call traced, in\n"
+          "                          microseconds (default 100; 0 traces all)\n"
+          "  --line-counts[=FORMAT]  count statements executed per source line;\n"
+          "                          report as file:line count pairs (list,\n"
+          "                          default) or an annotated listing\n"
+          "                          (annotate)\n"
+          "  --line-counts-output=FILE  write the line counts to FILE instead\n"
+          "                          of stderr\n"
+          "  --no-jit                run every function in the interpreter\n"
+          "                          (also MS_JIT=0)\n"
+          "  --perf-map              list JIT-compiled functions in\n"
+          "                          /tmp/perf-<pid>.map for perf(1)\n"
+          "  --max-depth=N           allow N nested calls before a stack\n"
+          "                          overflow error (default 100000)\n"
+          "  --emit-c=FILE           translate the script and its imports to C\n"
+          "                          in FILE instead of running it\n"
+          "  --aot=OUTPUT            compile the script to the executable OUTPUT\n"
+          "                          (needs a C compiler and libminiscript.a)\n"
+          "  --help                  show this message\n");
+  exit(exit_code);
+}
+
 int main(int argc, char *argv[]) {
-  if (argc > 2) {
-    fprintf(stderr, "Usage: mini_script [script]\n");
-    exit(64);
-  } else if (argc == 2) {
-    run_file(argv[1]);
+  const char *script = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--help") == 0) {
+      usage(stdout, 0);
+    } else if (strcmp(arg, "--profile") == 0) {
+      options.profile_path = "profile.folded";
+    } else if (strncmp(arg, "--profile=", 10) == 0 && arg[10] != '\0') {
+      options.profile_path = arg + 10;
+    } else if (strncmp(arg, "--profile-interval=", 19) == 0) {
+      options.profile_interval_us = strtol(arg + 19, NULL, 10);
+      if (options.profile_interval_us <= 0)
+        usage(stderr, 64);
+    } else if (strncmp(arg, "--profile-top=", 14) == 0) {
+      options.profile_top = strtoul(arg + 14, NULL, 10);
+    } else if (strcmp(arg, "--instrument") == 0) {
+      options.instrument = "table";
+    } else if (strncmp(arg, "--instrument=", 13) == 0) {
+      options.instrument = arg + 13;
+      if (strcmp(options.instrument, "table") != 0 &&
+          strcmp(options.instrument, "json") != 0)
+        usage(stderr, 64);
+    } else if (strncmp(arg, "--instrument-output=", 20) == 0) {
+      options.instrument_path = arg + 20;
+    } else if (strcmp(arg, "--alloc-profile") == 0) {
+      options.alloc_top = 30;
+    } else if (strncmp(arg, "--alloc-profile=", 16) == 0) {
+      options.alloc_top = strtoul(arg + 16, NULL, 10);
+      if (options.alloc_top == 0)
+        usage(stderr, 64);
+    } else if (strcmp(arg, "--stats") == 0) {
+#ifdef MS_STATS
+      options.stats = true;
+#else
+      fprintf(stderr, "--stats is not compiled in; rebuild with `make stats`.\n");
+      exit(64);
+#endif
+    } else if (strcmp(arg, "--mem-report") == 0) {
+      options.mem_report = true;
+    } else if (strcmp(arg, "--trace-events") == 0) {
+      if (++i == argc)
+        usage(stderr, 64);
+      options.trace_path = argv[i];
+    } else if (strncmp(arg, "--trace-events=", 15) == 0 && arg[15] != '\0') {
+      options.trace_path = arg + 15;
+    } else if (strncmp(arg, "--trace-threshold=", 18) == 0) {
+      char *end;
+      options.trace_threshold_us = strtol(arg + 18, &end, 10);
+      if (end == arg + 18 || *end != '\0' || options.trace_threshold_us < 0)
+        usage(stderr, 64);
+    } else if (strcmp(arg, "--line-counts") == 0) {
+      options.line_counts = "list";
+    } else if (strncmp(arg, "--line-counts=", 14) == 0) {
+      options.line_counts = arg + 14;
+      if (strcmp(options.line_counts, "list") != 0 &&
+          strcmp(options.line_counts, "annotate") != 0)
+        usage(stderr, 64);
+    } else if (strncmp(arg, "--line-counts-output=", 21) == 0) {
+      options.line_counts_path = arg + 21;
+    } else if (strcmp(arg, "--no-jit") == 0) {
+      options.no_jit = true;
+    } else if (strcmp(arg, "--perf-map") == 0) {
+      options.perf_map = true;
+    } else if (strncmp(arg, "--emit-c=", 9) == 0 && arg[9] != '\0') {
+      options.emit_c_path = arg + 9;
+    } else if (strncmp(arg, "--aot=", 6) == 0 && arg[6] != '\0') {
+      options.aot_path = arg + 6;
+    } else if (strncmp(arg, "--max-depth=", 12) == 0) {
+      char *end;
+      options.max_depth = strtoul(arg + 12, &end, 10);
+      if (end == arg + 12 || *end != '\0' || options.max_depth == 0)
+        usage(stderr, 64);
+    } else if (arg[0] == '-' && arg[1] == '-') {
+      fprintf(stderr, "Unknown option: %s\n", arg);
+      usage(stderr, 64);
+    } else if (script == NULL) {
+      script = arg;
+    } else {
+      usage(stderr, 64);
+    }
+  }
+
+  if (script) {
+    run_file(script);
+  } else if (options.profile_path || options.instrument || options.alloc_top > 0 ||
+             options.stats || options.mem_report || options.trace_path ||
+             options.line_counts) {
+    fprintf(stderr, "Profiling options require a script.\n");
+    usage(stderr, 64);
   } else {
     run_prompt();
   }
@@ -2,6 +2,7 @@
 #define MINI_SCRIPT_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,6 +16,12 @@ typedef struct Expr Expr;
 typedef struct Environment Environment;
 typedef struct Interpreter Interpreter;
 typedef struct RuntimeError RuntimeError;
+typedef struct JitCode JitCode;
+
+/* Ahead-of-time compiled code (aot.c) for a function body or a script's
+ * top level. Returns the function's result, or NULL if it fell off the end
+ * or failed with *ERROR set. */
+typedef Value *(*NativeCode)(Interpreter *interpreter, RuntimeError **error);
 
 /* Token types */
 typedef enum {
@@ -76,6 +83,7 @@ typedef enum {
   ASSERT,
   VAR,
   NIL,
+  IN,
 
   EOF_TOKEN
 } MSTokenType;
@@ -119,18 +127,74 @@ typedef enum {
   VALUE_LIST,
   VALUE_FUNCTION,
   VALUE_BUILTIN,
-  VALUE_FILE_HANDLE
+  VALUE_FILE_HANDLE,
+  VALUE_BYTES,
+  VALUE_RANGE,
+  VALUE_SET,
+  VALUE_DEQUE,
+  VALUE_HEAP
 } ValueType;
 
+/* Arithmetic sequence made by range(): START, START + STEP, ... up to but
+ * excluding STOP. Elements are computed as they are needed, never stored. */
+typedef struct RangeValue {
+  double start;
+  double stop;
+  double step; /* nonzero */
+} RangeValue;
+
+/* List storage. Shared between copies of a Value (reference counted), like
+ * byte buffers, so copying a list is O(1) and element writes and sorts are
+ * visible through every handle. */
 typedef struct ValueList {
   Value *elements;
   size_t count;
   size_t capacity;
+  size_t refcount;
 } ValueList;
 
+/* Hash set of numbers, strings, booleans and nil. Shared between copies of a
+ * Value (reference counted) like lists. Elements are stored densely in
+ * insertion order (removing one moves the last into its place) next to
+ * their hashes; SLOTS is an open-addressing index into them holding
+ * element index + 1, or 0 for an empty slot. */
+typedef struct ValueSet {
+  Value *elements;
+  uint64_t *hashes;
+  size_t count;
+  size_t capacity;
+  size_t *slots;
+  size_t slot_mask; /* slot count - 1, a power of two */
+  size_t refcount;
+} ValueSet;
+
+/* Double-ended queue on a ring buffer: element I is stored at
+ * (HEAD + I) & (CAPACITY - 1). Shared between copies of a Value (reference
+ * counted) like lists. */
+typedef struct ValueDeque {
+  Value *elements;
+  size_t head;
+  size_t count;
+  size_t capacity; /* a power of two */
+  size_t refcount;
+} ValueDeque;
+
+typedef struct ValueHeap ValueHeap;
+
+/* Mutable, length-tracked byte buffer. Shared between copies of a Value
+ * (reference counted) so that writes through one handle are visible to all. */
+typedef struct ByteBuffer {
+  unsigned char *data;
+  size_t length;
+  size_t capacity;
+  size_t refcount;
+} ByteBuffer;
+
 typedef struct MiniScriptFunction {
   Stmt *declaration;
   Environment *closure;
+  bool owns_closure; /* holds a reference on CLOSURE; false while stored in
+                        a variable of CLOSURE itself (see environment_adopt) */
 } MiniScriptFunction;
 
 struct Value {
@@ -143,9 +207,44 @@ struct Value {
     MiniScriptFunction *function;
     char *builtin_name;
     FILE *file_handle;
+    ByteBuffer *bytes;
+    RangeValue *range;
+    ValueSet *set;
+    ValueDeque *deque;
+    ValueHeap *heap;
   } as;
 };
 
+/* Priority queue: a 4-ary min-heap on contiguous storage, ordered by KEY
+ * and then by ORDER, so entries with equal keys leave in the order the
+ * caller numbered them. Keys are all numbers (not NaN) or all strings.
+ * Shared between copies of a Value (reference counted) like lists. */
+typedef struct HeapEntry {
+  Value key; /* VALUE_NIL: the element is its own key */
+  Value element;
+  uint64_t order;
+} HeapEntry;
+
+struct ValueHeap {
+  HeapEntry *entries;
+  size_t count;
+  size_t capacity;
+  Value *key_fn; /* called on each pushed element, or NULL */
+  uint64_t pushes;
+  size_t refcount;
+};
+
+/* Inline cache of one variable reference: the environment (by stamp) and
+ * index the name was last found at, and the name's bit in
+ * Environment.names, which lets lookups skip scopes without comparing keys,
+ * and its hash, which probes the key index of large scopes */
+typedef struct LookupCache {
+  uint64_t stamp; /* 0 when empty */
+  size_t index;
+  uint64_t bit;   /* 0 until first used */
+  uint32_t hash;
+} LookupCache;
+
 /* Statement types */
 typedef enum {
   STMT_BLOCK,
@@ -158,7 +257,8 @@ typedef enum {
   STMT_WHILE,
   STMT_IMPORT,
   STMT_ASSERT,
-  STMT_VAR
+  STMT_VAR,
+  STMT_FOR_IN
 } StmtType;
 
 typedef struct StmtList {
@@ -169,6 +269,7 @@ typedef struct StmtList {
 
 struct Stmt {
   StmtType type;
+  size_t line; /* line of the statement's first token */
   union {
     struct {
       StmtList statements;
@@ -186,12 +287,18 @@ struct Stmt {
       Token *params;
       size_t param_count;
       StmtList body;
+      char *filename; /* source file of the declaration */
+      unsigned hotness; /* calls plus loop iterations, until compiled */
+      JitCode *jit;     /* native code (jit.c), NULL until hot */
+      NativeCode native; /* compiled body (aot.c), run instead of BODY */
     } function;
     struct {
       Stmt *initializer;
       Expr *condition;
       Expr *increment;
       Stmt *body;
+      unsigned hotness; /* iterations, until compiled */
+      JitCode *jit;     /* native loop (jit.c), NULL until hot */
     } for_stmt;
     struct {
       Expr *condition;
@@ -205,6 +312,8 @@ struct Stmt {
     struct {
       Expr *condition;
       Stmt *body;
+      unsigned hotness;
+      JitCode *jit;
     } while_stmt;
     struct {
       Token path_token;
@@ -219,9 +328,24 @@ struct Stmt {
       Token name;
       Expr *initializer;
     } var;
+    struct {
+      Token name;        /* the loop variable */
+      bool declare;      /* `var NAME`: a new variable in the current scope */
+      Expr *iterable;    /* a list, string, bytes or range */
+      Stmt *body;
+      LookupCache cache; /* of NAME, rebound every iteration */
+    } for_in;
   } as;
 };
 
+/* Type feedback of a binary operation site: decided on its first
+ * execution, and dropped for good once an operand breaks it */
+typedef enum {
+  QUICK_UNSEEN,
+  QUICK_NUMBER, /* both operands numbers: runs unboxed */
+  QUICK_GENERIC
+} QuickState;
+
 /* Expression types */
 typedef enum {
   EXPR_ASSIGN,
@@ -249,11 +373,13 @@ struct Expr {
     struct {
       Token name;
       Expr *value;
+      LookupCache cache;
     } assign;
     struct {
       Expr *left;
       Token op;
       Expr *right;
+      QuickState quick;
     } binary;
     struct {
       Expr *callee;
@@ -289,21 +415,32 @@ struct Expr {
     } unary;
     struct {
       Token name;
+      LookupCache cache;
     } variable;
   } as;
 };
 
-/* Environment for variable storage */
+/* Environment for variable storage. Keys are only ever appended, so a
+ * name keeps its index for the life of the environment. */
 struct Environment {
   struct {
     char **keys;
     Value **values; /* Owned Value* objects */
     size_t count;
     size_t capacity;
+    size_t *index;      /* open-addressing table of key positions + 1, 0 if
+                           empty; NULL until the scope outgrows a scan */
+    size_t index_size;  /* a power of two, at least twice COUNT */
   } values;
   Environment *enclosing;
+  uint64_t stamp; /* identifies this environment in lookup caches; never reused */
+  uint64_t names; /* union of the name bits of the keys; all ones from
+                     about 200 keys on, so large scopes rely on the index */
+  size_t refcount; /* the running scope, enclosed scopes and closures; not
+                      counted for the global scope, which has no ENCLOSING */
 };
 
+
 /* Runtime error */
 struct RuntimeError {
   char *message;
@@ -312,14 +449,70 @@ struct RuntimeError {
   Value *return_value;
 };
 
+/* Per-line statement execution counters for one source file (--line-counts),
+ * indexed directly by line number */
+typedef struct LineCounts {
+  char *filename;
+  uint64_t *counts;
+  size_t capacity; /* lines 0 .. capacity-1 have counters */
+} LineCounts;
+
+/* Call stack entry: one per active MiniScript function call or module
+ * import, with frame 0 for the script's top level. The strings are owned by
+ * the declaring statements or the interpreter, so they stay valid until the
+ * interpreter is freed. Read asynchronously by the sampling profiler.
+ *
+ * The frames are one contiguous array of max_depth + 1 entries, allocated
+ * up front (untouched pages cost nothing) so that it never moves under the
+ * profiler; a call beyond max_depth is a "Stack overflow" runtime error. */
+#define MS_DEFAULT_MAX_DEPTH 100000
+
+typedef struct CallFrame {
+  const char *function;
+  const char *filename;
+  size_t line; /* line currently executing in this frame */
+} CallFrame;
+
+/* A call in tail position (`return f(...);`), handed back to the frame of
+ * the function returning so that the call reuses it */
+typedef struct TailCall {
+  bool pending;
+  MiniScriptFunction function;
+  Value **arguments; /* owned */
+  size_t arg_count;
+  size_t line;
+} TailCall;
+
+/* What interpreter_enter_module saves of the importing file */
+typedef struct ModuleScope {
+  char *filename;
+  LineCounts *line_counts;
+  Stmt *function;
+} ModuleScope;
+
 /* Interpreter */
 struct Interpreter {
   Environment *globals;
   Environment *environment;
-  char **modules_path;
+  char **modules_path;    // Paths of the script and loaded modules
   size_t modules_path_count;
   Value *return_value;  // For function return values
   char *current_filename; // Current source filename for error reporting
+  StmtList imported;      // Statements of imported modules (kept alive for their functions)
+  bool debug_trace;       // Per-statement trace, enabled by MS_DEBUG_TRACE
+  volatile CallFrame *frames; // max_depth + 1 entries
+  volatile size_t frame_count;
+  size_t max_depth;       // Nested calls and imports allowed (--max-depth)
+  uintptr_t stack_limit;  // Lowest safe native stack address, 0 if unknown
+  bool on_script_stack;   // Running on the stack made by interpreter_interpret
+  bool instrument;        // Count and time every call (--instrument)
+  bool trace;             // Record trace events (--trace-events)
+  LineCounts *line_counts; // Counters of the file executing (--line-counts), NULL if off
+  bool jit;               // Compile hot functions (off with --no-jit or MS_JIT=0)
+  Stmt *current_function; // Declaration of the function executing, NULL at top level
+  bool tail_position;     // The call being evaluated is the value of a return
+  TailCall tail_call;
+  RuntimeError *builtin_error; // Error of a function a builtin called, reported for the builtin
 };
 
 /* Function prototypes */
@@ -327,8 +520,54 @@ struct Interpreter {
 /* Memory management */
 Value *value_new(ValueType type);
 void value_free(Value *value);
+void value_dispose_inline(Value *value);
 Value *value_copy(Value *value);
 
+/* Range functions */
+size_t range_length(const RangeValue *range);
+double range_at(const RangeValue *range, size_t index);
+
+/* List storage functions */
+ValueList *value_list_new(size_t capacity);
+void value_list_release(ValueList *list);
+void value_list_push(ValueList *list, Value *element);
+
+/* Set functions. Only numbers, strings, booleans and nil are hashable. */
+uint64_t value_hash(const Value *value);
+bool value_hashable(const Value *value);
+ValueSet *value_set_new(size_t capacity);
+void value_set_release(ValueSet *set);
+bool value_set_has(const ValueSet *set, const Value *value);
+bool value_set_add(ValueSet *set, const Value *value);
+bool value_set_remove(ValueSet *set, const Value *value);
+
+/* Deque functions. Pushes move ELEMENT in, freeing the emptied Value; pops
+ * return a new Value, or NULL when the deque is empty. */
+ValueDeque *value_deque_new(size_t capacity);
+void value_deque_release(ValueDeque *deque);
+Value *value_deque_at(ValueDeque *deque, size_t index);
+void value_deque_push_back(ValueDeque *deque, Value *element);
+void value_deque_push_front(ValueDeque *deque, Value *element);
+Value *value_deque_pop_back(ValueDeque *deque);
+Value *value_deque_pop_front(ValueDeque *deque);
+
+/* Heap functions. Pushes move KEY (NULL when ELEMENT is its own key) and
+ * ELEMENT in, freeing the emptied Values, and return false, taking neither,
+ * when the key cannot be ordered against the others. */
+ValueHeap *value_heap_new(Value *key_fn);
+void value_heap_release(ValueHeap *heap);
+int value_key_compare(const Value *a, const Value *b);
+const Value *value_heap_top_key(const ValueHeap *heap);
+bool value_heap_push(ValueHeap *heap, Value *key, Value *element, uint64_t order);
+bool value_heap_replace_top(ValueHeap *heap, Value *key, Value *element, uint64_t order);
+Value *value_heap_pop(ValueHeap *heap);
+
+/* Byte buffer functions */
+ByteBuffer *byte_buffer_new(size_t length);
+void byte_buffer_release(ByteBuffer *buffer);
+void byte_buffer_append(ByteBuffer *buffer, const unsigned char *data,
+                        size_t length);
+
 /* Token functions */
 Token *token_new(MSTokenType type, const char *lexeme, LiteralValue *literal,
                  size_t line);
@@ -353,17 +592,261 @@ void environment_define(Environment *env, const char *name, Value *value);
 Value *environment_get(Environment *env, Token *name, RuntimeError **error, const char *filename);
 void environment_assign(Environment *env, Token *name, Value *value,
                         RuntimeError **error, const char *filename);
+Value **environment_lookup(Environment *env, const char *name, LookupCache *cache);
+void environment_reset(Environment *env, Environment *enclosing);
+void environment_retain(Environment *env);
+void environment_release(Environment *env);
+void environment_adopt(Value **slot, Value *value);
 
 /* Interpreter functions */
 Interpreter *interpreter_new(void);
 void interpreter_free(Interpreter *interpreter);
 void interpreter_set_filename(Interpreter *interpreter, const char *filename);
+void interpreter_set_max_depth(Interpreter *interpreter, size_t max_depth);
 void interpreter_interpret(Interpreter *interpreter, StmtList statements,
                            RuntimeError **error);
 Value *interpreter_evaluate(Interpreter *interpreter, Expr *expr,
                             RuntimeError **error);
 void interpreter_execute(Interpreter *interpreter, Stmt *stmt,
                          RuntimeError **error);
+Value *interpreter_call_builtin(Interpreter *interpreter, const char *name,
+                                Value **args, int arg_count);
+Value *interpreter_call_function(Interpreter *interpreter, Value *function,
+                                 Value **arguments, size_t arg_count,
+                                 size_t line, RuntimeError **error);
+
+/* Operations shared by the tree walker and compiled code (aot.c) */
+Value *interpreter_binary(Interpreter *interpreter, MSTokenType op, size_t line,
+                          Value *left, Value *right, RuntimeError **error);
+Value *interpreter_get_index(Interpreter *interpreter, Value *object,
+                             Value *index, RuntimeError **error);
+Value *interpreter_set_index(Interpreter *interpreter, Value *object,
+                             Value *index, Value *value, RuntimeError **error);
+Value *interpreter_call_value(Interpreter *interpreter, Value *callee,
+                              Value **arguments, size_t arg_count, size_t line,
+                              bool tail, RuntimeError **error);
+void interpreter_define_function(Interpreter *interpreter, Stmt *declaration);
+bool interpreter_enter_module(Interpreter *interpreter, const char *path,
+                              size_t line, ModuleScope *scope,
+                              RuntimeError **error);
+void interpreter_leave_module(Interpreter *interpreter, ModuleScope *scope);
+void interpreter_run_native(Interpreter *interpreter, NativeCode native,
+                            RuntimeError **error);
+
+/* A for-in loop in progress. interpreter_for_in_begin takes ITERABLE and
+ * fails unless it can be iterated; interpreter_for_in_next binds the next
+ * element to NAME, returning false when there is none; and
+ * interpreter_for_in_end releases the iterable. */
+typedef struct ForIn {
+  Value *iterable;
+  size_t index;
+  size_t length; /* of strings and ranges; lists and bytes may change */
+} ForIn;
+bool interpreter_for_in_begin(Interpreter *interpreter, ForIn *loop,
+                              Value *iterable, size_t line,
+                              RuntimeError **error);
+bool interpreter_for_in_next(Interpreter *interpreter, ForIn *loop,
+                             const char *name, LookupCache *cache);
+void interpreter_for_in_end(ForIn *loop);
+
+/* Ahead-of-time compilation (aot.c). aot_emit_c writes SCRIPT, parsed into
+ * STATEMENTS, and the modules it imports as one C program; aot_build also
+ * compiles it to the executable OUTPUT against libminiscript.a. */
+bool aot_emit_c(FILE *out, const char *script, StmtList statements,
+                size_t max_depth);
+bool aot_build(const char *output, const char *script, StmtList statements,
+               size_t max_depth);
+/* Runtime support called by the generated code */
+int aot_main(const char *filename, NativeCode main, size_t max_depth);
+Value *aot_number(double number);
+Value *aot_boolean(bool boolean);
+Value *aot_string(const char *string);
+Value *aot_list(size_t capacity);
+void aot_print(Value *value, bool last);
+void aot_leave_scope(Interpreter *interpreter, Environment *previous);
+void aot_error(Interpreter *interpreter, const char *message, size_t line,
+               RuntimeError **error);
+void aot_undefined(Interpreter *interpreter, const char *name, size_t line,
+                   RuntimeError **error);
+void aot_assert_failed(Interpreter *interpreter, Value *message, size_t line,
+                       RuntimeError **error);
+
+/* Sorting (sort.c), in place: all numbers ascending or all strings in byte
+ * order; false if the values (or KEYS) are mixed or of another type.
+ * sort_values_by orders ELEMENTS by the parallel array KEYS, stably. */
+bool sort_values(Value *elements, size_t count);
+bool sort_values_by(Value *elements, Value *keys, size_t count);
+
+/* Baseline JIT (jit.c). jit_call counts the call toward FUNCTION's hotness
+ * and, once it is compiled, runs the native code; it returns false when the
+ * interpreter has to run the call instead. */
+bool jit_call(Value *function, Value **arguments, size_t arg_count,
+              Value **result);
+/* Counts an iteration of LOOP (a while or for statement about to test its
+ * condition again) and, once it is compiled, runs the rest of the loop
+ * natively; returns true when the loop has finished */
+bool jit_loop(Interpreter *interpreter, Stmt *loop);
+void jit_release(JitCode *jit);
+bool jit_open_perf_map(void); /* /tmp/perf-<pid>.map for perf(1) */
+bool jit_available(void);
+
+/* Nanoseconds from CLOCK_MONOTONIC (profiler.c) */
+uint64_t monotonic_ns(void);
+
+/* Sampling profiler (profiler.c) */
+bool profiler_start(Interpreter *interpreter, long interval_us);
+void profiler_stop(void);
+bool profiler_write_folded(const char *path);
+void profiler_print_summary(FILE *out, size_t top_n);
+
+/* Deterministic call instrumentation (profiler.c) */
+void instrument_start(void);
+void instrument_enter_function(Stmt *declaration);
+void instrument_enter_builtin(const char *name);
+void instrument_exit(void);
+void instrument_report(FILE *out, bool json);
+
+/* Chrome trace-event output (profiler.c). Spans are recorded when they end;
+ * START_NS comes from monotonic_ns() when the span began. */
+bool trace_start(const char *path, const char *script, long threshold_us);
+void trace_span(const char *category, const char *name, uint64_t start_ns,
+                const char *path);
+void trace_call(Stmt *declaration, uint64_t start_ns);
+void trace_builtin(const char *name, Value **args, int arg_count,
+                   uint64_t start_ns, const char *file, size_t line);
+size_t trace_stop(void);
+
+/* Allocation tracking (stats.c). Sites report through ALLOC_TRACK, which
+ * only tests a flag unless --alloc-profile is on. */
+typedef enum {
+  ALLOC_VALUE_NEW,
+  ALLOC_VALUE_COPY,
+  ALLOC_STRDUP,
+  ALLOC_ENVIRONMENT,
+  ALLOC_ENV_KEY,
+  ALLOC_CALL_ARGS,
+  ALLOC_LEXER,
+  ALLOC_PARSER,
+  ALLOC_SITE_COUNT
+} AllocSite;
+
+extern bool alloc_tracking;
+extern size_t alloc_source_line; /* line reached by the lexer or parser */
+
+#define ALLOC_TRACK(site, count, bytes)                                        \
+  do {                                                                         \
+    if (alloc_tracking)                                                        \
+      alloc_record((site), (count), (bytes));                                  \
+  } while (0)
+#define ALLOC_SOURCE_LINE(line)                                                \
+  do {                                                                         \
+    if (alloc_tracking)                                                        \
+      alloc_source_line = (line);                                              \
+  } while (0)
+
+void alloc_tracking_start(void);
+void alloc_tracking_attach(Interpreter *interpreter);
+void alloc_source_begin(const char *filename);
+void alloc_source_end(void);
+void alloc_record(AllocSite site, size_t count, size_t bytes);
+void alloc_report(FILE *out, size_t top_n);
+
+/* Memory statistics (stats.c): live counters kept by value.c,
+ * environment.c and the file builtins, plus a walk of the data reachable
+ * from the current scope. Read by mem_stats() and --mem-report. */
+typedef struct {
+  size_t values;       /* heap Value objects allocated and not yet freed */
+  size_t environments; /* environments allocated and not yet freed */
+  size_t open_files;   /* handles opened by fopen() and not closed */
+} MemCounters;
+
+extern MemCounters mem_counters;
+
+typedef struct {
+  size_t values;
+  size_t reachable_values; /* including list elements */
+  size_t string_bytes;
+  size_t list_bytes;
+  size_t set_bytes;
+  size_t buffer_bytes;
+  size_t environments;
+  size_t environment_depth;
+  size_t open_files;
+  size_t rss_kb;
+  size_t peak_rss_kb;
+} MemStats;
+
+void mem_stats_collect(Interpreter *interpreter, MemStats *stats);
+size_t mem_stats_field_count(void);
+const char *mem_stats_field_name(size_t index);
+size_t mem_stats_field(const MemStats *stats, size_t index);
+void mem_report(FILE *out, Interpreter *interpreter);
+
+/* USDT probes for external tracers (perf, bpftrace, SystemTap), compiled in
+ * only with -DMS_USDT (`make usdt`, needs <sys/sdt.h>). Each probe is a
+ * single nop until a tracer attaches. Provider "mini_script":
+ *   function__entry/function__return (name, file, line of the declaration)
+ *   builtin__entry/builtin__return   (name, file, line of the call)
+ *   import__start/import__done       (module path)
+ */
+#ifdef MS_USDT
+#include <sys/sdt.h>
+#define PROBE_FUNCTION_ENTRY(name, file, line)                                 \
+  DTRACE_PROBE3(mini_script, function__entry, name, file, line)
+#define PROBE_FUNCTION_RETURN(name, file, line)                                \
+  DTRACE_PROBE3(mini_script, function__return, name, file, line)
+#define PROBE_BUILTIN_ENTRY(name, file, line)                                  \
+  DTRACE_PROBE3(mini_script, builtin__entry, name, file, line)
+#define PROBE_BUILTIN_RETURN(name, file, line)                                 \
+  DTRACE_PROBE3(mini_script, builtin__return, name, file, line)
+#define PROBE_IMPORT_START(path) DTRACE_PROBE1(mini_script, import__start, path)
+#define PROBE_IMPORT_DONE(path) DTRACE_PROBE1(mini_script, import__done, path)
+#else
+#define PROBE_FUNCTION_ENTRY(name, file, line) ((void)0)
+#define PROBE_FUNCTION_RETURN(name, file, line) ((void)0)
+#define PROBE_BUILTIN_ENTRY(name, file, line) ((void)0)
+#define PROBE_BUILTIN_RETURN(name, file, line) ((void)0)
+#define PROBE_IMPORT_START(path) ((void)0)
+#define PROBE_IMPORT_DONE(path) ((void)0)
+#endif
+
+/* Line execution counts (stats.c). LINE_COUNT is the per-statement hook:
+ * two tests and one increment while on, one test while off. Line 0 is not a
+ * source line (a statement the parser did not stamp) and is not counted. */
+#define LINE_COUNT(lines, line)                                                \
+  do {                                                                         \
+    if ((lines) && (line) > 0) {                                               \
+      if ((line) < (lines)->capacity)                                          \
+        (lines)->counts[(line)]++;                                             \
+      else                                                                     \
+        line_counts_grow((lines), (line));                                     \
+    }                                                                          \
+  } while (0)
+
+LineCounts *line_counts_file(const char *filename);
+void line_counts_grow(LineCounts *lines, size_t line);
+void line_counts_report(FILE *out, bool annotate);
+
+/* Execution statistics (stats.c), compiled in only with -DMS_STATS */
+#ifdef MS_STATS
+#define STATS_STMT(type) stats_count_stmt(type)
+#define STATS_EXPR(type) stats_count_expr(type)
+#define STATS_BUILTIN(name) stats_count_builtin(name)
+#define STATS_LOOKUP(depth, found) stats_count_lookup((depth), (found))
+#define STATS_COPY(bytes) stats_count_copy(bytes)
+void stats_count_stmt(StmtType type);
+void stats_count_expr(ExprType type);
+void stats_count_builtin(const char *name);
+void stats_count_lookup(size_t depth, bool found);
+void stats_count_copy(size_t bytes);
+void stats_report(FILE *out);
+#else
+#define STATS_STMT(type) ((void)0)
+#define STATS_EXPR(type) ((void)0)
+#define STATS_BUILTIN(name) ((void)0)
+#define STATS_LOOKUP(depth, found) ((void)0)
+#define STATS_COPY(bytes) ((void)0)
+#endif
 
 /* Lexer functions */
 typedef struct {
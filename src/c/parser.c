@@ -9,6 +9,7 @@ static char *ms_strdup(const char *s) {
   char *copy = malloc(len + 1);
   if (!copy)
     return NULL;
+  ALLOC_TRACK(ALLOC_STRDUP, 1, len + 1);
   memcpy(copy, s, len + 1);
   return copy;
 }
@@ -31,6 +32,12 @@ static bool is_at_end(Parser *parser) {
          parser->tokens[parser->current].type == EOF_TOKEN;
 }
 
+static size_t current_line(Parser *parser) {
+  if (parser->current < parser->count)
+    return parser->tokens[parser->current].line;
+  return parser->count > 0 ? parser->tokens[parser->count - 1].line : 0;
+}
+
 static Token *previous(Parser *parser) {
   return &parser->tokens[parser->current - 1];
 }
@@ -747,11 +754,47 @@ static Stmt *while_statement(Parser *parser, RuntimeError **error) {
   return stmt;
 }
 
+// for (x in iterable) or for (var x in iterable), after the '('
+static Stmt *for_in_statement(Parser *parser, RuntimeError **error) {
+  bool declare = match(parser, 1, VAR);
+  Token *name = advance(parser); /* checked by the caller */
+  advance(parser);               /* 'in' */
+
+  Expr *iterable = expression(parser, error);
+  if (*error)
+    return NULL;
+  consume(parser, RIGHT_PAREN, "Expected ')' after for-in iterable.", error);
+  if (*error) {
+    expr_free(iterable);
+    return NULL;
+  }
+
+  Stmt *body = statement(parser, error);
+  if (*error) {
+    expr_free(iterable);
+    return NULL;
+  }
+
+  Stmt *stmt = stmt_new(STMT_FOR_IN);
+  stmt->as.for_in.name = *name;
+  stmt->as.for_in.name.lexeme = ms_strdup(name->lexeme);
+  stmt->as.for_in.declare = declare;
+  stmt->as.for_in.iterable = iterable;
+  stmt->as.for_in.body = body;
+  return stmt;
+}
+
 static Stmt *for_statement(Parser *parser, RuntimeError **error) {
+  size_t line = previous(parser)->line; /* of 'for' */
   consume(parser, LEFT_PAREN, "Expected '(' after 'for'.", error);
   if (*error)
     return NULL;
 
+  size_t name_at = parser->current + (check(parser, VAR) ? 1 : 0);
+  if (name_at + 1 < parser->count && parser->tokens[name_at].type == IDENTIFIER &&
+      parser->tokens[name_at + 1].type == IN)
+    return for_in_statement(parser, error);
+
   // Parse initializer (can be variable declaration or expression)
   Stmt *initializer = NULL;
   if (match(parser, 1, SEMICOLON)) {
@@ -764,6 +807,9 @@ static Stmt *for_statement(Parser *parser, RuntimeError **error) {
   }
   if (*error)
     return NULL;
+  // Parsed without going through declaration()/statement(), which set lines
+  if (initializer)
+    initializer->line = line;
 
   // Parse condition
   Expr *condition = NULL;
@@ -892,24 +938,32 @@ static Stmt *block_statement(Parser *parser, RuntimeError **error) {
 }
 
 static Stmt *statement(Parser *parser, RuntimeError **error) {
+  size_t line = current_line(parser);
+  ALLOC_SOURCE_LINE(line);
+  Stmt *stmt;
+
   if (match(parser, 1, IF))
-    return if_statement(parser, error);
-  if (match(parser, 1, FOR))
-    return for_statement(parser, error);
-  if (match(parser, 1, IMPORT))
-    return import_statement(parser, error);
-  if (match(parser, 1, PRINT))
-    return print_statement(parser, error);
-  if (match(parser, 1, ASSERT))
-    return assert_statement(parser, error);
-  if (match(parser, 1, RETURN))
-    return return_statement(parser, error);
-  if (match(parser, 1, WHILE))
-    return while_statement(parser, error);
-  if (match(parser, 1, LEFT_BRACE))
-    return block_statement(parser, error);
-
-  return expression_statement(parser, error);
+    stmt = if_statement(parser, error);
+  else if (match(parser, 1, FOR))
+    stmt = for_statement(parser, error);
+  else if (match(parser, 1, IMPORT))
+    stmt = import_statement(parser, error);
+  else if (match(parser, 1, PRINT))
+    stmt = print_statement(parser, error);
+  else if (match(parser, 1, ASSERT))
+    stmt = assert_statement(parser, error);
+  else if (match(parser, 1, RETURN))
+    stmt = return_statement(parser, error);
+  else if (match(parser, 1, WHILE))
+    stmt = while_statement(parser, error);
+  else if (match(parser, 1, LEFT_BRACE))
+    stmt = block_statement(parser, error);
+  else
+    stmt = expression_statement(parser, error);
+
+  if (stmt)
+    stmt->line = line;
+  return stmt;
 }
 
 static Stmt *function_declaration(Parser *parser, const char *kind,
@@ -971,6 +1025,8 @@ static Stmt *function_declaration(Parser *parser, const char *kind,
   stmt->as.function.name.lexeme = ms_strdup(name->lexeme);
   stmt->as.function.params = params;
   stmt->as.function.param_count = param_count;
+  stmt->as.function.filename =
+      ms_strdup(parser->filename ? parser->filename : "<unknown>");
   stmt->as.function.body = body_stmt->as.block.statements;
 
   // Transfer ownership of statements from block
@@ -1016,10 +1072,18 @@ static Stmt *var_declaration(Parser *parser, RuntimeError **error) {
 }
 
 static Stmt *declaration(Parser *parser, RuntimeError **error) {
-  if (match(parser, 1, FUNCTION))
-    return function_declaration(parser, "function", error);
-  if (match(parser, 1, VAR))
-    return var_declaration(parser, error);
+  size_t line = current_line(parser);
+  ALLOC_SOURCE_LINE(line);
+  Stmt *stmt;
 
-  return statement(parser, error);
+  if (match(parser, 1, FUNCTION))
+    stmt = function_declaration(parser, "function", error);
+  else if (match(parser, 1, VAR))
+    stmt = var_declaration(parser, error);
+  else
+    return statement(parser, error);
+
+  if (stmt)
+    stmt->line = line;
+  return stmt;
 }
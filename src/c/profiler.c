@@ -0,0 +1,673 @@
+#define _GNU_SOURCE
+#include "mini_script.h"
+#include <stdint.h>
+
+#ifdef _WIN32
+
+bool profiler_start(Interpreter *interpreter, long interval_us) {
+  (void)interpreter;
+  (void)interval_us;
+  fprintf(stderr, "Profiler: --profile is not supported on this platform.\n");
+  return false;
+}
+void profiler_stop(void) {}
+bool profiler_write_folded(const char *path) {
+  (void)path;
+  return false;
+}
+void profiler_print_summary(FILE *out, size_t top_n) {
+  (void)out;
+  (void)top_n;
+}
+
+#else
+
+#include <signal.h>
+#include <sys/time.h>
+
+/* Sampling profiler.
+ *
+ * A SIGPROF interval timer interrupts the interpreter every interval_us
+ * microseconds of CPU time. The handler copies the interpreter's call stack
+ * (function, file, line per frame) and counts identical stacks in a hash
+ * table. All storage is allocated before the timer starts and only the
+ * handler writes to it, so the handler never allocates and the interpreter
+ * pays nothing beyond keeping its frame stack current. Stacks are resolved
+ * to text only after profiler_stop().
+ */
+
+#define PROFILE_MAX_DEPTH 256        /* frames kept per sample (leaf-most) */
+#define PROFILE_TABLE_SIZE (1 << 16) /* distinct stacks; power of two */
+#define PROFILE_ARENA_SIZE (1 << 20) /* frames across all distinct stacks */
+
+typedef struct {
+  uint64_t hash;
+  uint32_t first; /* index of the root-most frame in the arena */
+  uint32_t depth; /* 0 marks an empty slot */
+  uint64_t count;
+  bool truncated; /* root-most frames were dropped */
+} ProfileStack;
+
+static struct {
+  Interpreter *interpreter;
+  ProfileStack *stacks;
+  CallFrame *arena;
+  size_t arena_used;
+  size_t stack_count;
+  uint64_t samples;
+  uint64_t dropped;
+  long interval_us;
+  bool running;
+} profiler;
+
+static uint64_t hash_frames(const CallFrame *frames, size_t depth) {
+  uint64_t hash = 1469598103934665603ULL;
+  for (size_t i = 0; i < depth; i++) {
+    hash = (hash ^ (uint64_t)(uintptr_t)frames[i].function) * 1099511628211ULL;
+    hash = (hash ^ (uint64_t)(uintptr_t)frames[i].filename) * 1099511628211ULL;
+    hash = (hash ^ (uint64_t)frames[i].line) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+static bool frames_equal(const CallFrame *a, const CallFrame *b, size_t depth) {
+  for (size_t i = 0; i < depth; i++) {
+    if (a[i].function != b[i].function || a[i].filename != b[i].filename ||
+        a[i].line != b[i].line)
+      return false;
+  }
+  return true;
+}
+
+static void handle_sigprof(int signo) {
+  (void)signo;
+  Interpreter *interpreter = profiler.interpreter;
+  if (!interpreter)
+    return;
+
+  CallFrame frames[PROFILE_MAX_DEPTH];
+  size_t count = interpreter->frame_count;
+  size_t start = count > PROFILE_MAX_DEPTH ? count - PROFILE_MAX_DEPTH : 0;
+  size_t depth = count - start;
+  for (size_t i = 0; i < depth; i++) {
+    frames[i].function = interpreter->frames[start + i].function;
+    frames[i].filename = interpreter->frames[start + i].filename;
+    frames[i].line = interpreter->frames[start + i].line;
+  }
+
+  profiler.samples++;
+  uint64_t hash = hash_frames(frames, depth) ^ (start > 0);
+  size_t slot = (size_t)hash & (PROFILE_TABLE_SIZE - 1);
+  for (size_t probe = 0; probe < PROFILE_TABLE_SIZE; probe++) {
+    ProfileStack *entry = &profiler.stacks[slot];
+    if (entry->depth == 0) {
+      /* Keep the table at most half full so probes stay short */
+      if (profiler.stack_count >= PROFILE_TABLE_SIZE / 2 ||
+          profiler.arena_used + depth > PROFILE_ARENA_SIZE) {
+        profiler.dropped++;
+        return;
+      }
+      memcpy(&profiler.arena[profiler.arena_used], frames,
+             depth * sizeof(CallFrame));
+      entry->hash = hash;
+      entry->first = (uint32_t)profiler.arena_used;
+      entry->count = 1;
+      entry->truncated = start > 0;
+      entry->depth = (uint32_t)depth;
+      profiler.arena_used += depth;
+      profiler.stack_count++;
+      return;
+    }
+    if (entry->hash == hash && entry->depth == depth &&
+        entry->truncated == (start > 0) &&
+        frames_equal(&profiler.arena[entry->first], frames, depth)) {
+      entry->count++;
+      return;
+    }
+    slot = (slot + 1) & (PROFILE_TABLE_SIZE - 1);
+  }
+  profiler.dropped++;
+}
+
+bool profiler_start(Interpreter *interpreter, long interval_us) {
+  if (interval_us <= 0)
+    interval_us = 1000;
+
+  free(profiler.stacks);
+  free(profiler.arena);
+  memset(&profiler, 0, sizeof(profiler));
+  profiler.stacks = calloc(PROFILE_TABLE_SIZE, sizeof(ProfileStack));
+  profiler.arena = malloc(PROFILE_ARENA_SIZE * sizeof(CallFrame));
+  if (!profiler.stacks || !profiler.arena) {
+    fprintf(stderr, "Profiler: not enough memory for sample buffers.\n");
+    return false;
+  }
+  profiler.interval_us = interval_us;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handle_sigprof;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, NULL) != 0) {
+    perror("Profiler: sigaction");
+    return false;
+  }
+
+  profiler.interpreter = interpreter;
+  struct itimerval timer;
+  timer.it_interval.tv_sec = interval_us / 1000000;
+  timer.it_interval.tv_usec = interval_us % 1000000;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+    perror("Profiler: setitimer");
+    profiler.interpreter = NULL;
+    return false;
+  }
+  profiler.running = true;
+  return true;
+}
+
+void profiler_stop(void) {
+  if (!profiler.running)
+    return;
+
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, NULL);
+  signal(SIGPROF, SIG_IGN);
+  profiler.interpreter = NULL;
+  profiler.running = false;
+}
+
+static void write_frame(FILE *out, const CallFrame *frame) {
+  fprintf(out, "%s (%s:%zu)", frame->function,
+          frame->filename ? frame->filename : "<unknown>", frame->line);
+}
+
+/* Folded stacks: one line per distinct stack, frames root to leaf separated
+ * by ';', then the sample count. Accepted by flamegraph.pl, inferno and
+ * speedscope. */
+bool profiler_write_folded(const char *path) {
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    fprintf(stderr, "Profiler: could not write \"%s\".\n", path);
+    return false;
+  }
+
+  for (size_t i = 0; i < PROFILE_TABLE_SIZE; i++) {
+    ProfileStack *entry = &profiler.stacks[i];
+    if (entry->depth == 0)
+      continue;
+    if (entry->truncated)
+      fprintf(out, "[truncated];");
+    for (uint32_t f = 0; f < entry->depth; f++) {
+      if (f > 0)
+        fputc(';', out);
+      write_frame(out, &profiler.arena[entry->first + f]);
+    }
+    fprintf(out, " %llu\n", (unsigned long long)entry->count);
+  }
+
+  fclose(out);
+  return true;
+}
+
+/* Summary rows: per function (self and total samples) or per source line
+ * (self samples only). */
+typedef struct {
+  const char *function;
+  const char *filename;
+  size_t line;
+  uint64_t self;
+  uint64_t total;
+  uint64_t last_stack; /* stack index + 1 that last added to total */
+} ProfileRow;
+
+static ProfileRow *find_row(ProfileRow **rows, size_t *count, size_t *capacity,
+                            const CallFrame *frame, bool by_line) {
+  for (size_t i = 0; i < *count; i++) {
+    ProfileRow *row = &(*rows)[i];
+    if (row->function == frame->function && row->filename == frame->filename &&
+        (!by_line || row->line == frame->line))
+      return row;
+  }
+  if (*count >= *capacity) {
+    *capacity = *capacity == 0 ? 32 : *capacity * 2;
+    *rows = realloc(*rows, *capacity * sizeof(ProfileRow));
+  }
+  ProfileRow *row = &(*rows)[(*count)++];
+  row->function = frame->function;
+  row->filename = frame->filename;
+  row->line = by_line ? frame->line : 0;
+  row->self = 0;
+  row->total = 0;
+  row->last_stack = 0;
+  return row;
+}
+
+static int compare_rows(const void *a, const void *b) {
+  const ProfileRow *x = a, *y = b;
+  if (x->self != y->self)
+    return x->self < y->self ? 1 : -1;
+  if (x->total != y->total)
+    return x->total < y->total ? 1 : -1;
+  return 0;
+}
+
+void profiler_print_summary(FILE *out, size_t top_n) {
+  ProfileRow *functions = NULL, *lines = NULL;
+  size_t function_count = 0, function_capacity = 0;
+  size_t line_count = 0, line_capacity = 0;
+
+  for (size_t i = 0; i < PROFILE_TABLE_SIZE; i++) {
+    ProfileStack *entry = &profiler.stacks[i];
+    if (entry->depth == 0)
+      continue;
+    const CallFrame *frames = &profiler.arena[entry->first];
+    for (uint32_t f = 0; f < entry->depth; f++) {
+      ProfileRow *row = find_row(&functions, &function_count, &function_capacity,
+                                 &frames[f], false);
+      /* Recursive frames count once towards a function's total */
+      if (row->last_stack != i + 1) {
+        row->total += entry->count;
+        row->last_stack = i + 1;
+      }
+    }
+    const CallFrame *leaf = &frames[entry->depth - 1];
+    find_row(&functions, &function_count, &function_capacity, leaf, false)->self +=
+        entry->count;
+    find_row(&lines, &line_count, &line_capacity, leaf, true)->self += entry->count;
+  }
+
+  qsort(functions, function_count, sizeof(ProfileRow), compare_rows);
+  qsort(lines, line_count, sizeof(ProfileRow), compare_rows);
+
+  double total = profiler.samples > profiler.dropped
+                     ? (double)(profiler.samples - profiler.dropped)
+                     : 1.0;
+  fprintf(out, "\nProfile: %llu samples every %ld us of CPU time",
+          (unsigned long long)profiler.samples, profiler.interval_us);
+  if (profiler.dropped > 0)
+    fprintf(out, " (%llu dropped)", (unsigned long long)profiler.dropped);
+  fprintf(out, "\n\n%8s %8s %9s  %s\n", "self%", "total%", "samples", "function");
+  for (size_t i = 0; i < function_count && i < top_n; i++) {
+    fprintf(out, "%7.2f%% %7.2f%% %9llu  %s (%s)\n",
+            100.0 * functions[i].self / total, 100.0 * functions[i].total / total,
+            (unsigned long long)functions[i].self, functions[i].function,
+            functions[i].filename);
+  }
+  fprintf(out, "\n%8s %9s  %s\n", "self%", "samples", "line");
+  for (size_t i = 0; i < line_count && i < top_n; i++) {
+    fprintf(out, "%7.2f%% %9llu  %s:%zu (%s)\n", 100.0 * lines[i].self / total,
+            (unsigned long long)lines[i].self, lines[i].filename, lines[i].line,
+            lines[i].function);
+  }
+
+  free(functions);
+  free(lines);
+}
+
+#endif /* _WIN32 */
+
+/* Deterministic call instrumentation.
+ *
+ * Every MiniScript function call (keyed by its declaring statement) and
+ * every builtin call (keyed by name) is counted and timed with a monotonic
+ * clock. Inclusive time covers the whole call; exclusive time subtracts the
+ * inclusive time of calls made from it. For recursive functions inclusive
+ * time is taken only from the outermost active call so it is not counted
+ * twice. A module imported several times declares its functions again;
+ * declarations with the same name, file and line share one entry.
+ */
+
+typedef struct {
+  const char *name;     /* function or builtin name (owned for builtins) */
+  const char *filename; /* NULL for builtins */
+  size_t line;
+  uint64_t calls;
+  uint64_t inclusive_ns;
+  uint64_t exclusive_ns;
+  size_t active; /* activations currently on the stack */
+} InstrumentEntry;
+
+typedef struct {
+  const void *key; /* declaring Stmt*, or NULL for a builtin looked up by name */
+  size_t entry;    /* entry index + 1; 0 marks an empty slot */
+} InstrumentSlot;
+
+typedef struct {
+  size_t entry; /* index into entries, which move as the table grows */
+  uint64_t start_ns;
+  uint64_t child_ns;
+} InstrumentCall;
+
+static struct {
+  InstrumentEntry *entries;
+  size_t count;
+  size_t capacity;
+  InstrumentSlot *slots; /* open-addressing index over declarations/names */
+  size_t slot_used;
+  size_t slot_count;
+  InstrumentCall *calls;
+  size_t depth;
+  size_t call_capacity;
+  uint64_t start_ns;
+  uint64_t child_ns; /* inclusive time of calls made from the top level */
+} instrument;
+
+uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void instrument_start(void) {
+  instrument.start_ns = monotonic_ns();
+}
+
+static uint64_t instrument_hash(const void *key, const char *name) {
+  if (key)
+    return ((uint64_t)(uintptr_t)key >> 4) * 11400714819323198485ULL;
+  uint64_t hash = 1469598103934665603ULL;
+  for (; *name; name++)
+    hash = (hash ^ (unsigned char)*name) * 1099511628211ULL;
+  return hash;
+}
+
+static InstrumentSlot *instrument_slot(const void *key, const char *name) {
+  size_t mask = instrument.slot_count - 1;
+  size_t slot = (size_t)instrument_hash(key, name) & mask;
+  while (instrument.slots[slot].entry != 0) {
+    InstrumentSlot *candidate = &instrument.slots[slot];
+    if (key ? candidate->key == key
+            : (!candidate->key &&
+               strcmp(instrument.entries[candidate->entry - 1].name, name) == 0))
+      break;
+    slot = (slot + 1) & mask;
+  }
+  return &instrument.slots[slot];
+}
+
+static void instrument_grow_slots(void) {
+  InstrumentSlot *old = instrument.slots;
+  size_t old_count = instrument.slot_count;
+  instrument.slot_count = old_count == 0 ? 64 : old_count * 2;
+  instrument.slots = calloc(instrument.slot_count, sizeof(InstrumentSlot));
+  for (size_t i = 0; i < old_count; i++) {
+    if (old[i].entry != 0) {
+      const char *name = instrument.entries[old[i].entry - 1].name;
+      *instrument_slot(old[i].key, name) = old[i];
+    }
+  }
+  free(old);
+}
+
+static size_t instrument_entry(const void *key, const char *name,
+                               const char *filename, size_t line) {
+  if (instrument.slot_count > 0) {
+    InstrumentSlot *slot = instrument_slot(key, name);
+    if (slot->entry != 0)
+      return slot->entry - 1;
+  }
+
+  /* First call through this declaration: reuse an entry for an identical
+   * declaration from an earlier import, or add one. */
+  size_t index = instrument.count;
+  for (size_t i = 0; key && i < instrument.count; i++) {
+    InstrumentEntry *entry = &instrument.entries[i];
+    if (entry->filename && entry->line == line &&
+        strcmp(entry->name, name) == 0 && strcmp(entry->filename, filename) == 0) {
+      index = i;
+      break;
+    }
+  }
+  if (index == instrument.count) {
+    if (instrument.count >= instrument.capacity) {
+      instrument.capacity = instrument.capacity == 0 ? 32 : instrument.capacity * 2;
+      instrument.entries =
+          realloc(instrument.entries, instrument.capacity * sizeof(InstrumentEntry));
+    }
+    InstrumentEntry *entry = &instrument.entries[instrument.count++];
+    memset(entry, 0, sizeof(*entry));
+    char *copy = malloc(strlen(name) + 1);
+    strcpy(copy, name);
+    entry->name = copy;
+    if (filename) {
+      copy = malloc(strlen(filename) + 1);
+      strcpy(copy, filename);
+      entry->filename = copy;
+    }
+    entry->line = line;
+  }
+
+  if ((instrument.slot_used + 1) * 2 > instrument.slot_count)
+    instrument_grow_slots();
+  InstrumentSlot *slot = instrument_slot(key, instrument.entries[index].name);
+  slot->key = key;
+  slot->entry = index + 1;
+  instrument.slot_used++;
+  return index;
+}
+
+static void instrument_enter(size_t index) {
+  if (instrument.depth >= instrument.call_capacity) {
+    instrument.call_capacity =
+        instrument.call_capacity == 0 ? 64 : instrument.call_capacity * 2;
+    instrument.calls =
+        realloc(instrument.calls, instrument.call_capacity * sizeof(InstrumentCall));
+  }
+  InstrumentEntry *entry = &instrument.entries[index];
+  InstrumentCall *call = &instrument.calls[instrument.depth++];
+  call->entry = index;
+  call->child_ns = 0;
+  entry->calls++;
+  entry->active++;
+  call->start_ns = monotonic_ns();
+}
+
+void instrument_enter_function(Stmt *declaration) {
+  instrument_enter(instrument_entry(declaration, declaration->as.function.name.lexeme,
+                                    declaration->as.function.filename,
+                                    declaration->line));
+}
+
+void instrument_enter_builtin(const char *name) {
+  instrument_enter(instrument_entry(NULL, name, NULL, 0));
+}
+
+void instrument_exit(void) {
+  uint64_t end = monotonic_ns();
+  if (instrument.depth == 0)
+    return;
+
+  InstrumentCall *call = &instrument.calls[--instrument.depth];
+  InstrumentEntry *entry = &instrument.entries[call->entry];
+  uint64_t elapsed = end - call->start_ns;
+  entry->exclusive_ns += elapsed - call->child_ns;
+  if (--entry->active == 0)
+    entry->inclusive_ns += elapsed;
+
+  if (instrument.depth > 0)
+    instrument.calls[instrument.depth - 1].child_ns += elapsed;
+  else
+    instrument.child_ns += elapsed;
+}
+
+static int compare_entries(const void *a, const void *b) {
+  const InstrumentEntry *x = a, *y = b;
+  if (x->exclusive_ns != y->exclusive_ns)
+    return x->exclusive_ns < y->exclusive_ns ? 1 : -1;
+  return strcmp(x->name, y->name);
+}
+
+static void write_json_string(FILE *out, const char *s) {
+  fputc('"', out);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      fprintf(out, "\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      fprintf(out, "\\u%04x", (unsigned char)*s);
+    else
+      fputc(*s, out);
+  }
+  fputc('"', out);
+}
+
+void instrument_report(FILE *out, bool json) {
+  uint64_t total_ns = monotonic_ns() - instrument.start_ns;
+  uint64_t main_ns =
+      total_ns > instrument.child_ns ? total_ns - instrument.child_ns : 0;
+
+  qsort(instrument.entries, instrument.count, sizeof(InstrumentEntry),
+        compare_entries);
+
+  if (json) {
+    fprintf(out, "{\"total_ns\": %llu, \"main_exclusive_ns\": %llu, \"calls\": [",
+            (unsigned long long)total_ns, (unsigned long long)main_ns);
+    for (size_t i = 0; i < instrument.count; i++) {
+      InstrumentEntry *entry = &instrument.entries[i];
+      fprintf(out, "%s\n  {\"name\": ", i > 0 ? "," : "");
+      write_json_string(out, entry->name);
+      fprintf(out, ", \"kind\": \"%s\"", entry->filename ? "function" : "builtin");
+      if (entry->filename) {
+        fprintf(out, ", \"file\": ");
+        write_json_string(out, entry->filename);
+        fprintf(out, ", \"line\": %zu", entry->line);
+      }
+      fprintf(out, ", \"calls\": %llu, \"inclusive_ns\": %llu, \"exclusive_ns\": %llu}",
+              (unsigned long long)entry->calls,
+              (unsigned long long)entry->inclusive_ns,
+              (unsigned long long)entry->exclusive_ns);
+    }
+    fprintf(out, "\n]}\n");
+  } else {
+    fprintf(out, "\nCall statistics (%.3f ms total, %.3f ms at top level)\n\n",
+            total_ns / 1e6, main_ns / 1e6);
+    fprintf(out, "%10s %14s %14s %12s  %s\n", "calls", "inclusive_ms",
+            "exclusive_ms", "avg_us", "function");
+    for (size_t i = 0; i < instrument.count; i++) {
+      InstrumentEntry *entry = &instrument.entries[i];
+      fprintf(out, "%10llu %14.3f %14.3f %12.3f  ",
+              (unsigned long long)entry->calls, entry->inclusive_ns / 1e6,
+              entry->exclusive_ns / 1e6,
+              entry->calls ? entry->inclusive_ns / 1e3 / entry->calls : 0.0);
+      if (entry->filename)
+        fprintf(out, "%s (%s:%zu)\n", entry->name, entry->filename, entry->line);
+      else
+        fprintf(out, "%s [builtin]\n", entry->name);
+    }
+  }
+
+  for (size_t i = 0; i < instrument.count; i++) {
+    free((char *)instrument.entries[i].name);
+    free((char *)instrument.entries[i].filename);
+  }
+  free(instrument.entries);
+  free(instrument.slots);
+  free(instrument.calls);
+  memset(&instrument, 0, sizeof(instrument));
+}
+
+/* Trace events (--trace-events).
+ *
+ * Writes a Chrome trace-event file (JSON array format, loadable in
+ * chrome://tracing and Perfetto) as the script runs: the read, lex, parse
+ * and execute phases of the script and of every import, each file I/O
+ * builtin call, and MiniScript function calls that last at least the
+ * threshold. Every span is a complete ("X") event timed with the monotonic
+ * clock and written when it ends, so nested spans appear after their
+ * children; viewers order them by timestamp. Timestamps are microseconds
+ * since the trace started.
+ */
+
+static struct {
+  FILE *out;
+  uint64_t origin_ns;
+  uint64_t threshold_ns;
+  size_t events;
+} trace;
+
+static const char *trace_io_builtins[] = {
+    "fopen",      "fclose",  "fread",       "fwrite",       "freadline",
+    "fwriteline", "fexists", "fread_bytes", "fwrite_bytes",
+};
+
+bool trace_start(const char *path, const char *script, long threshold_us) {
+  trace.out = fopen(path, "w");
+  if (!trace.out) {
+    fprintf(stderr, "Could not write \"%s\".\n", path);
+    return false;
+  }
+  trace.origin_ns = monotonic_ns();
+  trace.threshold_ns = threshold_us > 0 ? (uint64_t)threshold_us * 1000 : 0;
+  trace.events = 0;
+  fprintf(trace.out, "[\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+                     "\"tid\": 1, \"args\": {\"name\": ");
+  write_json_string(trace.out, script);
+  fprintf(trace.out, "}}");
+  return true;
+}
+
+static void trace_event(const char *category, const char *name,
+                        uint64_t start_ns, const char *file, size_t line,
+                        const char *path) {
+  uint64_t end_ns = monotonic_ns();
+  uint64_t ts = start_ns > trace.origin_ns ? start_ns - trace.origin_ns : 0;
+  fprintf(trace.out, ",\n{\"name\": ");
+  write_json_string(trace.out, name);
+  fprintf(trace.out, ", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+                     "\"dur\": %.3f, \"pid\": 1, \"tid\": 1, \"args\": {",
+          category, ts / 1e3, (end_ns - start_ns) / 1e3);
+  const char *separator = "";
+  if (file) {
+    fprintf(trace.out, "\"file\": ");
+    write_json_string(trace.out, file);
+    fprintf(trace.out, ", \"line\": %zu", line);
+    separator = ", ";
+  }
+  if (path) {
+    fprintf(trace.out, "%s\"path\": ", separator);
+    write_json_string(trace.out, path);
+  }
+  fprintf(trace.out, "}}");
+  trace.events++;
+}
+
+void trace_span(const char *category, const char *name, uint64_t start_ns,
+                const char *path) {
+  if (trace.out)
+    trace_event(category, name, start_ns, NULL, 0, path);
+}
+
+void trace_call(Stmt *declaration, uint64_t start_ns) {
+  if (!trace.out || monotonic_ns() - start_ns < trace.threshold_ns)
+    return;
+  trace_event("function", declaration->as.function.name.lexeme, start_ns,
+              declaration->as.function.filename, declaration->line, NULL);
+}
+
+void trace_builtin(const char *name, Value **args, int arg_count,
+                   uint64_t start_ns, const char *file, size_t line) {
+  if (!trace.out)
+    return;
+  for (size_t i = 0; i < sizeof(trace_io_builtins) / sizeof(trace_io_builtins[0]); i++) {
+    if (strcmp(name, trace_io_builtins[i]) == 0) {
+      /* fopen and fexists name the file; the others take a handle */
+      const char *path = arg_count > 0 && args[0]->type == VALUE_STRING
+                             ? args[0]->as.string
+                             : NULL;
+      trace_event("io", name, start_ns, file, line, path);
+      return;
+    }
+  }
+}
+
+size_t trace_stop(void) {
+  if (!trace.out)
+    return 0;
+  fprintf(trace.out, "\n]\n");
+  fclose(trace.out);
+  trace.out = NULL;
+  return trace.events;
+}
@@ -0,0 +1,454 @@
+#include "mini_script.h"
+
+/* Sorting for the sort() and sort_by() builtins.
+ *
+ * A list is sorted where it is stored (list storage is shared, so the
+ * variable holding it sees the result). Lists of numbers are sorted by an
+ * LSD radix sort on the bit patterns of the doubles, one pass per byte that
+ * is not the same in every key. Lists of strings are sorted by pdqsort
+ * (pattern-defeating quicksort: introsort with median-of-three pivots,
+ * insertion sort on short ranges and already sorted runs, and a heapsort
+ * fallback) over records that cache each string's length and its first
+ * eight bytes, so most comparisons never touch the strings themselves.
+ * Both orders are stable: radix sort is, and the string records break ties
+ * on their original position.
+ */
+
+#define INSERTION_SORT_THRESHOLD 24
+#define NINTHER_THRESHOLD 128
+#define PARTIAL_INSERTION_SORT_LIMIT 8
+#define RADIX_THRESHOLD 64 /* shorter lists of numbers use insertion sort */
+
+#define SIGN_BIT 0x8000000000000000ull
+
+/* Numbers */
+
+/* Maps NUMBER to an unsigned key in the same order */
+static uint64_t number_key(double number) {
+  uint64_t bits;
+  memcpy(&bits, &number, sizeof(bits));
+  return bits & SIGN_BIT ? ~bits : bits | SIGN_BIT;
+}
+
+static double key_number(uint64_t key) {
+  uint64_t bits = key & SIGN_BIT ? key & ~SIGN_BIT : ~key;
+  double number;
+  memcpy(&number, &bits, sizeof(number));
+  return number;
+}
+
+/* Sorts KEYS, permuting INDEX (if not NULL) alongside; stable */
+static void radix_sort(uint64_t *keys, size_t *index, size_t count) {
+  if (count < RADIX_THRESHOLD) {
+    for (size_t i = 1; i < count; i++) {
+      uint64_t key = keys[i];
+      size_t position = index ? index[i] : 0;
+      size_t j = i;
+      for (; j > 0 && keys[j - 1] > key; j--) {
+        keys[j] = keys[j - 1];
+        if (index)
+          index[j] = index[j - 1];
+      }
+      keys[j] = key;
+      if (index)
+        index[j] = position;
+    }
+    return;
+  }
+
+  size_t counts[8][256];
+  memset(counts, 0, sizeof(counts));
+  for (size_t i = 0; i < count; i++) {
+    for (int byte = 0; byte < 8; byte++)
+      counts[byte][(keys[i] >> (8 * byte)) & 0xff]++;
+  }
+
+  uint64_t *key_buffer = malloc(count * sizeof(uint64_t));
+  size_t *index_buffer = index ? malloc(count * sizeof(size_t)) : NULL;
+  uint64_t *from_keys = keys, *to_keys = key_buffer;
+  size_t *from_index = index, *to_index = index_buffer;
+  for (int byte = 0; byte < 8; byte++) {
+    size_t *bucket = counts[byte];
+    int shift = 8 * byte;
+    if (bucket[(from_keys[0] >> shift) & 0xff] == count)
+      continue; /* every key has this byte in common */
+    size_t offset = 0;
+    for (int b = 0; b < 256; b++) {
+      size_t n = bucket[b];
+      bucket[b] = offset;
+      offset += n;
+    }
+    if (index) {
+      for (size_t i = 0; i < count; i++) {
+        size_t to = bucket[(from_keys[i] >> shift) & 0xff]++;
+        to_keys[to] = from_keys[i];
+        to_index[to] = from_index[i];
+      }
+      size_t *swap = from_index;
+      from_index = to_index;
+      to_index = swap;
+    } else {
+      for (size_t i = 0; i < count; i++)
+        to_keys[bucket[(from_keys[i] >> shift) & 0xff]++] = from_keys[i];
+    }
+    uint64_t *swap = from_keys;
+    from_keys = to_keys;
+    to_keys = swap;
+  }
+  if (from_keys != keys) {
+    memcpy(keys, from_keys, count * sizeof(uint64_t));
+    if (index)
+      memcpy(index, from_index, count * sizeof(size_t));
+  }
+  free(key_buffer);
+  free(index_buffer);
+}
+
+/* Strings */
+
+typedef struct {
+  uint64_t prefix; /* the first eight bytes, big-endian, zero-padded */
+  size_t length;
+  const char *string;
+  size_t index; /* original position, for stability */
+} StringKey;
+
+static StringKey string_key(const char *string, size_t index) {
+  StringKey key = {0, strlen(string), string, index};
+  for (size_t i = 0; i < 8; i++) {
+    key.prefix <<= 8;
+    if (i < key.length)
+      key.prefix |= (unsigned char)string[i];
+  }
+  return key;
+}
+
+static inline bool key_less(const StringKey *a, const StringKey *b) {
+  if (a->prefix != b->prefix)
+    return a->prefix < b->prefix;
+  size_t shorter = a->length < b->length ? a->length : b->length;
+  if (shorter > 8) {
+    int order = memcmp(a->string + 8, b->string + 8, shorter - 8);
+    if (order != 0)
+      return order < 0;
+  }
+  if (a->length != b->length)
+    return a->length < b->length;
+  return a->index < b->index;
+}
+
+static inline void key_swap(StringKey *a, StringKey *b) {
+  StringKey tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+static inline void sort2(StringKey *a, StringKey *b) {
+  if (key_less(b, a))
+    key_swap(a, b);
+}
+
+static inline void sort3(StringKey *a, StringKey *b, StringKey *c) {
+  sort2(a, b);
+  sort2(b, c);
+  sort2(a, b);
+}
+
+static void insertion_sort(StringKey *begin, StringKey *end) {
+  if (begin == end)
+    return;
+  for (StringKey *cur = begin + 1; cur != end; cur++) {
+    StringKey *sift = cur, *sift_1 = cur - 1;
+    if (key_less(sift, sift_1)) {
+      StringKey tmp = *sift;
+      do {
+        *sift-- = *sift_1;
+      } while (sift != begin && key_less(&tmp, --sift_1));
+      *sift = tmp;
+    }
+  }
+}
+
+/* Insertion sort of a range whose predecessor, begin[-1], is no greater than
+ * any of its elements */
+static void unguarded_insertion_sort(StringKey *begin, StringKey *end) {
+  if (begin == end)
+    return;
+  for (StringKey *cur = begin + 1; cur != end; cur++) {
+    StringKey *sift = cur, *sift_1 = cur - 1;
+    if (key_less(sift, sift_1)) {
+      StringKey tmp = *sift;
+      do {
+        *sift-- = *sift_1;
+      } while (key_less(&tmp, --sift_1));
+      *sift = tmp;
+    }
+  }
+}
+
+/* Insertion sort that gives up once it has moved too many elements;
+ * returns whether the range is sorted */
+static bool partial_insertion_sort(StringKey *begin, StringKey *end) {
+  if (begin == end)
+    return true;
+  size_t moved = 0;
+  for (StringKey *cur = begin + 1; cur != end; cur++) {
+    StringKey *sift = cur, *sift_1 = cur - 1;
+    if (key_less(sift, sift_1)) {
+      StringKey tmp = *sift;
+      do {
+        *sift-- = *sift_1;
+      } while (sift != begin && key_less(&tmp, --sift_1));
+      *sift = tmp;
+      moved += cur - sift;
+      if (moved > PARTIAL_INSERTION_SORT_LIMIT)
+        return false;
+    }
+  }
+  return true;
+}
+
+static void sift_down(StringKey *heap, size_t root, size_t count) {
+  for (;;) {
+    size_t child = 2 * root + 1;
+    if (child >= count)
+      return;
+    if (child + 1 < count && key_less(&heap[child], &heap[child + 1]))
+      child++;
+    if (!key_less(&heap[root], &heap[child]))
+      return;
+    key_swap(&heap[root], &heap[child]);
+    root = child;
+  }
+}
+
+static void heap_sort(StringKey *begin, StringKey *end) {
+  size_t count = end - begin;
+  for (size_t i = count / 2; i-- > 0;)
+    sift_down(begin, i, count);
+  for (size_t i = count; i-- > 1;) {
+    key_swap(begin, begin + i);
+    sift_down(begin, 0, i);
+  }
+}
+
+/* Partitions around the pivot *BEGIN, elements equal to it going right;
+ * returns the pivot's final position */
+static StringKey *partition_right(StringKey *begin, StringKey *end,
+                                  bool *already_partitioned) {
+  StringKey pivot = *begin;
+  StringKey *first = begin, *last = end;
+
+  while (key_less(++first, &pivot))
+    ;
+  if (first - 1 == begin) {
+    while (first < last && !key_less(--last, &pivot))
+      ;
+  } else {
+    while (!key_less(--last, &pivot))
+      ;
+  }
+
+  *already_partitioned = first >= last;
+  while (first < last) {
+    key_swap(first, last);
+    while (key_less(++first, &pivot))
+      ;
+    while (!key_less(--last, &pivot))
+      ;
+  }
+
+  StringKey *pivot_position = first - 1;
+  *begin = *pivot_position;
+  *pivot_position = pivot;
+  return pivot_position;
+}
+
+/* Partitions around the pivot *BEGIN, elements equal to it going left */
+static StringKey *partition_left(StringKey *begin, StringKey *end) {
+  StringKey pivot = *begin;
+  StringKey *first = begin, *last = end;
+
+  while (key_less(&pivot, --last))
+    ;
+  if (last + 1 == end) {
+    while (first < last && !key_less(&pivot, ++first))
+      ;
+  } else {
+    while (!key_less(&pivot, ++first))
+      ;
+  }
+
+  while (first < last) {
+    key_swap(first, last);
+    while (key_less(&pivot, --last))
+      ;
+    while (!key_less(&pivot, ++first))
+      ;
+  }
+
+  StringKey *pivot_position = last;
+  *begin = *pivot_position;
+  *pivot_position = pivot;
+  return pivot_position;
+}
+
+static void pdqsort_loop(StringKey *begin, StringKey *end, int bad_allowed,
+                         bool leftmost) {
+  for (;;) {
+    size_t size = end - begin;
+    if (size < INSERTION_SORT_THRESHOLD) {
+      if (leftmost)
+        insertion_sort(begin, end);
+      else
+        unguarded_insertion_sort(begin, end);
+      return;
+    }
+
+    /* Pivot: median of three, or Tukey's ninther on long ranges */
+    size_t half = size / 2;
+    if (size > NINTHER_THRESHOLD) {
+      sort3(begin, begin + half, end - 1);
+      sort3(begin + 1, begin + (half - 1), end - 2);
+      sort3(begin + 2, begin + (half + 1), end - 3);
+      sort3(begin + (half - 1), begin + half, begin + (half + 1));
+      key_swap(begin, begin + half);
+    } else {
+      sort3(begin + half, begin, end - 1);
+    }
+
+    /* A pivot equal to the predecessor means a run of equal elements:
+     * put them all left of it, where they are done */
+    if (!leftmost && !key_less(begin - 1, begin)) {
+      begin = partition_left(begin, end) + 1;
+      continue;
+    }
+
+    bool already_partitioned;
+    StringKey *pivot = partition_right(begin, end, &already_partitioned);
+    size_t left_size = pivot - begin;
+    size_t right_size = end - (pivot + 1);
+
+    if (left_size < size / 8 || right_size < size / 8) {
+      /* A bad split: after too many, finish with heapsort; otherwise break
+       * up the pattern that caused it */
+      if (--bad_allowed == 0) {
+        heap_sort(begin, end);
+        return;
+      }
+      if (left_size >= INSERTION_SORT_THRESHOLD) {
+        key_swap(begin, begin + left_size / 4);
+        key_swap(pivot - 1, pivot - left_size / 4);
+        if (left_size > NINTHER_THRESHOLD) {
+          key_swap(begin + 1, begin + (left_size / 4 + 1));
+          key_swap(begin + 2, begin + (left_size / 4 + 2));
+          key_swap(pivot - 2, pivot - (left_size / 4 + 1));
+          key_swap(pivot - 3, pivot - (left_size / 4 + 2));
+        }
+      }
+      if (right_size >= INSERTION_SORT_THRESHOLD) {
+        key_swap(pivot + 1, pivot + (1 + right_size / 4));
+        key_swap(end - 1, end - right_size / 4);
+        if (right_size > NINTHER_THRESHOLD) {
+          key_swap(pivot + 2, pivot + (2 + right_size / 4));
+          key_swap(pivot + 3, pivot + (3 + right_size / 4));
+          key_swap(end - 2, end - (1 + right_size / 4));
+          key_swap(end - 3, end - (2 + right_size / 4));
+        }
+      }
+    } else if (already_partitioned && partial_insertion_sort(begin, pivot) &&
+               partial_insertion_sort(pivot + 1, end)) {
+      return; /* the input was (nearly) sorted */
+    }
+
+    pdqsort_loop(begin, pivot, bad_allowed, leftmost);
+    begin = pivot + 1;
+    leftmost = false;
+  }
+}
+
+static void pdqsort(StringKey *keys, size_t count) {
+  int bad_allowed = 1;
+  for (size_t n = count; n > 1; n >>= 1)
+    bad_allowed++;
+  pdqsort_loop(keys, keys + count, bad_allowed, true);
+}
+
+/* The type shared by all COUNT values, VALUE_NIL if they differ */
+static ValueType common_type(Value *values, size_t count) {
+  for (size_t i = 1; i < count; i++) {
+    if (values[i].type != values[0].type)
+      return VALUE_NIL;
+  }
+  return values[0].type;
+}
+
+bool sort_values(Value *elements, size_t count) {
+  if (count < 2)
+    return true;
+
+  switch (common_type(elements, count)) {
+  case VALUE_NUMBER: {
+    uint64_t *keys = malloc(count * sizeof(uint64_t));
+    for (size_t i = 0; i < count; i++)
+      keys[i] = number_key(elements[i].as.number);
+    radix_sort(keys, NULL, count);
+    for (size_t i = 0; i < count; i++)
+      elements[i].as.number = key_number(keys[i]);
+    free(keys);
+    return true;
+  }
+  case VALUE_STRING: {
+    StringKey *keys = malloc(count * sizeof(StringKey));
+    for (size_t i = 0; i < count; i++)
+      keys[i] = string_key(elements[i].as.string, i);
+    pdqsort(keys, count);
+    for (size_t i = 0; i < count; i++)
+      elements[i].as.string = (char *)keys[i].string;
+    free(keys);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+bool sort_values_by(Value *elements, Value *keys, size_t count) {
+  if (count < 2)
+    return true;
+
+  size_t *order = malloc(count * sizeof(size_t));
+  switch (common_type(keys, count)) {
+  case VALUE_NUMBER: {
+    uint64_t *radix_keys = malloc(count * sizeof(uint64_t));
+    for (size_t i = 0; i < count; i++) {
+      radix_keys[i] = number_key(keys[i].as.number);
+      order[i] = i;
+    }
+    radix_sort(radix_keys, order, count);
+    free(radix_keys);
+    break;
+  }
+  case VALUE_STRING: {
+    StringKey *string_keys = malloc(count * sizeof(StringKey));
+    for (size_t i = 0; i < count; i++)
+      string_keys[i] = string_key(keys[i].as.string, i);
+    pdqsort(string_keys, count);
+    for (size_t i = 0; i < count; i++)
+      order[i] = string_keys[i].index;
+    free(string_keys);
+    break;
+  }
+  default:
+    free(order);
+    return false;
+  }
+
+  Value *sorted = malloc(count * sizeof(Value));
+  for (size_t i = 0; i < count; i++)
+    sorted[i] = elements[order[i]];
+  memcpy(elements, sorted, count * sizeof(Value));
+  free(sorted);
+  free(order);
+  return true;
+}
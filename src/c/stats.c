@@ -0,0 +1,700 @@
+#define _GNU_SOURCE
+#include "mini_script.h"
+#include <stddef.h>
+#include <stdint.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+/* Allocation tracking.
+ *
+ * The interpreter's allocation sites report (site, allocations, bytes)
+ * through ALLOC_TRACK, which costs a flag test while tracking is off. Each
+ * record is attributed to a source location: while a file is being lexed or
+ * parsed, the file and the line reached so far; while executing, the file
+ * and line of the innermost call frame. Values freed along the way are not
+ * subtracted: the report shows allocation traffic, not live memory.
+ */
+
+bool alloc_tracking = false;
+size_t alloc_source_line = 0;
+
+static const char *site_names[ALLOC_SITE_COUNT] = {
+    "value_new",      "value_copy",    "ms_strdup",      "environment_new",
+    "env define key", "call args",     "lexer tokens",   "parser nodes",
+};
+
+typedef struct {
+  const char *filename; /* interned */
+  size_t line;
+  AllocSite site;
+  uint64_t count;
+  uint64_t bytes;
+} AllocRecord;
+
+static struct {
+  Interpreter *interpreter;
+  const char *source; /* file being lexed or parsed, NULL while executing */
+  char **filenames;   /* interned copies, compared by pointer */
+  size_t filename_count;
+  const char *last_raw; /* most recently interned pointer and its copy */
+  const char *last_interned;
+  AllocRecord *records; /* open-addressing table, count 0 marks empty */
+  size_t record_count;
+  size_t record_capacity;
+  uint64_t totals[ALLOC_SITE_COUNT][2];
+} allocs;
+
+void alloc_tracking_start(void) {
+  alloc_tracking = true;
+}
+
+void alloc_tracking_attach(Interpreter *interpreter) {
+  allocs.interpreter = interpreter;
+}
+
+void alloc_source_begin(const char *filename) {
+  allocs.source = filename;
+  allocs.last_raw = NULL;
+  alloc_source_line = 1;
+}
+
+void alloc_source_end(void) {
+  allocs.source = NULL;
+  allocs.last_raw = NULL;
+}
+
+/* Filenames may be freed before the report (parsers, imports), so records
+ * keep their own copy. */
+static const char *intern_filename(const char *filename) {
+  if (!filename)
+    filename = "<interpreter>"; /* setup outside any script, e.g. builtins */
+  if (filename == allocs.last_raw)
+    return allocs.last_interned;
+
+  const char *interned = NULL;
+  for (size_t i = 0; i < allocs.filename_count; i++) {
+    if (strcmp(allocs.filenames[i], filename) == 0) {
+      interned = allocs.filenames[i];
+      break;
+    }
+  }
+  if (!interned) {
+    allocs.filenames = realloc(allocs.filenames,
+                               (allocs.filename_count + 1) * sizeof(char *));
+    char *copy = malloc(strlen(filename) + 1);
+    strcpy(copy, filename);
+    allocs.filenames[allocs.filename_count++] = copy;
+    interned = copy;
+  }
+  allocs.last_raw = filename;
+  allocs.last_interned = interned;
+  return interned;
+}
+
+static size_t record_slot(AllocRecord *records, size_t capacity,
+                          const char *filename, size_t line, AllocSite site) {
+  uint64_t hash = ((uint64_t)(uintptr_t)filename >> 3) * 11400714819323198485ULL;
+  hash ^= (uint64_t)line * 0x9E3779B97F4A7C15ULL + (uint64_t)site;
+  size_t slot = (size_t)(hash ^ (hash >> 29)) & (capacity - 1);
+  while (records[slot].count != 0 &&
+         (records[slot].filename != filename || records[slot].line != line ||
+          records[slot].site != site))
+    slot = (slot + 1) & (capacity - 1);
+  return slot;
+}
+
+static void grow_records(void) {
+  size_t capacity = allocs.record_capacity == 0 ? 256 : allocs.record_capacity * 2;
+  AllocRecord *records = calloc(capacity, sizeof(AllocRecord));
+  for (size_t i = 0; i < allocs.record_capacity; i++) {
+    AllocRecord *old = &allocs.records[i];
+    if (old->count != 0)
+      records[record_slot(records, capacity, old->filename, old->line, old->site)] = *old;
+  }
+  free(allocs.records);
+  allocs.records = records;
+  allocs.record_capacity = capacity;
+}
+
+void alloc_record(AllocSite site, size_t count, size_t bytes) {
+  const char *filename;
+  size_t line;
+  Interpreter *interpreter = allocs.interpreter;
+  if (allocs.source || !interpreter) {
+    filename = allocs.source;
+    line = alloc_source_line;
+  } else {
+    size_t top = interpreter->frame_count - 1;
+    filename = interpreter->frames[top].filename;
+    line = interpreter->frames[top].line;
+  }
+  filename = intern_filename(filename);
+
+  allocs.totals[site][0] += count;
+  allocs.totals[site][1] += bytes;
+
+  if ((allocs.record_count + 1) * 2 > allocs.record_capacity)
+    grow_records();
+  AllocRecord *record = &allocs.records[record_slot(
+      allocs.records, allocs.record_capacity, filename, line, site)];
+  if (record->count == 0) {
+    record->filename = filename;
+    record->line = line;
+    record->site = site;
+    allocs.record_count++;
+  }
+  record->count += count;
+  record->bytes += bytes;
+}
+
+static int compare_records(const void *a, const void *b) {
+  const AllocRecord *x = a, *y = b;
+  if (x->bytes != y->bytes)
+    return x->bytes < y->bytes ? 1 : -1;
+  if (x->count != y->count)
+    return x->count < y->count ? 1 : -1;
+  return 0;
+}
+
+void alloc_report(FILE *out, size_t top_n) {
+  alloc_tracking = false;
+
+  uint64_t total_count = 0, total_bytes = 0;
+  for (int site = 0; site < ALLOC_SITE_COUNT; site++) {
+    total_count += allocs.totals[site][0];
+    total_bytes += allocs.totals[site][1];
+  }
+
+  fprintf(out, "\nAllocations: %llu (%llu bytes)\n\n",
+          (unsigned long long)total_count, (unsigned long long)total_bytes);
+  fprintf(out, "%12s %14s  %s\n", "allocs", "bytes", "site");
+  for (int site = 0; site < ALLOC_SITE_COUNT; site++) {
+    if (allocs.totals[site][0] == 0)
+      continue;
+    fprintf(out, "%12llu %14llu  %s\n", (unsigned long long)allocs.totals[site][0],
+            (unsigned long long)allocs.totals[site][1], site_names[site]);
+  }
+
+  /* Compact the table, then sort by bytes */
+  size_t used = 0;
+  for (size_t i = 0; i < allocs.record_capacity; i++) {
+    if (allocs.records[i].count != 0)
+      allocs.records[used++] = allocs.records[i];
+  }
+  qsort(allocs.records, used, sizeof(AllocRecord), compare_records);
+
+  fprintf(out, "\n%12s %14s  %-16s %s\n", "allocs", "bytes", "site", "location");
+  for (size_t i = 0; i < used && i < top_n; i++) {
+    AllocRecord *record = &allocs.records[i];
+    fprintf(out, "%12llu %14llu  %-16s %s:%zu\n", (unsigned long long)record->count,
+            (unsigned long long)record->bytes, site_names[record->site],
+            record->filename, record->line);
+  }
+
+  for (size_t i = 0; i < allocs.filename_count; i++)
+    free(allocs.filenames[i]);
+  free(allocs.filenames);
+  free(allocs.records);
+  memset(&allocs, 0, sizeof(allocs));
+}
+
+/* Memory statistics (mem_stats() and --mem-report).
+ *
+ * The live counters are always on: one increment and one decrement per
+ * Value, environment and file handle. String, list and buffer bytes are not
+ * counted as they are allocated (strings are built all over the builtins);
+ * they are measured on demand by walking everything reachable from the
+ * current scope chain, including the closures of function values. Values
+ * that are live but unreachable (leaks) show up in the counters only.
+ * List, set, deque and heap storage is shared between copies, so each is
+ * walked once; deques and heaps count towards the list bytes.
+ */
+
+MemCounters mem_counters;
+
+typedef struct {
+  MemStats *stats;
+  Environment **visited;
+  size_t visited_count;
+  size_t visited_capacity;
+  const void **shared; /* open-addressing set of the shared storage walked */
+  size_t shared_count;
+  size_t shared_capacity;
+} MemWalk;
+
+static void walk_environment(MemWalk *walk, Environment *env);
+
+static size_t shared_slot(const void **shared, size_t capacity, const void *storage) {
+  size_t slot = ((uintptr_t)storage >> 4) * 0x9E3779B97F4A7C15ull & (capacity - 1);
+  while (shared[slot] && shared[slot] != storage)
+    slot = (slot + 1) & (capacity - 1);
+  return slot;
+}
+
+/* Records STORAGE (a list, set, deque or heap) as walked; false if it
+ * already was */
+static bool walk_shared_first(MemWalk *walk, const void *storage) {
+  if (2 * (walk->shared_count + 1) > walk->shared_capacity) {
+    size_t capacity = walk->shared_capacity ? walk->shared_capacity * 2 : 64;
+    const void **shared = calloc(capacity, sizeof(void *));
+    for (size_t i = 0; i < walk->shared_capacity; i++) {
+      if (walk->shared[i])
+        shared[shared_slot(shared, capacity, walk->shared[i])] = walk->shared[i];
+    }
+    free(walk->shared);
+    walk->shared = shared;
+    walk->shared_capacity = capacity;
+  }
+  size_t slot = shared_slot(walk->shared, walk->shared_capacity, storage);
+  if (walk->shared[slot])
+    return false;
+  walk->shared[slot] = storage;
+  walk->shared_count++;
+  return true;
+}
+
+static void walk_value(MemWalk *walk, Value *value) {
+  walk->stats->reachable_values++;
+  switch (value->type) {
+  case VALUE_STRING:
+    if (value->as.string)
+      walk->stats->string_bytes += strlen(value->as.string) + 1;
+    break;
+  case VALUE_LIST:
+    if (value->as.list && walk_shared_first(walk, value->as.list)) {
+      walk->stats->list_bytes +=
+          sizeof(ValueList) + value->as.list->capacity * sizeof(Value);
+      for (size_t i = 0; i < value->as.list->count; i++)
+        walk_value(walk, &value->as.list->elements[i]);
+    }
+    break;
+  case VALUE_DEQUE:
+    if (value->as.deque && walk_shared_first(walk, value->as.deque)) {
+      ValueDeque *deque = value->as.deque;
+      walk->stats->list_bytes += sizeof(ValueDeque) + deque->capacity * sizeof(Value);
+      for (size_t i = 0; i < deque->count; i++)
+        walk_value(walk, value_deque_at(deque, i));
+    }
+    break;
+  case VALUE_HEAP:
+    if (value->as.heap && walk_shared_first(walk, value->as.heap)) {
+      ValueHeap *heap = value->as.heap;
+      walk->stats->list_bytes += sizeof(ValueHeap) + heap->capacity * sizeof(HeapEntry);
+      for (size_t i = 0; i < heap->count; i++) {
+        if (heap->entries[i].key.type != VALUE_NIL)
+          walk_value(walk, &heap->entries[i].key);
+        walk_value(walk, &heap->entries[i].element);
+      }
+      if (heap->key_fn)
+        walk_value(walk, heap->key_fn);
+    }
+    break;
+  case VALUE_SET:
+    if (value->as.set && walk_shared_first(walk, value->as.set)) {
+      ValueSet *set = value->as.set;
+      walk->stats->set_bytes += sizeof(ValueSet) +
+                                set->capacity * (sizeof(Value) + sizeof(uint64_t)) +
+                                (set->slot_mask + 1) * sizeof(size_t);
+      for (size_t i = 0; i < set->count; i++)
+        walk_value(walk, &set->elements[i]);
+    }
+    break;
+  case VALUE_BYTES:
+    if (value->as.bytes)
+      walk->stats->buffer_bytes += sizeof(ByteBuffer) + value->as.bytes->capacity;
+    break;
+  case VALUE_FUNCTION:
+    if (value->as.function)
+      walk_environment(walk, value->as.function->closure);
+    break;
+  default:
+    break;
+  }
+}
+
+static void walk_environment(MemWalk *walk, Environment *env) {
+  for (; env; env = env->enclosing) {
+    for (size_t i = 0; i < walk->visited_count; i++) {
+      if (walk->visited[i] == env)
+        return; /* this scope and everything enclosing it already counted */
+    }
+    if (walk->visited_count == walk->visited_capacity) {
+      walk->visited_capacity = walk->visited_capacity == 0 ? 16 : walk->visited_capacity * 2;
+      walk->visited = realloc(walk->visited, walk->visited_capacity * sizeof(Environment *));
+    }
+    walk->visited[walk->visited_count++] = env;
+    for (size_t i = 0; i < env->values.count; i++) {
+      if (env->values.values[i])
+        walk_value(walk, env->values.values[i]);
+    }
+  }
+}
+
+static void read_rss(MemStats *stats) {
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    stats->peak_rss_kb = (size_t)usage.ru_maxrss / 1024; /* bytes on macOS */
+#else
+    stats->peak_rss_kb = (size_t)usage.ru_maxrss;
+#endif
+  }
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm) {
+    unsigned long size, resident;
+    if (fscanf(statm, "%lu %lu", &size, &resident) == 2)
+      stats->rss_kb = resident * (size_t)sysconf(_SC_PAGESIZE) / 1024;
+    fclose(statm);
+  }
+  /* The kernel updates its high-water mark lazily */
+  if (stats->peak_rss_kb < stats->rss_kb)
+    stats->peak_rss_kb = stats->rss_kb;
+#else
+  (void)stats;
+#endif
+}
+
+void mem_stats_collect(Interpreter *interpreter, MemStats *stats) {
+  memset(stats, 0, sizeof(MemStats));
+  stats->values = mem_counters.values;
+  stats->environments = mem_counters.environments;
+  stats->open_files = mem_counters.open_files;
+  for (Environment *env = interpreter->environment; env; env = env->enclosing)
+    stats->environment_depth++;
+
+  MemWalk walk = {stats, NULL, 0, 0, NULL, 0, 0};
+  walk_environment(&walk, interpreter->environment);
+  walk_environment(&walk, interpreter->globals);
+  free(walk.visited);
+  free(walk.shared);
+
+  read_rss(stats);
+}
+
+static const struct {
+  const char *name;
+  size_t offset;
+} mem_fields[] = {
+    {"values", offsetof(MemStats, values)},
+    {"reachable_values", offsetof(MemStats, reachable_values)},
+    {"string_bytes", offsetof(MemStats, string_bytes)},
+    {"list_bytes", offsetof(MemStats, list_bytes)},
+    {"set_bytes", offsetof(MemStats, set_bytes)},
+    {"buffer_bytes", offsetof(MemStats, buffer_bytes)},
+    {"environments", offsetof(MemStats, environments)},
+    {"environment_depth", offsetof(MemStats, environment_depth)},
+    {"open_files", offsetof(MemStats, open_files)},
+    {"rss_kb", offsetof(MemStats, rss_kb)},
+    {"peak_rss_kb", offsetof(MemStats, peak_rss_kb)},
+};
+
+size_t mem_stats_field_count(void) {
+  return sizeof(mem_fields) / sizeof(mem_fields[0]);
+}
+
+const char *mem_stats_field_name(size_t index) {
+  return mem_fields[index].name;
+}
+
+size_t mem_stats_field(const MemStats *stats, size_t index) {
+  return *(const size_t *)((const char *)stats + mem_fields[index].offset);
+}
+
+void mem_report(FILE *out, Interpreter *interpreter) {
+  MemStats stats;
+  mem_stats_collect(interpreter, &stats);
+  fprintf(out, "\nMemory at exit\n");
+  for (size_t i = 0; i < mem_stats_field_count(); i++)
+    fprintf(out, "  %-20s %14zu\n", mem_fields[i].name, mem_stats_field(&stats, i));
+}
+
+/* Line execution counts (--line-counts).
+ *
+ * One counter array per source file, indexed by line and grown on demand.
+ * The interpreter keeps a pointer to the array of the file executing and
+ * switches it on function calls and imports, so counting a statement is an
+ * index and an increment. Files are keyed by path, so a module imported
+ * several times shares one array.
+ */
+
+static struct {
+  LineCounts **files;
+  size_t count;
+} line_counts;
+
+LineCounts *line_counts_file(const char *filename) {
+  if (!filename)
+    filename = "<unknown>";
+  for (size_t i = 0; i < line_counts.count; i++) {
+    if (strcmp(line_counts.files[i]->filename, filename) == 0)
+      return line_counts.files[i];
+  }
+  LineCounts *lines = calloc(1, sizeof(LineCounts));
+  lines->filename = malloc(strlen(filename) + 1);
+  strcpy(lines->filename, filename);
+  line_counts.files = realloc(line_counts.files,
+                              (line_counts.count + 1) * sizeof(LineCounts *));
+  line_counts.files[line_counts.count++] = lines;
+  return lines;
+}
+
+void line_counts_grow(LineCounts *lines, size_t line) {
+  size_t capacity = lines->capacity == 0 ? 256 : lines->capacity;
+  while (capacity <= line)
+    capacity *= 2;
+  lines->counts = realloc(lines->counts, capacity * sizeof(uint64_t));
+  memset(lines->counts + lines->capacity, 0,
+         (capacity - lines->capacity) * sizeof(uint64_t));
+  lines->capacity = capacity;
+  lines->counts[line]++;
+}
+
+/* Source listing with each line's count in front; lines that never ran a
+ * statement show a blank count */
+static void annotate_file(FILE *out, LineCounts *lines) {
+  fprintf(out, "\n==> %s <==\n", lines->filename);
+  FILE *source = fopen(lines->filename, "r");
+  if (!source) {
+    fprintf(out, "(source not available)\n");
+    return;
+  }
+  char buffer[4096];
+  size_t line = 1;
+  bool line_start = true;
+  while (fgets(buffer, sizeof(buffer), source)) {
+    if (line_start) {
+      uint64_t count = line < lines->capacity ? lines->counts[line] : 0;
+      if (count > 0)
+        fprintf(out, "%12llu  %5zu  ", (unsigned long long)count, line);
+      else
+        fprintf(out, "%12s  %5zu  ", "", line);
+    }
+    fputs(buffer, out);
+    line_start = strchr(buffer, '\n') != NULL;
+    if (line_start)
+      line++;
+  }
+  if (!line_start)
+    fputc('\n', out);
+  fclose(source);
+}
+
+void line_counts_report(FILE *out, bool annotate) {
+  for (size_t i = 0; i < line_counts.count; i++) {
+    LineCounts *lines = line_counts.files[i];
+    if (annotate) {
+      annotate_file(out, lines);
+    } else {
+      for (size_t line = 0; line < lines->capacity; line++) {
+        if (lines->counts[line] > 0)
+          fprintf(out, "%s:%zu %llu\n", lines->filename, line,
+                  (unsigned long long)lines->counts[line]);
+      }
+    }
+    free(lines->filename);
+    free(lines->counts);
+    free(lines);
+  }
+  free(line_counts.files);
+  memset(&line_counts, 0, sizeof(line_counts));
+}
+
+/* Execution statistics (--stats).
+ *
+ * Compiled in only with -DMS_STATS (`make stats`); otherwise the STATS_*
+ * hooks in the interpreter expand to nothing. Counts how often each
+ * statement and expression type is executed, calls per builtin, how many
+ * scopes environment_get walks to find a name, and the size of value_copy
+ * results. The distributions of depths and sizes are power-of-two buckets.
+ */
+
+#ifdef MS_STATS
+
+#define STATS_MAX_TYPES 32
+#define STATS_BUCKETS 24
+
+static const char *stmt_names[STATS_MAX_TYPES] = {
+    [STMT_BLOCK] = "BLOCK",   [STMT_EXPRESSION] = "EXPRESSION",
+    [STMT_PRINT] = "PRINT",   [STMT_FUNCTION] = "FUNCTION",
+    [STMT_FOR] = "FOR",       [STMT_IF] = "IF",
+    [STMT_RETURN] = "RETURN", [STMT_WHILE] = "WHILE",
+    [STMT_IMPORT] = "IMPORT", [STMT_ASSERT] = "ASSERT",
+    [STMT_VAR] = "VAR",       [STMT_FOR_IN] = "FOR_IN",
+};
+
+static const char *expr_names[STATS_MAX_TYPES] = {
+    [EXPR_ASSIGN] = "ASSIGN",   [EXPR_BINARY] = "BINARY",
+    [EXPR_CALL] = "CALL",       [EXPR_GROUPING] = "GROUPING",
+    [EXPR_LITERAL] = "LITERAL", [EXPR_LIST_LITERAL] = "LIST_LITERAL",
+    [EXPR_GET] = "GET",         [EXPR_SET] = "SET",
+    [EXPR_LOGICAL] = "LOGICAL", [EXPR_UNARY] = "UNARY",
+    [EXPR_VARIABLE] = "VARIABLE",
+};
+
+typedef struct {
+  char *name;
+  uint64_t calls;
+} BuiltinCount;
+
+static struct {
+  uint64_t stmts[STATS_MAX_TYPES];
+  uint64_t exprs[STATS_MAX_TYPES];
+  BuiltinCount *builtins;
+  size_t builtin_count;
+  uint64_t lookup_depths[STATS_BUCKETS]; /* bucket 0: depth 0 */
+  uint64_t lookup_misses;
+  uint64_t copy_sizes[STATS_BUCKETS];
+  uint64_t copies;
+  uint64_t copy_bytes;
+} stats;
+
+/* Bucket b holds values in [2^(b-1), 2^b), with bucket 0 for zero */
+static size_t stats_bucket(size_t value) {
+  size_t bucket = 0;
+  while (value > 0 && bucket < STATS_BUCKETS - 1) {
+    value >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+void stats_count_stmt(StmtType type) {
+  if ((size_t)type < STATS_MAX_TYPES)
+    stats.stmts[type]++;
+}
+
+void stats_count_expr(ExprType type) {
+  if ((size_t)type < STATS_MAX_TYPES)
+    stats.exprs[type]++;
+}
+
+void stats_count_builtin(const char *name) {
+  for (size_t i = 0; i < stats.builtin_count; i++) {
+    if (strcmp(stats.builtins[i].name, name) == 0) {
+      stats.builtins[i].calls++;
+      return;
+    }
+  }
+  stats.builtins = realloc(stats.builtins,
+                           (stats.builtin_count + 1) * sizeof(BuiltinCount));
+  BuiltinCount *entry = &stats.builtins[stats.builtin_count++];
+  entry->name = malloc(strlen(name) + 1);
+  strcpy(entry->name, name);
+  entry->calls = 1;
+}
+
+void stats_count_lookup(size_t depth, bool found) {
+  if (found)
+    stats.lookup_depths[stats_bucket(depth)]++;
+  else
+    stats.lookup_misses++;
+}
+
+void stats_count_copy(size_t bytes) {
+  stats.copies++;
+  stats.copy_bytes += bytes;
+  stats.copy_sizes[stats_bucket(bytes)]++;
+}
+
+typedef struct {
+  const char *name;
+  uint64_t count;
+} StatsRow;
+
+static int compare_stats_rows(const void *a, const void *b) {
+  const StatsRow *x = a, *y = b;
+  if (x->count != y->count)
+    return x->count < y->count ? 1 : -1;
+  return strcmp(x->name, y->name);
+}
+
+static void print_rows(FILE *out, const char *title, StatsRow *rows, size_t count) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < count; i++)
+    total += rows[i].count;
+  qsort(rows, count, sizeof(StatsRow), compare_stats_rows);
+
+  fprintf(out, "\n%s (%llu total)\n", title, (unsigned long long)total);
+  for (size_t i = 0; i < count; i++) {
+    if (rows[i].count == 0)
+      continue;
+    fprintf(out, "  %-20s %14llu %7.2f%%\n", rows[i].name,
+            (unsigned long long)rows[i].count, 100.0 * rows[i].count / total);
+  }
+}
+
+static void print_type_counts(FILE *out, const char *title, uint64_t *counts,
+                              const char **names) {
+  StatsRow rows[STATS_MAX_TYPES];
+  char unnamed[STATS_MAX_TYPES][16];
+  for (size_t i = 0; i < STATS_MAX_TYPES; i++) {
+    if (!names[i]) {
+      snprintf(unnamed[i], sizeof(unnamed[i]), "#%zu", i);
+      rows[i].name = unnamed[i];
+    } else {
+      rows[i].name = names[i];
+    }
+    rows[i].count = counts[i];
+  }
+  print_rows(out, title, rows, STATS_MAX_TYPES);
+}
+
+static void print_histogram(FILE *out, const char *title, const char *unit,
+                            uint64_t *buckets) {
+  uint64_t total = 0;
+  for (size_t b = 0; b < STATS_BUCKETS; b++)
+    total += buckets[b];
+  fprintf(out, "\n%s (%llu total)\n", title, (unsigned long long)total);
+  for (size_t b = 0; b < STATS_BUCKETS; b++) {
+    if (buckets[b] == 0)
+      continue;
+    char range[48];
+    size_t low = b == 0 ? 0 : (size_t)1 << (b - 1);
+    size_t high = b == 0 ? 0 : ((size_t)1 << b) - 1;
+    if (low == high)
+      snprintf(range, sizeof(range), "%zu", low);
+    else if (b == STATS_BUCKETS - 1)
+      snprintf(range, sizeof(range), "%zu+", low);
+    else
+      snprintf(range, sizeof(range), "%zu-%zu", low, high);
+    fprintf(out, "  %-20s", range);
+    fprintf(out, " %14llu %7.2f%%  %s\n", (unsigned long long)buckets[b],
+            100.0 * buckets[b] / total, unit);
+  }
+}
+
+void stats_report(FILE *out) {
+  fprintf(out, "\nExecution statistics\n");
+  print_type_counts(out, "Statements executed", stats.stmts, stmt_names);
+  print_type_counts(out, "Expressions evaluated", stats.exprs, expr_names);
+
+  StatsRow *rows = malloc((stats.builtin_count + 1) * sizeof(StatsRow));
+  for (size_t i = 0; i < stats.builtin_count; i++) {
+    rows[i].name = stats.builtins[i].name;
+    rows[i].count = stats.builtins[i].calls;
+  }
+  print_rows(out, "Builtin calls", rows, stats.builtin_count);
+  free(rows);
+
+  print_histogram(out, "Environment lookup depth", "scopes up", stats.lookup_depths);
+  if (stats.lookup_misses > 0)
+    fprintf(out, "  %-20s %14llu\n", "not found",
+            (unsigned long long)stats.lookup_misses);
+
+  fprintf(out, "\nvalue_copy: %llu copies, %llu bytes",
+          (unsigned long long)stats.copies, (unsigned long long)stats.copy_bytes);
+  if (stats.copies > 0)
+    fprintf(out, " (%.1f bytes average)", (double)stats.copy_bytes / stats.copies);
+  fprintf(out, "\n");
+  print_histogram(out, "value_copy size", "bytes", stats.copy_sizes);
+
+  for (size_t i = 0; i < stats.builtin_count; i++)
+    free(stats.builtins[i].name);
+  free(stats.builtins);
+  memset(&stats, 0, sizeof(stats));
+}
+
+#endif /* MS_STATS */
@@ -1,4 +1,5 @@
 #include "mini_script.h"
+#include <math.h>
 
 /* Local safe strdup replacement (portable) */
 static char *ms_strdup(const char *s) {
@@ -8,21 +9,509 @@ static char *ms_strdup(const char *s) {
   char *copy = malloc(len + 1);
   if (!copy)
     return NULL; /* Allocation failure propagates as NULL */
+  ALLOC_TRACK(ALLOC_STRDUP, 1, len + 1);
   memcpy(copy, s, len + 1);
   return copy;
 }
 
 /* Value functions */
-Value *value_new(ValueType type) {
+static Value *value_alloc(ValueType type) {
   Value *value = malloc(sizeof(Value));
+  mem_counters.values++;
   value->type = type;
   memset(&value->as, 0, sizeof(value->as));
   return value;
 }
 
-/* Internal recursive disposer for inline Value structs (does not free the
- * struct itself) */
-static void value_dispose_inline(Value *value) {
+Value *value_new(ValueType type) {
+  ALLOC_TRACK(ALLOC_VALUE_NEW, 1, sizeof(Value));
+  return value_alloc(type);
+}
+
+/* Byte buffer functions */
+ByteBuffer *byte_buffer_new(size_t length) {
+  ByteBuffer *buffer = malloc(sizeof(ByteBuffer));
+  buffer->capacity = length > 0 ? length : 8;
+  buffer->data = calloc(buffer->capacity, 1);
+  buffer->length = length;
+  buffer->refcount = 1;
+  return buffer;
+}
+
+void byte_buffer_release(ByteBuffer *buffer) {
+  if (!buffer)
+    return;
+  if (--buffer->refcount == 0) {
+    free(buffer->data);
+    free(buffer);
+  }
+}
+
+void byte_buffer_append(ByteBuffer *buffer, const unsigned char *data,
+                        size_t length) {
+  if (buffer->length + length > buffer->capacity) {
+    size_t capacity = buffer->capacity * 2;
+    while (capacity < buffer->length + length)
+      capacity *= 2;
+    buffer->data = realloc(buffer->data, capacity);
+    buffer->capacity = capacity;
+  }
+  memcpy(buffer->data + buffer->length, data, length);
+  buffer->length += length;
+}
+
+/* Range functions */
+size_t range_length(const RangeValue *range) {
+  double steps = ceil((range->stop - range->start) / range->step);
+  if (!(steps > 0))
+    return 0; /* empty, or NaN */
+  return steps < (double)SIZE_MAX ? (size_t)steps : SIZE_MAX;
+}
+
+/* Computed from START rather than accumulated, so long ranges do not drift */
+double range_at(const RangeValue *range, size_t index) {
+  return range->start + (double)index * range->step;
+}
+
+/* List storage functions */
+ValueList *value_list_new(size_t capacity) {
+  ValueList *list = malloc(sizeof(ValueList));
+  list->capacity = capacity;
+  list->count = 0;
+  list->elements = malloc((capacity > 0 ? capacity : 1) * sizeof(Value));
+  list->refcount = 1;
+  return list;
+}
+
+void value_list_release(ValueList *list) {
+  if (!list)
+    return;
+  if (--list->refcount == 0) {
+    for (size_t i = 0; i < list->count; i++)
+      value_dispose_inline(&list->elements[i]);
+    free(list->elements);
+    free(list);
+  }
+}
+
+/* Moves ELEMENT to the end of LIST, freeing the emptied Value */
+void value_list_push(ValueList *list, Value *element) {
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity > 0 ? list->capacity * 2 : 8;
+    list->elements = realloc(list->elements, list->capacity * sizeof(Value));
+  }
+  list->elements[list->count++] = *element;
+  free(element); /* contents now live inline in the list */
+  mem_counters.values--;
+}
+
+/* Set functions */
+
+/* FNV-1a over strings, the bits of numbers (with -0 folded into 0 and every
+ * NaN into one), finished with a mixer so the low bits that pick a slot
+ * depend on all of them */
+uint64_t value_hash(const Value *value) {
+  uint64_t hash = 1469598103934665603ULL ^ (uint64_t)value->type;
+  switch (value->type) {
+  case VALUE_BOOLEAN:
+    hash ^= value->as.boolean;
+    break;
+  case VALUE_NUMBER: {
+    double number = value->as.number;
+    uint64_t bits = 0;
+    if (number != number)
+      bits = 0x7ff8000000000000ULL;
+    else if (number != 0)
+      memcpy(&bits, &number, sizeof(bits));
+    hash ^= bits;
+    break;
+  }
+  case VALUE_STRING:
+    for (const unsigned char *c = (const unsigned char *)value->as.string; *c; c++)
+      hash = (hash ^ *c) * 1099511628211ULL;
+    break;
+  default:
+    break;
+  }
+  /* fmix64: small integers differ only in their top bits as doubles */
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  return hash ^ (hash >> 33);
+}
+
+bool value_hashable(const Value *value) {
+  switch (value->type) {
+  case VALUE_NIL:
+  case VALUE_BOOLEAN:
+  case VALUE_NUMBER:
+  case VALUE_STRING:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* values_equal, except that NaN is a member like any other number */
+static bool set_keys_equal(const Value *a, const Value *b) {
+  if (a->type != b->type)
+    return false;
+  switch (a->type) {
+  case VALUE_BOOLEAN:
+    return a->as.boolean == b->as.boolean;
+  case VALUE_NUMBER:
+    return a->as.number == b->as.number ||
+           (a->as.number != a->as.number && b->as.number != b->as.number);
+  case VALUE_STRING:
+    return strcmp(a->as.string, b->as.string) == 0;
+  default:
+    return true; /* nil */
+  }
+}
+
+ValueSet *value_set_new(size_t capacity) {
+  size_t slots = 8;
+  while (slots < 2 * capacity)
+    slots *= 2;
+  ValueSet *set = malloc(sizeof(ValueSet));
+  set->capacity = capacity > 0 ? capacity : 4;
+  set->count = 0;
+  set->elements = malloc(set->capacity * sizeof(Value));
+  set->hashes = malloc(set->capacity * sizeof(uint64_t));
+  set->slots = calloc(slots, sizeof(size_t));
+  set->slot_mask = slots - 1;
+  set->refcount = 1;
+  return set;
+}
+
+void value_set_release(ValueSet *set) {
+  if (!set)
+    return;
+  if (--set->refcount == 0) {
+    for (size_t i = 0; i < set->count; i++)
+      value_dispose_inline(&set->elements[i]);
+    free(set->elements);
+    free(set->hashes);
+    free(set->slots);
+    free(set);
+  }
+}
+
+/* The slot holding VALUE, or the empty slot where it would go */
+static size_t set_find(const ValueSet *set, const Value *value, uint64_t hash) {
+  size_t slot = (size_t)hash & set->slot_mask;
+  while (set->slots[slot]) {
+    size_t index = set->slots[slot] - 1;
+    if (set->hashes[index] == hash && set_keys_equal(&set->elements[index], value))
+      break;
+    slot = (slot + 1) & set->slot_mask;
+  }
+  return slot;
+}
+
+bool value_set_has(const ValueSet *set, const Value *value) {
+  if (!value_hashable(value))
+    return false;
+  return set->slots[set_find(set, value, value_hash(value))] != 0;
+}
+
+/* Adds a copy of VALUE, which must be hashable; false if already present */
+bool value_set_add(ValueSet *set, const Value *value) {
+  uint64_t hash = value_hash(value);
+  size_t slot = set_find(set, value, hash);
+  if (set->slots[slot])
+    return false;
+
+  if (set->count == set->capacity) {
+    set->capacity *= 2;
+    set->elements = realloc(set->elements, set->capacity * sizeof(Value));
+    set->hashes = realloc(set->hashes, set->capacity * sizeof(uint64_t));
+  }
+  /* Keep the index at most half full */
+  if (2 * (set->count + 1) > set->slot_mask + 1) {
+    size_t mask = set->slot_mask * 2 + 1;
+    free(set->slots);
+    set->slots = calloc(mask + 1, sizeof(size_t));
+    set->slot_mask = mask;
+    for (size_t i = 0; i < set->count; i++) {
+      size_t s = (size_t)set->hashes[i] & mask;
+      while (set->slots[s])
+        s = (s + 1) & mask;
+      set->slots[s] = i + 1;
+    }
+    slot = set_find(set, value, hash);
+  }
+
+  Value *element = &set->elements[set->count];
+  *element = *value;
+  if (value->type == VALUE_STRING)
+    element->as.string = ms_strdup(value->as.string);
+  set->hashes[set->count] = hash;
+  set->slots[slot] = ++set->count;
+  return true;
+}
+
+/* Removes VALUE; false if it was not present */
+bool value_set_remove(ValueSet *set, const Value *value) {
+  if (!value_hashable(value))
+    return false;
+  size_t slot = set_find(set, value, value_hash(value));
+  if (!set->slots[slot])
+    return false;
+  size_t index = set->slots[slot] - 1;
+
+  /* Empty the slot and shift later entries of the probe run back into it,
+   * so lookups never need tombstones */
+  size_t mask = set->slot_mask;
+  set->slots[slot] = 0;
+  for (size_t next = (slot + 1) & mask; set->slots[next]; next = (next + 1) & mask) {
+    size_t home = (size_t)set->hashes[set->slots[next] - 1] & mask;
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      set->slots[slot] = set->slots[next];
+      set->slots[next] = 0;
+      slot = next;
+    }
+  }
+
+  /* Move the last element into the hole */
+  value_dispose_inline(&set->elements[index]);
+  size_t last = --set->count;
+  if (index != last) {
+    set->elements[index] = set->elements[last];
+    set->hashes[index] = set->hashes[last];
+    size_t s = (size_t)set->hashes[last] & mask;
+    while (set->slots[s] != last + 1)
+      s = (s + 1) & mask;
+    set->slots[s] = index + 1;
+  }
+  return true;
+}
+
+/* Deque functions */
+ValueDeque *value_deque_new(size_t capacity) {
+  ValueDeque *deque = malloc(sizeof(ValueDeque));
+  deque->capacity = 8;
+  while (deque->capacity < capacity)
+    deque->capacity *= 2;
+  deque->elements = malloc(deque->capacity * sizeof(Value));
+  deque->head = 0;
+  deque->count = 0;
+  deque->refcount = 1;
+  return deque;
+}
+
+void value_deque_release(ValueDeque *deque) {
+  if (!deque)
+    return;
+  if (--deque->refcount == 0) {
+    for (size_t i = 0; i < deque->count; i++)
+      value_dispose_inline(value_deque_at(deque, i));
+    free(deque->elements);
+    free(deque);
+  }
+}
+
+/* Element INDEX, which must be below the count, stored inline */
+Value *value_deque_at(ValueDeque *deque, size_t index) {
+  return &deque->elements[(deque->head + index) & (deque->capacity - 1)];
+}
+
+/* Doubles the capacity, unwrapping the elements to start at 0 */
+static void deque_grow(ValueDeque *deque) {
+  Value *elements = malloc(2 * deque->capacity * sizeof(Value));
+  size_t first = deque->capacity - deque->head; /* elements before the wrap */
+  if (first > deque->count)
+    first = deque->count;
+  memcpy(elements, deque->elements + deque->head, first * sizeof(Value));
+  memcpy(elements + first, deque->elements, (deque->count - first) * sizeof(Value));
+  free(deque->elements);
+  deque->elements = elements;
+  deque->head = 0;
+  deque->capacity *= 2;
+}
+
+void value_deque_push_back(ValueDeque *deque, Value *element) {
+  if (deque->count == deque->capacity)
+    deque_grow(deque);
+  *value_deque_at(deque, deque->count++) = *element;
+  free(element); /* contents now live inline in the deque */
+  mem_counters.values--;
+}
+
+void value_deque_push_front(ValueDeque *deque, Value *element) {
+  if (deque->count == deque->capacity)
+    deque_grow(deque);
+  deque->head = (deque->head - 1) & (deque->capacity - 1);
+  deque->count++;
+  deque->elements[deque->head] = *element;
+  free(element);
+  mem_counters.values--;
+}
+
+Value *value_deque_pop_back(ValueDeque *deque) {
+  if (deque->count == 0)
+    return NULL;
+  Value *element = value_alloc(VALUE_NIL);
+  *element = *value_deque_at(deque, --deque->count);
+  return element;
+}
+
+Value *value_deque_pop_front(ValueDeque *deque) {
+  if (deque->count == 0)
+    return NULL;
+  Value *element = value_alloc(VALUE_NIL);
+  *element = deque->elements[deque->head];
+  deque->head = (deque->head + 1) & (deque->capacity - 1);
+  deque->count--;
+  return element;
+}
+
+/* Heap functions */
+ValueHeap *value_heap_new(Value *key_fn) {
+  ValueHeap *heap = malloc(sizeof(ValueHeap));
+  heap->capacity = 8;
+  heap->count = 0;
+  heap->entries = malloc(heap->capacity * sizeof(HeapEntry));
+  heap->key_fn = key_fn;
+  heap->pushes = 0;
+  heap->refcount = 1;
+  return heap;
+}
+
+void value_heap_release(ValueHeap *heap) {
+  if (!heap)
+    return;
+  if (--heap->refcount == 0) {
+    for (size_t i = 0; i < heap->count; i++) {
+      value_dispose_inline(&heap->entries[i].key);
+      value_dispose_inline(&heap->entries[i].element);
+    }
+    free(heap->entries);
+    value_free(heap->key_fn);
+    free(heap);
+  }
+}
+
+/* Orders two keys of the same type, numbers or strings */
+int value_key_compare(const Value *a, const Value *b) {
+  if (a->type == VALUE_NUMBER)
+    return (a->as.number > b->as.number) - (a->as.number < b->as.number);
+  return strcmp(a->as.string, b->as.string);
+}
+
+static const Value *heap_entry_key(const HeapEntry *entry) {
+  return entry->key.type == VALUE_NIL ? &entry->element : &entry->key;
+}
+
+const Value *value_heap_top_key(const ValueHeap *heap) {
+  return heap->count > 0 ? heap_entry_key(&heap->entries[0]) : NULL;
+}
+
+static bool heap_entry_less(const HeapEntry *a, const HeapEntry *b) {
+  int order = value_key_compare(heap_entry_key(a), heap_entry_key(b));
+  return order != 0 ? order < 0 : a->order < b->order;
+}
+
+/* Whether KEY can be ordered against the keys already in HEAP */
+static bool heap_key_valid(const ValueHeap *heap, const Value *key) {
+  if (key->type == VALUE_NUMBER) {
+    if (key->as.number != key->as.number)
+      return false; /* NaN */
+  } else if (key->type != VALUE_STRING) {
+    return false;
+  }
+  return heap->count == 0 || heap_entry_key(&heap->entries[0])->type == key->type;
+}
+
+/* Moves KEY and ELEMENT into ENTRY */
+static void heap_entry_fill(HeapEntry *entry, Value *key, Value *element, uint64_t order) {
+  entry->key.type = VALUE_NIL;
+  if (key) {
+    entry->key = *key;
+    free(key);
+    mem_counters.values--;
+  }
+  entry->element = *element;
+  free(element);
+  mem_counters.values--;
+  entry->order = order;
+}
+
+/* Moves ENTRY up from the hole at INDEX to its place */
+static void heap_sift_up(ValueHeap *heap, size_t index, HeapEntry entry) {
+  while (index > 0) {
+    size_t parent = (index - 1) / 4;
+    if (!heap_entry_less(&entry, &heap->entries[parent]))
+      break;
+    heap->entries[index] = heap->entries[parent];
+    index = parent;
+  }
+  heap->entries[index] = entry;
+}
+
+/* Moves ENTRY down from the hole at INDEX to its place */
+static void heap_sift_down(ValueHeap *heap, size_t index, HeapEntry entry) {
+  for (;;) {
+    size_t first = 4 * index + 1;
+    if (first >= heap->count)
+      break;
+    size_t last = first + 4 < heap->count ? first + 4 : heap->count;
+    size_t least = first;
+    for (size_t child = first + 1; child < last; child++) {
+      if (heap_entry_less(&heap->entries[child], &heap->entries[least]))
+        least = child;
+    }
+    if (!heap_entry_less(&heap->entries[least], &entry))
+      break;
+    heap->entries[index] = heap->entries[least];
+    index = least;
+  }
+  heap->entries[index] = entry;
+}
+
+bool value_heap_push(ValueHeap *heap, Value *key, Value *element, uint64_t order) {
+  if (!heap_key_valid(heap, key ? key : element))
+    return false;
+  if (heap->count == heap->capacity) {
+    heap->capacity *= 2;
+    heap->entries = realloc(heap->entries, heap->capacity * sizeof(HeapEntry));
+  }
+  HeapEntry entry;
+  heap_entry_fill(&entry, key, element, order);
+  heap_sift_up(heap, heap->count++, entry);
+  return true;
+}
+
+/* Pops the top entry and pushes KEY and ELEMENT in a single sift; HEAP must
+ * not be empty */
+bool value_heap_replace_top(ValueHeap *heap, Value *key, Value *element, uint64_t order) {
+  if (!heap_key_valid(heap, key ? key : element))
+    return false;
+  value_dispose_inline(&heap->entries[0].key);
+  value_dispose_inline(&heap->entries[0].element);
+  HeapEntry entry;
+  heap_entry_fill(&entry, key, element, order);
+  heap_sift_down(heap, 0, entry);
+  return true;
+}
+
+/* Removes the entry with the least key and returns its element, or NULL
+ * when HEAP is empty */
+Value *value_heap_pop(ValueHeap *heap) {
+  if (heap->count == 0)
+    return NULL;
+  Value *element = value_alloc(VALUE_NIL);
+  *element = heap->entries[0].element;
+  value_dispose_inline(&heap->entries[0].key);
+  if (--heap->count > 0)
+    heap_sift_down(heap, 0, heap->entries[heap->count]);
+  return element;
+}
+
+/* Disposes of the contents of a Value stored inline, such as a list element
+ * (does not free the struct itself) */
+void value_dispose_inline(Value *value) {
   if (!value)
     return;
   switch (value->type) {
@@ -33,18 +522,16 @@ static void value_dispose_inline(Value *value) {
     }
     break;
   case VALUE_LIST:
-    if (value->as.list) {
-      for (size_t i = 0; i < value->as.list->count; i++) {
-        value_dispose_inline(&value->as.list->elements[i]);
-      }
-      free(value->as.list->elements);
-      free(value->as.list);
-      value->as.list = NULL;
-    }
+    value_list_release(value->as.list);
+    value->as.list = NULL;
     break;
   case VALUE_FUNCTION:
-    /* Shallow copies share function object; only freed in top-level value_free
-     */
+    if (value->as.function) {
+      if (value->as.function->owns_closure)
+        environment_release(value->as.function->closure);
+      free(value->as.function);
+      value->as.function = NULL;
+    }
     break;
   case VALUE_BUILTIN:
     /* builtin_name freed only in top-level (ownership single) */
@@ -52,6 +539,26 @@ static void value_dispose_inline(Value *value) {
   case VALUE_FILE_HANDLE:
     /* Only close at top-level */
     break;
+  case VALUE_BYTES:
+    byte_buffer_release(value->as.bytes);
+    value->as.bytes = NULL;
+    break;
+  case VALUE_RANGE:
+    free(value->as.range);
+    value->as.range = NULL;
+    break;
+  case VALUE_SET:
+    value_set_release(value->as.set);
+    value->as.set = NULL;
+    break;
+  case VALUE_DEQUE:
+    value_deque_release(value->as.deque);
+    value->as.deque = NULL;
+    break;
+  case VALUE_HEAP:
+    value_heap_release(value->as.heap);
+    value->as.heap = NULL;
+    break;
   default:
     break;
   }
@@ -67,19 +574,13 @@ void value_free(Value *value) {
       free(value->as.string);
     break;
   case VALUE_LIST:
-    if (value->as.list) {
-      for (size_t i = 0; i < value->as.list->count; i++) {
-        value_dispose_inline(&value->as.list->elements[i]);
-      }
-      free(value->as.list->elements);
-      free(value->as.list);
-    }
+    value_list_release(value->as.list);
     break;
   case VALUE_FUNCTION:
     if (value->as.function) {
-      // Don't free declaration or closure as they are shared references
-      // stmt_free(value->as.function->declaration);
-      // environment_free(value->as.function->closure);
+      // The declaration belongs to the AST; the closure is reference counted
+      if (value->as.function->owns_closure)
+        environment_release(value->as.function->closure);
       free(value->as.function);
     }
     break;
@@ -91,17 +592,33 @@ void value_free(Value *value) {
     // if (value->as.file_handle)
     //   fclose(value->as.file_handle);
     break;
+  case VALUE_BYTES:
+    byte_buffer_release(value->as.bytes);
+    break;
+  case VALUE_RANGE:
+    free(value->as.range);
+    break;
+  case VALUE_SET:
+    value_set_release(value->as.set);
+    break;
+  case VALUE_DEQUE:
+    value_deque_release(value->as.deque);
+    break;
+  case VALUE_HEAP:
+    value_heap_release(value->as.heap);
+    break;
   default:
     break;
   }
   free(value);
+  mem_counters.values--;
 }
 
-Value *value_copy(Value *value) {
-  if (!value)
-    return NULL;
-
-  Value *copy = value_new(value->type);
+/* Deep copy; adds the allocations made to *count and *bytes */
+static Value *copy_value(Value *value, size_t *count, size_t *bytes) {
+  Value *copy = value_alloc(value->type);
+  *count += 1;
+  *bytes += sizeof(Value);
 
   switch (value->type) {
   case VALUE_NIL:
@@ -115,36 +632,70 @@ Value *value_copy(Value *value) {
   case VALUE_STRING:
     copy->as.string = malloc(strlen(value->as.string) + 1);
     strcpy(copy->as.string, value->as.string);
+    *count += 1;
+    *bytes += strlen(value->as.string) + 1;
     break;
   case VALUE_LIST:
-    copy->as.list = malloc(sizeof(ValueList));
-    copy->as.list->capacity = value->as.list->count;
-    copy->as.list->count = 0;
-    copy->as.list->elements = malloc(value->as.list->count * sizeof(Value));
-    for (size_t i = 0; i < value->as.list->count; i++) {
-      Value *elem_copy = value_copy(&value->as.list->elements[i]);
-      copy->as.list->elements[copy->as.list->count++] = *elem_copy;
-      free(elem_copy);
-    }
+    copy->as.list = value->as.list; // Shared storage
+    copy->as.list->refcount++;
     break;
   case VALUE_FUNCTION:
     copy->as.function = malloc(sizeof(MiniScriptFunction));
     copy->as.function->declaration =
         value->as.function->declaration;                      // Shallow copy
-    copy->as.function->closure = value->as.function->closure; // Shallow copy
+    copy->as.function->closure = value->as.function->closure; // Shared
+    copy->as.function->owns_closure = true;
+    environment_retain(copy->as.function->closure);
+    *count += 1;
+    *bytes += sizeof(MiniScriptFunction);
     break;
   case VALUE_BUILTIN:
     copy->as.builtin_name = malloc(strlen(value->as.builtin_name) + 1);
     strcpy(copy->as.builtin_name, value->as.builtin_name);
+    *count += 1;
+    *bytes += strlen(value->as.builtin_name) + 1;
     break;
   case VALUE_FILE_HANDLE:
     copy->as.file_handle = value->as.file_handle; // Shallow copy - potential issue
     break;
+  case VALUE_BYTES:
+    copy->as.bytes = value->as.bytes; // Shared storage
+    copy->as.bytes->refcount++;
+    break;
+  case VALUE_RANGE:
+    copy->as.range = malloc(sizeof(RangeValue));
+    *copy->as.range = *value->as.range;
+    *count += 1;
+    *bytes += sizeof(RangeValue);
+    break;
+  case VALUE_SET:
+    copy->as.set = value->as.set; // Shared storage
+    copy->as.set->refcount++;
+    break;
+  case VALUE_DEQUE:
+    copy->as.deque = value->as.deque; // Shared storage
+    copy->as.deque->refcount++;
+    break;
+  case VALUE_HEAP:
+    copy->as.heap = value->as.heap; // Shared storage
+    copy->as.heap->refcount++;
+    break;
   }
 
   return copy;
 }
 
+Value *value_copy(Value *value) {
+  if (!value)
+    return NULL;
+
+  size_t count = 0, bytes = 0;
+  Value *copy = copy_value(value, &count, &bytes);
+  ALLOC_TRACK(ALLOC_VALUE_COPY, count, bytes);
+  STATS_COPY(bytes);
+  return copy;
+}
+
 /* Token functions */
 Token *token_new(MSTokenType type, const char *lexeme, LiteralValue *literal,
                  size_t line) {
@@ -168,7 +719,9 @@ void token_free(Token *token) {
 /* Statement functions */
 Stmt *stmt_new(StmtType type) {
   Stmt *stmt = malloc(sizeof(Stmt));
+  ALLOC_TRACK(ALLOC_PARSER, 1, sizeof(Stmt));
   stmt->type = type;
+  stmt->line = 0;
   memset(&stmt->as, 0, sizeof(stmt->as));
   return stmt;
 }
@@ -195,6 +748,7 @@ void stmt_free(Stmt *stmt) {
     break;
   case STMT_FUNCTION:
     free(stmt->as.function.name.lexeme);
+    free(stmt->as.function.filename);
     for (size_t i = 0; i < stmt->as.function.param_count; i++) {
       free(stmt->as.function.params[i].lexeme);
     }
@@ -203,12 +757,14 @@ void stmt_free(Stmt *stmt) {
       stmt_free(stmt->as.function.body.statements[i]);
     }
     free(stmt->as.function.body.statements);
+    jit_release(stmt->as.function.jit);
     break;
   case STMT_FOR:
     stmt_free(stmt->as.for_stmt.initializer);
     expr_free(stmt->as.for_stmt.condition);
     expr_free(stmt->as.for_stmt.increment);
     stmt_free(stmt->as.for_stmt.body);
+    jit_release(stmt->as.for_stmt.jit);
     break;
   case STMT_IF:
     expr_free(stmt->as.if_stmt.condition);
@@ -222,6 +778,7 @@ void stmt_free(Stmt *stmt) {
   case STMT_WHILE:
     expr_free(stmt->as.while_stmt.condition);
     stmt_free(stmt->as.while_stmt.body);
+    jit_release(stmt->as.while_stmt.jit);
     break;
   case STMT_IMPORT:
     free(stmt->as.import.path_token.lexeme);
@@ -239,6 +796,11 @@ void stmt_free(Stmt *stmt) {
     free(stmt->as.var.name.lexeme);
     expr_free(stmt->as.var.initializer);
     break;
+  case STMT_FOR_IN:
+    free(stmt->as.for_in.name.lexeme);
+    expr_free(stmt->as.for_in.iterable);
+    stmt_free(stmt->as.for_in.body);
+    break;
   }
   free(stmt);
 }
@@ -246,6 +808,7 @@ void stmt_free(Stmt *stmt) {
 /* Expression functions */
 Expr *expr_new(ExprType type) {
   Expr *expr = malloc(sizeof(Expr));
+  ALLOC_TRACK(ALLOC_PARSER, 1, sizeof(Expr));
   expr->type = type;
   memset(&expr->as, 0, sizeof(expr->as));
   return expr;
@@ -345,6 +908,22 @@ char *stringify_value(Value *value) {
     return ms_strdup(buffer);
   case VALUE_FILE_HANDLE:
     return ms_strdup("<file>");
+  case VALUE_BYTES:
+    snprintf(buffer, sizeof(buffer), "<bytes %zu>", value->as.bytes->length);
+    return ms_strdup(buffer);
+  case VALUE_RANGE:
+    snprintf(buffer, sizeof(buffer), "range(%.6g, %.6g, %.6g)", value->as.range->start,
+             value->as.range->stop, value->as.range->step);
+    return ms_strdup(buffer);
+  case VALUE_SET:
+    snprintf(buffer, sizeof(buffer), "<set %zu>", value->as.set->count);
+    return ms_strdup(buffer);
+  case VALUE_DEQUE:
+    snprintf(buffer, sizeof(buffer), "<deque %zu>", value->as.deque->count);
+    return ms_strdup(buffer);
+  case VALUE_HEAP:
+    snprintf(buffer, sizeof(buffer), "<heap %zu>", value->as.heap->count);
+    return ms_strdup(buffer);
   default:
     return ms_strdup("unknown");
   }
@@ -382,6 +961,22 @@ bool values_equal(Value *a, Value *b) {
     return strcmp(a->as.string, b->as.string) == 0;
   case VALUE_FILE_HANDLE:
     return false; // File handles are never equal
+  case VALUE_BYTES:
+    return a->as.bytes->length == b->as.bytes->length &&
+           memcmp(a->as.bytes->data, b->as.bytes->data,
+                  a->as.bytes->length) == 0;
+  case VALUE_RANGE:
+    return a->as.range->start == b->as.range->start &&
+           a->as.range->stop == b->as.range->stop &&
+           a->as.range->step == b->as.range->step;
+  case VALUE_SET:
+    if (a->as.set->count != b->as.set->count)
+      return false;
+    for (size_t i = 0; i < a->as.set->count; i++) {
+      if (!value_set_has(b->as.set, &a->as.set->elements[i]))
+        return false;
+    }
+    return true;
   default:
     return false;
   }
@@ -1304,10 +1304,16 @@ class Interpreter(Expr.Visitor, Stmt.Visitor):
     def visit_listliteral_expr(self, expr):
         return [self.evaluate(elem) for elem in expr.elements]
 
+    def list_index(self, index):
+        """Arithmetic yields floats, so a whole-number float indexes too."""
+        if isinstance(index, float) and index.is_integer():
+            return int(index)
+        return index
+
     def visit_get_expr(self, expr):
         obj = self.evaluate(expr.object)
         if isinstance(obj, list):
-            index = self.evaluate(expr.index)
+            index = self.list_index(self.evaluate(expr.index))
             if isinstance(index, int):
                 if 0 <= index < len(obj):
                     return obj[index]
@@ -1318,7 +1324,7 @@ class Interpreter(Expr.Visitor, Stmt.Visitor):
     def visit_set_expr(self, expr):
         obj = self.evaluate(expr.object)
         if isinstance(obj, list):
-            index = self.evaluate(expr.index)
+            index = self.list_index(self.evaluate(expr.index))
             if isinstance(index, int):
                 if 0 <= index < len(obj):
                     value = self.evaluate(expr.value)